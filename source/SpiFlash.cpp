@@ -24,7 +24,7 @@ SOFTWARE.
 #include <cstdlib>
 #include "SpiFlash.h"
 
-void SpiFlash::GenerateByte(U8 b, std::vector<U8> &bits)
+void SpiFlash::GenerateByte(U8 b, std::vector<U8> &bits, bool dtr)
 {
 	// Bits for all the lines at once 0 - CS, 1 - CLK, 2-5 data bits
 	U8 lines = 0;
@@ -47,6 +47,13 @@ void SpiFlash::GenerateByte(U8 b, std::vector<U8> &bits)
 
 		b <<= mCurBusMode;
 		i += mCurBusMode;
+		// In DTR every second sample goes to falling edge
+		if (dtr && (i / mCurBusMode) % 2 == 0)
+		{
+			bits.push_back(CS_LOW | lines | CLOCK_HIGH);
+			bits.push_back(CS_LOW | lines | CLOCK_LOW);
+			continue;
+		}
 		// Add lines to history, CS is low all the time
 		bits.push_back(CS_LOW | lines | CLOCK_LOW);
 		// Add same lines with clock high
@@ -57,6 +64,7 @@ void SpiFlash::GenerateByte(U8 b, std::vector<U8> &bits)
 void SpiFlash::GenerateCommandBits(SpiCmdData *cmd, std::vector<U8> &bits)
 {
 	int n;
+	bool dtr = cmd->mDtr || mDtrProtocol;
 	mDataIn = false;
 	// Add some delay before CS goes low
 	bits.push_back(Delay(3 + rand() % 10));
@@ -64,7 +72,7 @@ void SpiFlash::GenerateCommandBits(SpiCmdData *cmd, std::vector<U8> &bits)
 	// generate cmd bits if mActiveCmd in not set
 	if (mCurrentCmd == nullptr)
 	{
-		GenerateByte(cmd->GetCode(), bits);
+		GenerateByte(cmd->GetCode(), bits, mDtrProtocol);
 	}
 
 	// if bus witdh changes after command code change current bus mode
@@ -77,12 +85,12 @@ void SpiFlash::GenerateCommandBits(SpiCmdData *cmd, std::vector<U8> &bits)
 		uint32_t addr = rand();
 		U32 addressBits = (cmd->mAddressBits != 0xFF) ? cmd->mAddressBits : mAddressBits;
 		if (addressBits > 24)
-			GenerateByte(U8(addr >> 24), bits);
+			GenerateByte(U8(addr >> 24), bits, dtr);
 		if (addressBits > 16)
-			GenerateByte(U8(addr >> 16), bits);
+			GenerateByte(U8(addr >> 16), bits, dtr);
 		if (addressBits > 8)
-			GenerateByte(U8(addr >> 8), bits);
-		GenerateByte(U8(addr), bits);
+			GenerateByte(U8(addr >> 8), bits, dtr);
+		GenerateByte(U8(addr), bits, dtr);
 	}
 
 	// for continuous read mode command generate M bits
@@ -91,13 +99,13 @@ void SpiFlash::GenerateCommandBits(SpiCmdData *cmd, std::vector<U8> &bits)
 		// 3/4 times stay in continuous read mode
 		if (rand() % 4)
 		{
-			GenerateByte(0xAF, bits);
+			GenerateByte(0xAF, bits, dtr);
 			mCurrentCmd = cmd;
 		}
 		else
 		{
 			// 1/4 times go to command mode again
-			GenerateByte(0xFF, bits);
+			GenerateByte(0xFF, bits, dtr);
 			mCurrentCmd = nullptr;
 		}
 	}
@@ -145,13 +153,18 @@ void SpiFlash::GenerateCommandBits(SpiCmdData *cmd, std::vector<U8> &bits)
 
 	// Genereate data
 	for (int i = 0; i < n; ++i)
-		GenerateByte(U8(rand()), bits);
+		GenerateByte(U8(rand()), bits, dtr);
 
 	// If command changed bus mode update it
 	// (comands like Enter/Exit QPI mode)
 	if (cmd->mModeChange)
 		mDefBusMode = BusMode(cmd->mModeChange);
 
+	if (cmd->mRole == ROLE_ENTER_4BYTE)
+		mAddressBits = 32;
+	else if (cmd->mRole == ROLE_EXIT_4BYTE)
+		mAddressBits = 24;
+
 	// Switch to default bus mode
 	mCurBusMode = mDefBusMode;
 }
@@ -166,7 +179,8 @@ void SpiFlash::GenerateRandomCommandBits(std::vector<U8> &bits)
 	{
 		GetValidCommands(cmds);
 		SpiCmdData *cmd = mActiveCmdSet->GetCommand(mCurBusMode, cmds[rand() % cmds.size()]);
-		if (cmd)
+		// Simulation has no D4-D7 lines
+		if (cmd && cmd->mModeArgs != OCTAL && cmd->mModeData != OCTAL && cmd->mModeChange != OCTAL)
 			GenerateCommandBits(cmd, bits);
 	}
 }
@@ -178,8 +192,8 @@ void addCommands(SpiFlash &spiFlash)
 		+ Register("Status Register-1", 8) + Bit(7, "SRP0") + Bit(1, "WEL") + Bit(0, "BUSY")
 		+ Register("Status Register-2", 8) + Bit(7, "SUS") + Bit(1, "QE") + Bit(0, "SRP1")
 
-		+ Cmd14(0x06, "WREN", "Write Enable")
-		+ Cmd14(0x04, "WRDI", "Write Disable")
+		+ Cmd14(0x06, "WREN", "Write Enable") + ROLE_WRITE_ENABLE
+		+ Cmd14(0x04, "WRDI", "Write Disable") + ROLE_WRITE_DISABLE
 		+ Cmd14(0x05, "RDSR", "Read status register-1") + RegisterRead("Status Register-1")
 		+ Cmd14(0x35, "RS2", "Read status register-2") + RegisterWrite("Status Register-2")
 		+ Cmd14(0x01, "WS1", "Write status register-1") + RegisterWrite("Status Register-1") + RegisterWrite("Status Register-2") +
@@ -191,20 +205,39 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd1(0xBB, "R", "R 1-2-2", "Fast Read Dual I/O") + DUAL_IO + ADDR + M + OP_DATA_READ
 		+ Cmd1(0xEB, "R", "R 1-4-4", "Fast Read Quad I/O") + QUAD_IO + ADDR + M + DummyBytes(2) + OP_DATA_READ
 		+ Cmd14(0x02, "PP", "Page Program") + ADDR + OP_DATA_WRITE
-		+ Cmd14(0x20, "SE", "Sector erase") + ADDR
-		+ Cmd14(0x52, "BE", "Block erase") + ADDR
-		+ Cmd14(0xD8, "BE", "BE64", "64KB Block erase") + ADDR
-		+ Cmd14(0x60, "CE", "Chip erase")
-		+ Cmd14(0xC7, "CE", "Chip erase")
-		+ Cmd1(0x5A, "SFDP", "Read SFDP Register") + ADDR + DummyBytes(1) + OP_DATA_READ
-		+ Cmd14(0x75, "SUSP", "Erase/Program Suspend")
-		+ Cmd14(0x7A, "RESM", "Erase/Program Resume")
-		+ Cmd14(0xB9, "DN", "Power Down")
+		+ Cmd14(0x20, "SE", "Sector erase") + ADDR + EraseSize(0x1000)
+		+ Cmd14(0x52, "BE", "Block erase") + ADDR + EraseSize(0x8000)
+		+ Cmd14(0xD8, "BE", "BE64", "64KB Block erase") + ADDR + EraseSize(0x10000)
+		+ Cmd14(0x60, "CE", "Chip erase") + EraseSize(ERASE_CHIP)
+		+ Cmd14(0xC7, "CE", "Chip erase") + EraseSize(ERASE_CHIP)
+		+ Cmd1(0x5A, "SFDP", "Read SFDP Register") + ROLE_READ_SFDP + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd14(0x75, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd14(0x7A, "RESM", "Erase/Program Resume") + ROLE_RESUME
+		+ Cmd14(0xB9, "DN", "Power Down") + ROLE_POWER_DOWN
 		+ Cmd14(0x9F, "JID", "Read JEDEC ID") + OP_DATA_READ
-		+ Cmd1(0x90, "MFID", "Read manufacturer, Device ID") + ADDR + OP_DATA_READ
+		+ Cmd1(0x90, "MFID", "Read manufacturer, Device ID") + ROLE_OTHER_SPACE + ADDR + OP_DATA_READ
 		+ Cmd14(0x66, "RSTEN", "Enable Reset")
 		+ Cmd14(0x99, "RST", "Reset")
-		+ Cmd14(0xAB, "UP", "Release Power Down") + DummyBytes(3) + OP_DATA_READ
+		+ Cmd14(0xAB, "UP", "Release Power Down") + ROLE_RELEASE_POWER_DOWN + DummyBytes(3) + OP_DATA_READ
+
+		// Parts above 128 Mbit: 4-byte address mode, commands with 4-byte address
+		+ Register("Extended Address Register", 8) + Bit(7, 0, "A31:24")
+		+ Cmd14(0xB7, "EN4B", "Enter 4-Byte Address Mode") + ROLE_ENTER_4BYTE
+		+ Cmd14(0xE9, "EX4B", "Exit 4-Byte Address Mode") + ROLE_EXIT_4BYTE
+		+ Cmd14(0xC5, "WREAR", "Write Extended Address Register") + ROLE_WRITE_EXTENDED_ADDRESS + RegisterWrite("Extended Address Register")
+		+ Cmd14(0xC8, "RDEAR", "Read Extended Address Register") + RegisterRead("Extended Address Register")
+		+ Cmd1(0x13, "R", "Read Data 4-byte address") + ADDR4 + OP_DATA_READ
+		+ Cmd1(0x0C, "R", "Fast Read 4-byte address") + ADDR4 + DummyBytes(1) + OP_DATA_READ
+		+ Cmd1(0x3C, "R", "R 1-1-2", "Fast Read Dual Output 4-byte address") + ADDR4 + DummyBytes(1) + DUAL_DATA + OP_DATA_READ
+		+ Cmd1(0x6C, "R", "R 1-1-4", "Fast Read Quad Output 4-byte address") + ADDR4 + DummyBytes(1) + QUAD_DATA + OP_DATA_READ
+		+ Cmd1(0xBC, "R", "R 1-2-2", "Fast Read Dual I/O 4-byte address") + DUAL_IO + ADDR4 + M + OP_DATA_READ
+		+ Cmd1(0xEC, "R", "R 1-4-4", "Fast Read Quad I/O 4-byte address") + QUAD_IO + ADDR4 + M + DummyBytes(2) + OP_DATA_READ
+		+ Cmd14(0x12, "PP4B", "Page Program 4-byte address") + ADDR4 + OP_DATA_WRITE
+		+ Cmd1(0x34, "QPP4B", "Quad Input Page Program 4-byte address") + QUAD_DATA + ADDR4 + OP_DATA_WRITE
+		+ Cmd14(0x21, "SE4B", "Sector erase 4-byte address") + ADDR4 + EraseSize(0x1000)
+		+ Cmd14(0x5C, "BE4B", "Block erase 4-byte address") + ADDR4 + EraseSize(0x8000)
+		+ Cmd14(0xDC, "BE4B", "BE64", "64KB Block erase 4-byte address") + ADDR4 + EraseSize(0x10000)
+
 		+ CommandSet(0xEF, "Winbond", 0)
 		+ Register("Status Register-1", 8) + Bit(7, "SRP0") + Bit(6, "TPB") + Bit(5, "TP") + Bit(4, 2, "BPB") + Bit(1, "WEL") + Bit(0, "BUSY")
 		+ Register("Status Register-2", 8) + Bit(7, "SUS") + Bit(6, "CMP") + Bit(5, 3, "LB") + Bit(1, "QE") + Bit(0, "SRP1")
@@ -219,25 +252,30 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd4(0xEB, "R", "R 1-4-4", "Fast Read Quad I/O") + QUAD_IO + ADDR + M + OP_DATA_READ
 		+ Cmd14(0xE7, "R", "R 1-4-4", "Word Read Quad I/O") + QUAD_IO + ADDR + M + DummyBytes(1) + OP_DATA_READ
 		+ Cmd14(0xE3, "R", "R 1-4-4", "Octal Word Read Quad I/O") + QUAD_IO + ADDR + M + OP_DATA_READ
-		+ Cmd14(0x36, "Individual Block/Sector Lock") + ADDR
-		+ Cmd14(0x39, "Individual Block/Sector Unlock") + ADDR
+		+ Cmd1(0x0D, "R", "R 1-1D-1D", "DTR Fast Read") + DTR + ADDR + DummyCycles(6) + OP_DATA_READ
+		+ Cmd1(0xBD, "R", "R 1-2D-2D", "DTR Fast Read Dual I/O") + DUAL_IO + DTR + ADDR + M + DummyCycles(2) + OP_DATA_READ
+		+ Cmd14(0xED, "R", "R 1-4D-4D", "DTR Fast Read Quad I/O") + QUAD_IO + DTR + ADDR + M + DummyCycles(7) + OP_DATA_READ
+		+ Cmd14(0x36, "Individual Block/Sector Lock") + ROLE_SECTOR_LOCK + ADDR
+		+ Cmd14(0x39, "Individual Block/Sector Unlock") + ROLE_SECTOR_UNLOCK + ADDR
 		+ Cmd14(0x3D, "Read Block/Sector Lock") + ADDR
-		+ Cmd14(0x7E, "Global Block/Sector Lock")
-		+ Cmd14(0x98, "Global Block/Sector Unlock")
+		+ Cmd14(0x7E, "Global Block/Sector Lock") + ROLE_GLOBAL_LOCK
+		+ Cmd14(0x98, "Global Block/Sector Unlock") + ROLE_GLOBAL_UNLOCK
 
-		+ Cmd1(0x77, "Set Burst with Wrap") + QUAD_IO + DummyBytes(3) + OP_DATA_WRITE
+		+ Cmd1(0x77, "Set Burst with Wrap") + ROLE_SET_WRAP + QUAD_IO + DummyBytes(3) + OP_DATA_WRITE
 		+ Cmd1(0x32, "QPP", "Quad Input Page Program") + QUAD_DATA + ADDR + OP_DATA_WRITE
-		+ Cmd1(0x92, "MFID", "Read manufacturer, Device ID DUAL I/O") + DUAL_IO + ADDR + DummyBytes(1) + OP_DATA_READ
-		+ Cmd1(0x94, "MFID", "Read manufacturer, Device ID QUAD I/O") + QUAD_IO + ADDR + DummyBytes(3) + OP_DATA_READ
+		+ Cmd1(0x92, "MFID", "Read manufacturer, Device ID DUAL I/O") + ROLE_OTHER_SPACE + DUAL_IO + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd1(0x94, "MFID", "Read manufacturer, Device ID QUAD I/O") + ROLE_OTHER_SPACE + QUAD_IO + ADDR + DummyBytes(3) + OP_DATA_READ
 		+ Cmd1(0x4B, "ID", "Read Unique ID number") + DummyBytes(4) + OP_DATA_READ
-		+ Cmd1(0x44, "Erase Security Registers") + ADDR
-		+ Cmd1(0x42, "Program Security Registers") + ADDR + OP_DATA_WRITE
-		+ Cmd1(0x48, "Read Security Registers") + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd1(0x44, "Erase Security Registers") + ROLE_OTP + ADDR
+		+ Cmd1(0x42, "Program Security Registers") + ROLE_OTP + ADDR + OP_DATA_WRITE
+		+ Cmd1(0x48, "Read Security Registers") + ROLE_OTP + ADDR + DummyBytes(1) + OP_DATA_READ
 		+ Cmd1(0x38, "*4", "QPI", "Enter QPI Mode") + SET_QUAD
 
 		+ Cmd4(0x0B, "R", "R 4-4-4", "Fast Read") + ADDR + DummyBytes(1) + OP_DATA_READ
-		+ Cmd4(0xC0, "SRP", "Set Read Parameters") + OP_DATA_WRITE
-		+ Cmd4(0x0C, "BRW", "Burst Read with Wrap") + ADDR + M + DummyBytes(1) + OP_DATA_READ
+		+ Cmd4(0x0D, "R", "R 4-4D-4D", "DTR Fast Read") + DTR + ADDR + DummyCycles(8) + OP_DATA_READ
+		+ Register("Read Parameters", 8) + Bit(5, 4, "DC") + Bit(1, 0, "WL")
+		+ Cmd4(0xC0, "SRP", "Set Read Parameters") + ROLE_SET_READ_PARAMETERS + RegisterWrite("Read Parameters")
+		+ Cmd4(0x0C, "BRW", "Burst Read with Wrap") + ROLE_READ_WRAP + ADDR + M + DummyBytes(1) + OP_DATA_READ
 
 		+ Cmd14(0xff, "*1", "Exit QPI Mode") + SET_SINGLE
 		+ CommandSet(0xC2, "Macronix", 0)
@@ -248,33 +286,60 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd1(0x01, "WSRS", "Write status register") + RegisterWrite("Status Register-1") + RegisterWrite("Configuration Register-1") + RegisterWrite("Configuration Register-2")
 		+ Cmd1(0x05, "RDSR", "Read status register-1") + RegisterRead("Status Register-1")
 		+ Cmd1(0x15, "RDCR", "Read configuration register") + RegisterRead("Configuration Register-1") + RegisterRead("Configuration Register-2")
-		+ Cmd1(0xB0, "SUSP", "Erase/Program Suspend")
-		+ Cmd1(0x30, "RESM", "Erase/Program Resume")
-		+ Cmd1(0xC0, "SBL", "Set Burst Length") + OP_DATA_WRITE
-		+ Cmd1(0xB1, "ENSO", "Enter Secured OTP")
-		+ Cmd1(0xC1, "EXSO", "Exit Secured OTP")
+		+ Cmd1(0xB0, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd1(0x30, "RESM", "Erase/Program Resume") + ROLE_RESUME
+		+ Register("Burst Length", 8) + Bit(4, "WD") + Bit(1, 0, "WL")
+		+ Cmd1(0xC0, "SBL", "Set Burst Length") + ROLE_SET_READ_PARAMETERS + RegisterWrite("Burst Length")
+		+ Cmd1(0xB1, "ENSO", "Enter Secured OTP") + ROLE_ENTER_OTP
+		+ Cmd1(0xC1, "EXSO", "Exit Secured OTP") + ROLE_EXIT_OTP
 		+ Cmd1(0x2B, "RDSCUR", "Read Security Register") + RegisterRead("Security Register")
 		+ Cmd1(0x2F, "WRSCUR", "Write Security Register") + RegisterWrite("Security Register")
-		+ Cmd1(0xAB, "RES", "Read Electronic ID") + DummyBytes(3) + OP_DATA_READ
+		+ Cmd1(0xAB, "RES", "Read Electronic ID") + ROLE_RELEASE_POWER_DOWN + DummyBytes(3) + OP_DATA_READ
 		+ Cmd1(0x32, "QPP", "Quad Input Page Program") + QUAD_DATA + ADDR + OP_DATA_WRITE
 		+ Cmd1(0x38, "QPP", "Quad I/O Page Program") + QUAD_IO + ADDR + OP_DATA_WRITE
+		+ Cmd1(0x0D, "FASTDTRD", "R 1-1D-1D", "Fast DT Read") + DTR + ADDR + DummyCycles(6) + OP_DATA_READ
+		+ Cmd1(0xBD, "2DTRD", "R 1-2D-2D", "Dual I/O DT Read") + DUAL_IO + DTR + ADDR + M + DummyCycles(4) + OP_DATA_READ
+		+ Cmd14(0xED, "4DTRD", "R 1-4D-4D", "Quad I/O DT Read") + QUAD_IO + DTR + ADDR + M + DummyCycles(7) + OP_DATA_READ
+		+ Cmd14(0xEE, "4DTRD4B", "R 1-4D-4D", "Quad I/O DT Read 4-byte address") + QUAD_IO + DTR + ADDR4 + M + DummyCycles(7) + OP_DATA_READ
+
+		// OctaFlash OPI (8-8-8) and DOPI (8D-8D-8D), opcode followed by inverted opcode
+		+ OPCODE_EXT_INVERT
+		+ Cmd18(0x72, "WRCR2", "Write Configuration Register 2") + ROLE_OTHER_SPACE + ADDR4 + OP_DATA_WRITE
+		+ Cmd18(0x71, "RDCR2", "Read Configuration Register 2") + ROLE_OTHER_SPACE + ADDR4 + OP_DATA_READ
+		+ Cmd8(0x06, "WREN", "Write Enable") + ROLE_WRITE_ENABLE
+		+ Cmd8(0x04, "WRDI", "Write Disable") + ROLE_WRITE_DISABLE
+		+ Cmd8(0x05, "RDSR", "Read status register") + ROLE_OTHER_SPACE + ADDR4 + DummyCycles(4) + RegisterRead("Status Register-1")
+		+ Cmd8(0x9F, "RDID", "Read Identification") + ROLE_OTHER_SPACE + ADDR4 + DummyCycles(4) + OP_DATA_READ
+		+ Cmd8(0x5A, "RDSFDP", "Read SFDP") + ROLE_READ_SFDP + ADDR4 + DummyCycles(20) + OP_DATA_READ
+		+ Cmd8(0xEC, "8READ", "R 8-8-8", "Octa Read") + ADDR4 + DummyCycles(20) + OP_DATA_READ
+		+ Cmd8(0xEE, "8DTRD", "R 8D-8D-8D", "Octa DTR Read") + DTR + ADDR4 + DummyCycles(20) + OP_DATA_READ
+		+ Cmd8(0x12, "PP4B", "Page Program") + ADDR4 + OP_DATA_WRITE
+		+ Cmd8(0x21, "SE4B", "Sector erase") + ADDR4 + EraseSize(0x1000)
+		+ Cmd8(0xDC, "BE4B", "Block erase") + ADDR4 + EraseSize(0x10000)
+		+ Cmd8(0x60, "CE", "Chip erase") + EraseSize(ERASE_CHIP)
+		+ Cmd8(0xB0, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd8(0x30, "RESM", "Erase/Program Resume") + ROLE_RESUME
+		+ Cmd8(0xB9, "DP", "Deep Power Down") + ROLE_POWER_DOWN
+		+ Cmd8(0x66, "RSTEN", "Enable Reset")
+		+ Cmd8(0x99, "RST", "Reset")
 
 		+ CommandSet(0xC8, "GigaDevice", 0xEF)
 		+ Register("Status Register-1", 8) + Bit(7, "SRP0") + Bit(6, 2, "BPB") + Bit(1, "WEL") + Bit(0, "BUSY")
 		+ Register("Status Register-2", 8) + Bit(7, "SUS1") + Bit(6, "CMP") + Bit(5, 3, "LB") + Bit(2, "SUS2") + Bit(1, "QE") + Bit(0, "SRP1")
 		+ CommandSet(0x1F, "Adesto", 0)
-		+ Cmd14(0xB1, "ENSO", "Enter Secured OTP")
-		+ Cmd14(0xC1, "EXSO", "Exit Secured OTP")
+		+ Cmd14(0xB1, "ENSO", "Enter Secured OTP") + ROLE_ENTER_OTP
+		+ Cmd14(0xC1, "EXSO", "Exit Secured OTP") + ROLE_EXIT_OTP
 		+ Cmd14(0x2B, "RDSCUR", "Read Security Register")
 		+ Cmd14(0x2F, "WRSCUR", "Write Security Register")
 		+ Cmd1(0x38, "*4", "QPI", "Enter QPI Mode") + SET_QUAD
 		+ Cmd4(0xff, "*1", "Exit QPI Mode") + SET_SINGLE
-		+ Cmd4(0x0C, "BRW", "Burst Read with Wrap") + ADDR + M + DummyBytes(1) + OP_DATA_READ
-		+ Cmd4(0xC0, "SRP", "Set Read Parameters") + OP_DATA_WRITE
+		+ Cmd4(0x0C, "BRW", "Burst Read with Wrap") + ROLE_READ_WRAP + ADDR + M + DummyBytes(1) + OP_DATA_READ
+		+ Register("Read Parameters", 8) + Bit(5, 4, "DC") + Bit(1, 0, "WL")
+		+ Cmd4(0xC0, "SRP", "Set Read Parameters") + ROLE_SET_READ_PARAMETERS + RegisterWrite("Read Parameters")
 		+ Cmd14(0x33, "QPP", "Quad Input Page Program") + QUAD_DATA + ADDR + OP_DATA_WRITE
 		+ Cmd1(0x94, "MFID", "Read manufacturer, Device ID QUAD I/O") + QUAD_IO + ADDR + DummyBytes(3) + OP_DATA_READ
 		+ Cmd14(0xE7, "R", "R 1-4-4", "Word Read Quad I/O") + QUAD_IO + ADDR + M + DummyBytes(1) + OP_DATA_READ
-		+ Cmd1(0x77, "Set Burst with Wrap") + QUAD_IO + DummyBytes(3) + OP_DATA_WRITE
+		+ Cmd1(0x77, "Set Burst with Wrap") + ROLE_SET_WRAP + QUAD_IO + DummyBytes(3) + OP_DATA_WRITE
 
 		+ CommandSet(0x01, "Cypress", 0)
 		+ Register("Status Register-1", 8) + Bit(7, "SRP0") + Bit(6, "TPB") + Bit(5, "TP") + Bit(4, 2, "BPB") + Bit(1, "WEL") + Bit(0, "BUSY")
@@ -287,39 +352,47 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd1(0x35, "RDCR", "Read Configuration Register") + RegisterWrite("Status Register-2")
 		+ Cmd1(0x33, "RDSR3", "Read Status register-3") + RegisterRead("Status Register-3")
 		+ Cmd1(0x01, "WRR", "Write Status Registers") + RegisterWrite("Status Register-1")
+		+ Register("Bank Address Register", 8) + Bit(7, "EXTADD") + Bit(6, 0, "BA31:24")
 		+ Cmd1(0xB9, "BRAC", "Bank Register Access")
-		+ Cmd1(0x17, "BRWR", "Bank Register Write")
-		+ Cmd1(0x18, "ECCRD", "ECC Statuc Register Read") + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd1(0x17, "BRWR", "Bank Register Write") + ROLE_WRITE_BANK_REGISTER + RegisterWrite("Bank Address Register")
+		+ Cmd1(0x16, "BRRD", "Bank Register Read") + RegisterRead("Bank Address Register")
+		+ Cmd1(0x18, "ECCRD", "ECC Statuc Register Read") + ROLE_OTHER_SPACE + ADDR + DummyBytes(1) + OP_DATA_READ
 		+ Cmd1(0x14, "ABRD", "Auto Boot Register Read")
 		+ Cmd1(0x14, "ABWR", "Auto Boot Register Write")
 		+ Cmd1(0x43, "PNVDLR", "Programm NVDLR") + OP_DATA_WRITE
 		+ Cmd1(0x4A, "WVDLR", "Write VDLR") + OP_DATA_WRITE
 		+ Cmd1(0x41, "DLPRD", "Data Learning Patter Read") + OP_DATA_READ
 		+ Cmd1(0x30, "CLSR", "Clear Status Register")
-		+ Cmd1(0x77, "Set Burst with Wrap") + QUAD_IO + DummyBytes(3) + OP_DATA_WRITE
+		+ Cmd1(0x77, "Set Burst with Wrap") + ROLE_SET_WRAP + QUAD_IO + DummyBytes(3) + OP_DATA_WRITE
 		+ Cmd1(0x39, "Set Block/Pointer protection") + ADDR
-		+ Cmd1(0x48, "Read Security Registers") + ADDR + DummyBytes(1) + OP_DATA_READ
-		+ Cmd1(0x44, "Erase Security Registers") + ADDR
-		+ Cmd1(0x42, "Program Security Registers") + ADDR + OP_DATA_WRITE
+		+ Cmd1(0x48, "Read Security Registers") + ROLE_OTP + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd1(0x44, "Erase Security Registers") + ROLE_OTP + ADDR
+		+ Cmd1(0x42, "Program Security Registers") + ROLE_OTP + ADDR + OP_DATA_WRITE
+		+ Cmd1(0x0D, "DDRFR", "R 1-1D-1D", "DDR Fast Read") + DTR + ADDR + M + OP_DATA_READ
+		+ Cmd1(0xBD, "DDRDIOR", "R 1-2D-2D", "DDR Dual I/O Read") + DUAL_IO + DTR + ADDR + M + DummyCycles(4) + OP_DATA_READ
+		+ Cmd1(0xED, "DDRQIOR", "R 1-4D-4D", "DDR Quad I/O Read") + QUAD_IO + DTR + ADDR + M + DummyCycles(6) + OP_DATA_READ
+		+ Cmd1(0xEE, "4DDRQIOR", "R 1-4D-4D", "DDR Quad I/O Read 4-byte address") + QUAD_IO + DTR + ADDR4 + M + DummyCycles(6) + OP_DATA_READ
 
 		+ CommandSet(0x9D, "Issi", 0xEF)
 		+ Register("Function Register", 8) + Bit(7, "IRL3") + Bit(6, "IRL2") + Bit(5, "IRL1") + Bit(4, 2, "IRL0") + Bit(3, "ESUS") + Bit(2, "PSUS")
 		+ Cmd1(0x48, "Read Function Register") + RegisterRead("Function Register")
 		+ Cmd1(0x42, "Write Function Register") + RegisterWrite("Function Register")
-		+ Cmd14(0x68, "IRRD", "Read Information Row") + ADDR + DummyBytes(1) + OP_DATA_READ
-		+ Cmd14(0x62, "IRP", "Information Row Program") + ADDR + OP_DATA_WRITE
-		+ Cmd14(0x64, "IRER", "Erase Information Row") + ADDR
-		+ Cmd14(0x26, "SECUNLOCK", "Sector Unlock") + ADDR
-		+ Cmd14(0x24, "SECLOCK", "Sector Lock") + ADDR
-		+ Cmd14(0xD7, "SE", "SER", "Sector erase") + ADDR
+		+ Cmd14(0x68, "IRRD", "Read Information Row") + ROLE_OTP + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd14(0x62, "IRP", "Information Row Program") + ROLE_OTP + ADDR + OP_DATA_WRITE
+		+ Cmd14(0x64, "IRER", "Erase Information Row") + ROLE_OTP + ADDR
+		+ Cmd14(0x26, "SECUNLOCK", "Sector Unlock") + ROLE_SECTOR_UNLOCK + ADDR
+		+ Cmd14(0x24, "SECLOCK", "Sector Lock") + ROLE_SECTOR_LOCK + ADDR
+		+ Cmd14(0xD7, "SE", "SER", "Sector erase") + ADDR + EraseSize(0x1000)
+		+ Cmd14(0xEE, "4FRQDTR", "R 1-4D-4D", "Fast Read Quad I/O DTR 4-byte address") + QUAD_IO + DTR + ADDR4 + M + DummyCycles(7) + OP_DATA_READ
 		/* 0x38 Differes from Winbond */
 		+ Cmd1(0x38, "QPP", "Quad Input Page Program") + QUAD_DATA + ADDR + OP_DATA_WRITE
-		+ Cmd1(0xB0, "SUSP", "Erase/Program Suspend")
-		+ Cmd1(0x30, "RESM", "Erase/Program Resume")
+		+ Cmd1(0xB0, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd1(0x30, "RESM", "Erase/Program Resume") + ROLE_RESUME
 		+ Cmd1(0x35, "*4", "QPIEN", "Enter QPI Mode") + SET_QUAD
 		+ Cmd4(0xF5, "*1", "QPIDI", "Exit QPI Mode") + SET_SINGLE
 
 		+ CommandSet(0x20, "Micron", 0)
+		+ Register("Status Register-1", 8) + Bit(7, "SRWD") + Bit(6, "BP3") + Bit(5, "TB") + Bit(4, 2, "BPB") + Bit(1, "WEL") + Bit(0, "WIP")
 		+ Register("Nonvolatile Configuration Register", 16) + Bit(15, 12, "DCC") + Bit(11, 9, "XIPMODE") + Bit(8, 6, "ODS") + Bit(4, "Reset/Hold") + Bit(3, "QUAD") + Bit(2, "DUAL")
 		+ Register("Volatile Configuration Register", 8) + Bit(7, 4, "DCC") + Bit(3, "XIP") + Bit(1, 0, "Wrap")
 		+ Register("Enhanced Volatile Configuration Register", 8) + Bit(7, "QUAD") + Bit(6, "DUAL") + Bit(4, "Reset/Hold") + Bit(3, "VPPACC") + Bit(2, 0, "ODS")
@@ -327,15 +400,46 @@ void addCommands(SpiFlash &spiFlash)
 		+ Register("Lock Register", 8) + Bit(1, "SLD") + Bit(0, "SWL")
 
 		+ Cmd24(0xAF, "Multiple I/O READ ID") /* TODO: */
-		+ Cmd124(0x5A, "SFDP", "Read SFDP Register") + ADDR + DummyBytes(1) + OP_DATA_READ
+		+ Cmd124(0x5A, "SFDP", "Read SFDP Register") + ROLE_READ_SFDP + ADDR + DummyBytes(1) + OP_DATA_READ
 		+ Cmd124(0x0B, "R", "Fast Read") + ADDR + DummyBytes(1) + OP_DATA_READ
 		+ Cmd12(0x3B, "R", "R 1-1-2", "Fast Read Dual Ouput") + ADDR + DummyBytes(1) + DUAL_DATA + OP_DATA_READ
 		+ Cmd12(0xBB, "R", "R 1-2-2", "Fast Read Dual I/O") + DUAL_IO + ADDR + M + DummyBytes(1) + OP_DATA_READ
 		+ Cmd14(0x6B, "R", "R 1-1-4", "Fast Read Quad Output") + ADDR + DummyBytes(1) + QUAD_DATA + OP_DATA_READ
 		+ Cmd14(0xEB, "R", "R 1-4-4", "Fast Read Quad I/O") + QUAD_IO + ADDR + M + DummyBytes(2) + OP_DATA_READ
-
-		+ Cmd124(0x06, "WREN", "Write Enable")
-		+ Cmd124(0x04, "WRDI", "Write Disable")
+		+ Cmd124(0x0D, "R", "DTR Fast Read") + DTR + ADDR + DummyCycles(6) + OP_DATA_READ
+		+ Cmd12(0x3D, "R", "R 1-1D-2D", "DTR Dual Output Fast Read") + DTR + ADDR + DummyCycles(6) + DUAL_DATA + OP_DATA_READ
+		+ Cmd12(0xBD, "R", "R 1-2D-2D", "DTR Dual I/O Fast Read") + DUAL_IO + DTR + ADDR + DummyCycles(6) + OP_DATA_READ
+		+ Cmd14(0x6D, "R", "R 1-1D-4D", "DTR Quad Output Fast Read") + DTR + ADDR + DummyCycles(6) + QUAD_DATA + OP_DATA_READ
+		+ Cmd14(0xED, "R", "R 1-4D-4D", "DTR Quad I/O Fast Read") + QUAD_IO + DTR + ADDR + DummyCycles(8) + OP_DATA_READ
+		+ Cmd1(0x8B, "R", "R 1-1-8", "Octal Output Fast Read") + ADDR + DummyCycles(8) + OCTAL_DATA + OP_DATA_READ
+		+ Cmd1(0xCB, "R", "R 1-8-8", "Octal I/O Fast Read") + OCTAL_IO + ADDR + DummyCycles(16) + OP_DATA_READ
+		+ Cmd1(0x7C, "R", "R 1-1-8", "4-byte Octal Output Fast Read") + ADDR4 + DummyCycles(8) + OCTAL_DATA + OP_DATA_READ
+		+ Cmd1(0xCC, "R", "R 1-8-8", "4-byte Octal I/O Fast Read") + OCTAL_IO + ADDR4 + DummyCycles(16) + OP_DATA_READ
+		+ Cmd1(0x82, "OPP", "Octal Input Fast Program") + ADDR + OCTAL_DATA + OP_DATA_WRITE
+		+ Cmd1(0xC2, "OPP", "Extended Octal Input Fast Program") + OCTAL_IO + ADDR + OP_DATA_WRITE
+
+		// Xccela octal protocol (8-8-8, 8D-8D-8D with opcode repeated on falling edge)
+		+ OPCODE_EXT_REPEAT
+		+ Cmd8(0x06, "WREN", "Write Enable") + ROLE_WRITE_ENABLE
+		+ Cmd8(0x04, "WRDI", "Write Disable") + ROLE_WRITE_DISABLE
+		+ Cmd8(0x05, "RDSR", "Read status register") + DummyCycles(8) + RegisterRead("Status Register-1")
+		+ Cmd8(0x70, "RDFSR", "Read flag status register") + DummyCycles(8) + RegisterRead("Flag Status Register")
+		+ Cmd8(0x81, "WRVCR", "Write volatile configuration register") + ROLE_OTHER_SPACE + ADDR + OP_DATA_WRITE
+		+ Cmd8(0x85, "RDVCR", "Read volatile configuration register") + ROLE_OTHER_SPACE + ADDR + DummyCycles(8) + OP_DATA_READ
+		+ Cmd8(0x9F, "RDID", "Read ID") + DummyCycles(8) + OP_DATA_READ
+		+ Cmd8(0x5A, "SFDP", "Read SFDP Register") + ROLE_READ_SFDP + ADDR + DummyCycles(8) + OP_DATA_READ
+		+ Cmd8(0x0B, "R", "R 8-8-8", "Fast Read") + ADDR + DummyCycles(16) + OP_DATA_READ
+		+ Cmd8(0x02, "PP", "Page Program") + ADDR + OP_DATA_WRITE
+		+ Cmd8(0x20, "SSE", "Subsector erase") + ADDR + EraseSize(0x1000)
+		+ Cmd8(0xD8, "SE", "Sector erase") + ADDR + EraseSize(0x10000)
+		+ Cmd8(0xC7, "BE", "Bulk erase") + EraseSize(ERASE_CHIP)
+		+ Cmd8(0x75, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd8(0x7A, "RESM", "Erase/Program Resume") + ROLE_RESUME
+		+ Cmd8(0x66, "RSTEN", "Enable Reset")
+		+ Cmd8(0x99, "RST", "Reset")
+
+		+ Cmd124(0x06, "WREN", "Write Enable") + ROLE_WRITE_ENABLE
+		+ Cmd124(0x04, "WRDI", "Write Disable") + ROLE_WRITE_DISABLE
 		+ Cmd124(0x05, "RDSR", "Read status register") + RegisterRead("Status Register-1")
 		+ Cmd124(0x01, "WS1", "Write status register") + RegisterWrite("Status Register-1")
 		+ Cmd124(0xE8, "RDLR", "Read lock register") + RegisterRead("Lock Register")
@@ -346,8 +450,8 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd124(0xB1, "WRNVCR", "Write nonvolatile configuration register") + RegisterWrite("Nonvolatile Configuration Register")
 		+ Cmd124(0x85, "RDVCR", "Read volatile configuration register") + RegisterRead("Volatile Configuration Register")
 		+ Cmd124(0x81, "WRVCR", "Write volatile configuration register") + RegisterWrite("Volatile Configuration Register")
-		+ Cmd124(0x85, "RDEVCR", "Read enhanced volatile configuration register") + RegisterRead("Enhanced Volatile Configuration Register")
-		+ Cmd124(0x81, "WREVCR", "Write enhanced volatile configuration register") + RegisterWrite("Enhanced Volatile Configuration Register")
+		+ Cmd124(0x65, "RDEVCR", "Read enhanced volatile configuration register") + RegisterRead("Enhanced Volatile Configuration Register")
+		+ Cmd124(0x61, "WREVCR", "Write enhanced volatile configuration register") + RegisterWrite("Enhanced Volatile Configuration Register")
 
 		+ Cmd124(0x02, "PP", "Page Program") + ADDR + OP_DATA_WRITE
 		+ Cmd12(0xA2, "DPP", "Dual Input Fast Program") + DUAL_DATA + ADDR + OP_DATA_WRITE
@@ -356,14 +460,14 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd14(0x32, "QPP", "Quad Input Fast program") + DUAL_DATA + ADDR + OP_DATA_WRITE
 		+ Cmd14(0x12, "QPP", "Extended Quad Input Fast Program") + DUAL_IO + ADDR + OP_DATA_WRITE
 
-		+ Cmd124(0x20, "SSE", "Subsector erase") + ADDR
-		+ Cmd124(0xD8, "SE", "Sector erase") + ADDR
-		+ Cmd124(0xC7, "BE", "Bulk erase") + ADDR
-		+ Cmd124(0x75, "SUSP", "Erase/Program Suspend")
-		+ Cmd124(0x7A, "RESM", "Erase/Program Resume")
+		+ Cmd124(0x20, "SSE", "Subsector erase") + ADDR + EraseSize(0x1000)
+		+ Cmd124(0xD8, "SE", "Sector erase") + ADDR + EraseSize(0x10000)
+		+ Cmd124(0xC7, "BE", "Bulk erase") + ADDR + EraseSize(ERASE_CHIP)
+		+ Cmd124(0x75, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd124(0x7A, "RESM", "Erase/Program Resume") + ROLE_RESUME
 
-		+ Cmd124(0x75, "ROTP", "Read OTP Array") + OP_DATA_READ
-		+ Cmd124(0x7A, "POTP", "Program OTP Array") + OP_DATA_WRITE
+		+ Cmd124(0x75, "ROTP", "Read OTP Array") + ROLE_OTP + OP_DATA_READ
+		+ Cmd124(0x7A, "POTP", "Program OTP Array") + ROLE_OTP + OP_DATA_WRITE
 
 		+ CommandSet(0xBF, "Microchip", 0xEF)
 		+ Register("Status Register", 8) + Bit(7, "BUSY") + Bit(5, "SEC") + Bit(4, "WPLD") + Bit(3, "WSP") + Bit(2, "WSE") + Bit(1, "WEL") + Bit(0, "BUSY")
@@ -374,26 +478,27 @@ void addCommands(SpiFlash &spiFlash)
 		+ Cmd4(0x35, "RDCR", "Read configuration register") + DummyBytes(1) + RegisterWrite("Configuration Register")
 		+ Cmd4(0x0B, "R", "Fast Read") + ADDR + DummyBytes(3) + OP_DATA_READ
 		+ Cmd1(0xEB, "R", "R 1-4-4", "Fast Read Quad I/O") + QUAD_IO + ADDR + M + DummyBytes(3) + OP_DATA_READ
-		+ Cmd14(0xC0, "SB", "Set Burst Length") + OP_DATA_WRITE
-		+ Cmd4(0x0C, "RBSQI", "Burst Read with Wrap") + ADDR + M + DummyBytes(3) + OP_DATA_READ
-		+ Cmd1(0xEC, "RBSPI", "Burst Read with Wrap") + ADDR + M + DummyBytes(3) + OP_DATA_READ
-		+ Cmd14(0xB0, "SUSP", "Erase/Program Suspend")
-		+ Cmd14(0x30, "RESM", "Erase/Program Resume")
+		+ Register("Burst Length", 8) + Bit(1, 0, "WL")
+		+ Cmd14(0xC0, "SB", "Set Burst Length") + ROLE_SET_READ_PARAMETERS + RegisterWrite("Burst Length")
+		+ Cmd4(0x0C, "RBSQI", "Burst Read with Wrap") + ROLE_READ_WRAP + ADDR + M + DummyBytes(3) + OP_DATA_READ
+		+ Cmd1(0xEC, "RBSPI", "Burst Read with Wrap") + ROLE_READ_WRAP + ADDR + M + DummyBytes(3) + OP_DATA_READ
+		+ Cmd14(0xB0, "SUSP", "Erase/Program Suspend") + ROLE_SUSPEND
+		+ Cmd14(0x30, "RESM", "Erase/Program Resume") + ROLE_RESUME
 
 		+ Cmd1(0x72, "RBPR", "Read Block Protection Register") + OP_DATA_READ
 		+ Cmd4(0x72, "RBPR", "Read Block Protection Register") + DummyBytes(1) + OP_DATA_READ
 		+ Cmd14(0x8D, "LBPR", "Lock Down Block Protection Register")
 		+ Cmd14(0xE8, "nVWLDR", "Non-volatile Write Lock Down Register") + OP_DATA_WRITE
-		+ Cmd14(0x98, "ULBPR", "Global Block Protection Unlock")
-		+ Cmd1(0x88, "RSID", "Read Security ID") + ADDR2 + DummyBytes(1) + OP_DATA_READ
-		+ Cmd4(0x88, "RSID", "Read Security ID") + ADDR2 + DummyBytes(3) + OP_DATA_READ
-		+ Cmd14(0xA5, "PSID", "Program User Security ID Area") + ADDR2 + OP_DATA_WRITE
-		+ Cmd14(0x85, "LSID", "Lockout Security ID Programming")
+		+ Cmd14(0x98, "ULBPR", "Global Block Protection Unlock") + ROLE_GLOBAL_UNLOCK
+		+ Cmd1(0x88, "RSID", "Read Security ID") + ROLE_OTP + ADDR2 + DummyBytes(1) + OP_DATA_READ
+		+ Cmd4(0x88, "RSID", "Read Security ID") + ROLE_OTP + ADDR2 + DummyBytes(3) + OP_DATA_READ
+		+ Cmd14(0xA5, "PSID", "Program User Security ID Area") + ROLE_OTP + ADDR2 + OP_DATA_WRITE
+		+ Cmd14(0x85, "LSID", "Lockout Security ID Programming") + ROLE_LOCK_OTP
 
 		;
 }
 
-SpiFlash::SpiFlash() : mSpiMode(SPI_MODE0), mDefBusMode(SINGLE), mCurBusMode(SINGLE), mCurrentCmd(nullptr), mActiveCmdSet(nullptr), mDataIn(false), mAddressBits(24)
+SpiFlash::SpiFlash() : mSpiMode(SPI_MODE0), mDefBusMode(SINGLE), mCurBusMode(SINGLE), mCurrentCmd(nullptr), mActiveCmdSet(nullptr), mDataIn(false), mDtrProtocol(false), mAddressBits(24)
 {
 	addCommands(*this);
 }
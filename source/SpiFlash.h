@@ -44,16 +44,42 @@ struct BitField
 
 typedef BitField Bit;
 
+// Stable references stored in frames instead of pointers.
+// Known command or register: CMD_REF_KNOWN | command set id << 16 | index in command set
+// Unknown command: CMD_REF_UNKNOWN | opcode
+// Not enough bits for command: CMD_REF_NONE
+// Command frames also carry index of device (CS line) << CMD_REF_DEVICE_SHIFT
+#define CMD_REF_NONE 0
+#define CMD_REF_UNKNOWN 0x40000000
+#define CMD_REF_KNOWN 0x80000000
+#define CMD_REF_MASK 0xFFFFFFFF
+#define CMD_REF_DEVICE_SHIFT 24
+
+// Devices with own CS sharing clock and data lines
+#define MAX_DEVICES 4
+
+static inline U32 MakeRef(int setId, size_t index) { return CMD_REF_KNOWN | (U32(setId) << 16) | U32(index); }
+static inline bool IsKnownRef(U64 ref) { return (ref & CMD_REF_KNOWN) != 0; }
+static inline bool IsUnknownCmdRef(U64 ref) { return (ref & (CMD_REF_KNOWN | CMD_REF_UNKNOWN)) == CMD_REF_UNKNOWN; }
+static inline int RefSetId(U64 ref) { return int((ref >> 16) & 0xFF); }
+static inline U32 RefDevice(U64 ref) { return U32(ref >> CMD_REF_DEVICE_SHIFT) & 0x3F; }
+static inline U32 DeviceRef(U32 ref, U32 device) { return ref != CMD_REF_NONE ? ref | (device << CMD_REF_DEVICE_SHIFT) : ref; }
+static inline size_t RefIndex(U64 ref) { return size_t(ref & 0xFFFF); }
+static inline U8 RefOpcode(U64 ref) { return U8(ref); }
+
 class RegisterData
 {
 	std::vector<BitField> mBits;
 	std::string mName;
 	U8 mLen;
 	U64 mValue;
+	U32 mRef;
 public:
-	RegisterData(const char *name, U8 len = 8) : mName(name), mLen(len) {}
-	RegisterData(const RegisterData &o) : mBits(o.mBits), mName(o.mName), mLen(o.mLen) {}
+	RegisterData(const char *name, U8 len = 8) : mName(name), mLen(len), mRef(CMD_REF_NONE) {}
+	RegisterData(const RegisterData &o) : mBits(o.mBits), mName(o.mName), mLen(o.mLen), mRef(CMD_REF_NONE) {}
 	void SetLength(U8 len) { mLen = len; }
+	void SetRef(U32 ref) { mRef = ref; }
+	U32 GetRef() const { return mRef; }
 	const std::string GetName() const { return mName; }
 	size_t GetBitfieldCount(void) { return mBits.size(); }
 	const BitField &at(size_t ix) { return mBits.at(ix); }
@@ -74,6 +100,22 @@ public:
 	{
 		return mName.compare(name) == 0;
 	}
+	// 1 when BUSY/WIP bit is set or RDY bit is cleared, 0 when ready,
+	// -1 if register does not show operation progress
+	int GetBusy(U64 value) const
+	{
+		for (size_t i = 0; i < mBits.size(); ++i)
+		{
+			const BitField &field = mBits[i];
+			if (field.mUpperBit != field.mLowerBit)
+				continue;
+			if (field.mFieldName == "BUSY" || field.mFieldName == "WIP")
+				return field.GetValue(value) ? 1 : 0;
+			if (field.mFieldName == "RDY")
+				return field.GetValue(value) ? 0 : 1;
+		}
+		return -1;
+	}
 };
 
 enum SpiMode
@@ -90,8 +132,12 @@ enum BusMode
 	SINGLE = 1,
 	DUAL = 2,
 	QUAD = 4,
+	OCTAL = 8,
 };
 
+// Added to bus mode setting, all phases including command on both clock edges (4D-4D-4D)
+#define BUS_MODE_DTR 0x10
+
 enum CmdMode
 {
 	CM_1 = BusMode::SINGLE,
@@ -101,7 +147,19 @@ enum CmdMode
 	CM_14 = (BusMode::SINGLE | BusMode::QUAD),
 	CM_24 = (BusMode::DUAL | BusMode::QUAD),
 	CM_124 = (BusMode::SINGLE | BusMode::DUAL | BusMode::QUAD),
-	CM_ALL = CM_124,
+	CM_8 = BusMode::OCTAL,
+	CM_18 = (BusMode::SINGLE | BusMode::OCTAL),
+	CM_ALL = (CM_124 | CM_8),
+};
+
+// Second opcode byte of octal commands (xSPI command extension)
+enum OpcodeExtension
+{
+	OPCODE_EXT_NONE,
+	// Opcode repeated, octal DTR only (command takes one clock)
+	OPCODE_EXT_REPEAT,
+	// Opcode followed by inverted opcode, octal STR and DTR
+	OPCODE_EXT_INVERT,
 };
 
 enum GeneratedData
@@ -136,6 +194,11 @@ enum CmdFeature
 	SET_SINGLE,
 	SET_DUAL,
 	SET_QUAD,
+	OCTAL_IO,
+	OCTAL_DATA,
+	SET_OCTAL,
+	// Address, M, dummy and data on both clock edges (1-4D-4D)
+	DTR,
 };
 
 enum CmdOp
@@ -147,6 +210,45 @@ enum CmdOp
 	OP_DATA_WRITE,
 };
 
+// Effect of command on device state, used to follow erase/program operations
+enum CmdRole
+{
+	ROLE_NONE,
+	ROLE_WRITE_ENABLE,
+	ROLE_WRITE_DISABLE,
+	ROLE_SUSPEND,
+	ROLE_RESUME,
+	ROLE_POWER_DOWN,
+	ROLE_RELEASE_POWER_DOWN,
+	ROLE_READ_SFDP,
+	// Address is not in main array (IDs, ECC status)
+	ROLE_OTHER_SPACE,
+	// Security registers, OTP area, information row
+	ROLE_OTP,
+	// Following array commands access OTP area (ENSO/EXSO)
+	ROLE_ENTER_OTP,
+	ROLE_EXIT_OTP,
+	// OTP area can't be programmed any more
+	ROLE_LOCK_OTP,
+	ROLE_SECTOR_LOCK,
+	ROLE_SECTOR_UNLOCK,
+	ROLE_GLOBAL_LOCK,
+	ROLE_GLOBAL_UNLOCK,
+	// Wrap length for 1-4-4 reads (0x77)
+	ROLE_SET_WRAP,
+	// Wrap length for burst read with wrap, dummy cycles (0xC0)
+	ROLE_SET_READ_PARAMETERS,
+	// Read wrapping inside of aligned burst (0x0C)
+	ROLE_READ_WRAP,
+	// Commands with default address length use 4-byte address (0xB7/0xE9)
+	ROLE_ENTER_4BYTE,
+	ROLE_EXIT_4BYTE,
+	// Register holding A31-A24 of 3-byte addresses (0xC5)
+	ROLE_WRITE_EXTENDED_ADDRESS,
+	// Bank address register, bit 7 enables 4-byte address, rest is A31-A24 (0x17)
+	ROLE_WRITE_BANK_REGISTER,
+};
+
 struct DummyBytes
 {
 	U8 mCnt;
@@ -159,6 +261,15 @@ struct DummyCycles
 	DummyCycles(U8 cnt) : mCnt(cnt) {}
 };
 
+// Erase size in bytes, whole chip for ERASE_CHIP
+#define ERASE_CHIP 0xFFFFFFFF
+
+struct EraseSize
+{
+	U32 mSize;
+	EraseSize(U32 size) : mSize(size) {}
+};
+
 struct RegisterOp
 {
 	std::string mName;
@@ -189,18 +300,23 @@ public:
 	CmdOp mCmdOp;
 	uint8_t mAddressBits; // 0 - command does not have address, 0xFF = default length
 	bool mContinuousRead;
+	// Phases after command byte sampled on both clock edges
+	bool mDtr;
 	bool mDummyBytes;
 	bool mDummyCycles;
 	U8 mDummyCount;
 	U8 mModeChange;
 	U8 mModeArgs;
 	U8 mModeData;
+	U32 mEraseSize;
+	CmdRole mRole;
+	U32 mRef;
 	std::vector<std::string> mNames;
 	std::vector<RegisterData *> mRegs;
 public:
 	SpiCmdData(U8 code, CmdMode mode, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) : mCode(code), mMode(mode),
-		mCmdOp(OP_NO_DATA), mAddressBits(0), mDummyBytes(false), mDummyCycles(false), mContinuousRead(false),
-		mModeChange(0), mModeArgs(0), mModeData(0)
+		mCmdOp(OP_NO_DATA), mAddressBits(0), mDtr(false), mDummyBytes(false), mDummyCycles(false), mDummyCount(0), mContinuousRead(false),
+		mModeChange(0), mModeArgs(0), mModeData(0), mEraseSize(0), mRole(ROLE_NONE), mRef(CMD_REF_NONE)
 	{
 		mNames.push_back(std::string(n1));
 		if (n2)
@@ -211,16 +327,51 @@ public:
 	~SpiCmdData() {}
 
 	U8 GetCode() const { return mCode; }
+	void SetRef(U32 ref) { mRef = ref; }
+	U32 GetRef() const { return mRef; }
 
 	bool IsSingle() const { return (mMode & CmdMode::CM_1) != 0; }
 	bool IsDual() const { return (mMode & CmdMode::CM_2) != 0; }
 	bool IsQuad() const { return (mMode & CmdMode::CM_4) != 0; }
+	bool IsOctal() const { return (mMode & CmdMode::CM_8) != 0; }
 	bool IsValidForMode(BusMode mode) const { return (mMode & mode) != 0; }
 
 	void AddName(const char *name) { mNames.push_back(name); }
 	void AddReg(RegisterData *reg) { mRegs.push_back(reg); }
-	RegisterData *GetRegister(size_t ix) { return mRegs.size() ? mRegs.at(ix % mRegs.size()) : nullptr; }
+	RegisterData *GetRegister(size_t ix) const { return mRegs.size() ? mRegs.at(ix % mRegs.size()) : nullptr; }
 	size_t RegisterCount() const { return mRegs.size(); }
+	// Register read that shows whether erase/program is in progress
+	bool IsBusyPoll() const
+	{
+		if (mCmdOp != OP_REG_READ)
+			return false;
+		for (size_t i = 0; i < mRegs.size(); ++i)
+			if (mRegs[i]->GetBusy(0) >= 0)
+				return true;
+		return false;
+	}
+	// Busy state from last register byte read by this command, -1 if not known
+	int GetBusy(const std::vector<U8> &data) const
+	{
+		if (data.empty() || !IsBusyPoll())
+			return -1;
+		return GetRegister(data.size() - 1)->GetBusy(data.back());
+	}
+	// Address points to main flash array
+	bool IsArrayAccess() const
+	{
+		return mAddressBits != 0 && mRole != ROLE_READ_SFDP && mRole != ROLE_OTHER_SPACE && mRole != ROLE_OTP;
+	}
+	// Read JEDEC ID, first data byte is manufacturer ID
+	bool IsJedecIdRead() const { return GetCode() == 0x9F && mCmdOp == OP_DATA_READ; }
+	// Erase, program or register write, device is busy after CS goes inactive
+	bool StartsBusyOperation() const
+	{
+		if (mRole == ROLE_SET_WRAP || mRole == ROLE_SET_READ_PARAMETERS || mRole == ROLE_WRITE_EXTENDED_ADDRESS ||
+			mRole == ROLE_WRITE_BANK_REGISTER)
+			return false;
+		return mEraseSize != 0 || mCmdOp == OP_DATA_WRITE || mCmdOp == OP_REG_WRITE;
+	}
 
 	void Set(CmdFeature feature)
 	{
@@ -259,6 +410,18 @@ public:
 		case SET_QUAD:
 			mModeChange = CM_4;
 			break;
+		case OCTAL_IO:
+			mModeArgs = 8;
+			break;
+		case OCTAL_DATA:
+			mModeData = 8;
+			break;
+		case SET_OCTAL:
+			mModeChange = CM_8;
+			break;
+		case DTR:
+			mDtr = true;
+			break;
 		default:
 			break;
 		}
@@ -266,6 +429,8 @@ public:
 	void Set(CmdOp op) { mCmdOp = op; }
 	void Set(const DummyBytes &db) { mDummyCount = db.mCnt; mDummyBytes = true; mDummyCycles = false; }
 	void Set(const DummyCycles &db) { mDummyCount = db.mCnt; mDummyBytes = false; mDummyCycles = true; }
+	void Set(const EraseSize &es) { mEraseSize = es.mSize; }
+	void Set(CmdRole role) { mRole = role; }
 };
 
 class CmdSet
@@ -277,11 +442,26 @@ class CmdSet
 	CmdSet *mParent;
 	std::string mName;
 	int mId;
+	OpcodeExtension mOpcodeExtension;
 public:
 	int GetId() const { return mId; }
 	const std::string &GetName() const { return mName; }
-	CmdSet(int id, const std::string name, CmdSet *parent = nullptr) : mId(id), mName(name), mParent(parent) {}
-	void AddRegister(RegisterData *reg) { mRegisters.push_back(reg); }
+	CmdSet(int id, const std::string name, CmdSet *parent = nullptr) : mId(id), mName(name), mParent(parent),
+		mOpcodeExtension(OPCODE_EXT_NONE) {}
+	void SetOpcodeExtension(OpcodeExtension ext) { mOpcodeExtension = ext; }
+	OpcodeExtension GetOpcodeExtension() const
+	{
+		if (mOpcodeExtension == OPCODE_EXT_NONE && mParent)
+			return mParent->GetOpcodeExtension();
+		return mOpcodeExtension;
+	}
+	void AddRegister(RegisterData *reg)
+	{
+		reg->SetRef(MakeRef(mId, mRegisters.size()));
+		mRegisters.push_back(reg);
+	}
+	RegisterData *GetRegisterByIndex(size_t ix) const { return ix < mRegisters.size() ? mRegisters[ix] : nullptr; }
+	SpiCmdData *GetCommandByIndex(size_t ix) const { return ix < mCommands.size() ? mCommands[ix].get() : nullptr; }
 	RegisterData *GetRegister(const char *name)
 	{
 		std::vector<RegisterData *>::iterator i;
@@ -303,6 +483,7 @@ public:
 
 	void AddCommand(SpiCmdData *cmd)
 	{
+		cmd->SetRef(MakeRef(mId, mCommands.size()));
 		mCommands.push_back(std::auto_ptr<SpiCmdData>(cmd));
 		if (cmd->IsSingle())
 			mCommandMap[(uint16_t)cmd->GetCode()] = cmd;
@@ -310,6 +491,8 @@ public:
 			mCommandMap[0x200 + cmd->GetCode()] = cmd;
 		if (cmd->IsQuad())
 			mCommandMap[0x400 + cmd->GetCode()] = cmd;
+		if (cmd->IsOctal())
+			mCommandMap[0x800 + cmd->GetCode()] = cmd;
 	}
 	void SetParent(CmdSet *parent) { mParent = parent; }
 	void GetValidCommands(BusMode busMode, std::vector<U8> &cmds) const
@@ -359,6 +542,9 @@ public:
 		case QUAD:
 			key = 0x400 + code;
 			break;
+		case OCTAL:
+			key = 0x800 + code;
+			break;
 		}
 		CommandMap::iterator i = mCommandMap.find(key);
 		if (i != mCommandMap.end())
@@ -395,6 +581,8 @@ class SpiFlash
 	SpiMode mSpiMode;
 	U32 mAddressBits;
 	bool mDataIn;
+	// Command byte also on both clock edges (4D-4D-4D)
+	bool mDtrProtocol;
 public:
 	void SetSpiMode(SpiMode mode) { mSpiMode = mode; }
 	U8 IdleClockState() const { return mSpiMode < 2 ? CLOCK_LOW : CLOCK_HIGH; }
@@ -402,9 +590,11 @@ public:
 	SpiFlash();
 	void SetDefaultBusMode(BusMode mode) { mDefBusMode = mode; }
 	void SetCurrentBusMode(BusMode mode) { if (mode) mCurBusMode = mode; }
+	void SetDtrProtocol(bool dtr) { mDtrProtocol = dtr; }
+	void SetAddressBits(U32 bits) { mAddressBits = bits; }
 	BusMode GetCurrentBusMode() const { return mCurBusMode; }
 	BusMode GetDefaultBusMode() const { return mDefBusMode; }
-	void GenerateByte(U8 b, std::vector<U8> &bits);
+	void GenerateByte(U8 b, std::vector<U8> &bits, bool dtr = false);
 	void GenerateCommandBits(SpiCmdData *cmd, std::vector<U8> &bits);
 	void GenerateRandomCommandBits(std::vector<U8> &bits);
 	SpiCmdData *GetCurrentCommand() const { return mCurrentCmd; }
@@ -414,14 +604,33 @@ public:
 	{
 		return mActiveCmdSet ? mActiveCmdSet->GetCommand(mode, code) : nullptr;
 	}
-	CmdSet *GetCommandSet(uint8_t id)
+	OpcodeExtension GetOpcodeExtension() const
 	{
-		CommandSets::iterator i;
+		return mActiveCmdSet ? mActiveCmdSet->GetOpcodeExtension() : OPCODE_EXT_NONE;
+	}
+	CmdSet *GetCommandSet(int id) const
+	{
+		CommandSets::const_iterator i;
 		for (i = mCmdSets.begin(); i != mCmdSets.end(); ++i)
 			if ((*i)->GetId() == id)
 				return *i;
 		return nullptr;
 	}
+	// Command set of manufacturer from JEDEC ID, nullptr for unknown manufacturer
+	CmdSet *GetCommandSetByJedecId(U8 manufacturer) const
+	{
+		return manufacturer ? GetCommandSet(manufacturer) : nullptr;
+	}
+	SpiCmdData *GetCommandByRef(U64 ref) const
+	{
+		CmdSet *cmdSet = IsKnownRef(ref) ? GetCommandSet(RefSetId(ref)) : nullptr;
+		return cmdSet ? cmdSet->GetCommandByIndex(RefIndex(ref)) : nullptr;
+	}
+	RegisterData *GetRegisterByRef(U64 ref) const
+	{
+		CmdSet *cmdSet = IsKnownRef(ref) ? GetCommandSet(RefSetId(ref)) : nullptr;
+		return cmdSet ? cmdSet->GetRegisterByIndex(RefIndex(ref)) : nullptr;
+	}
 	const std::vector<CmdSet *> &getCommandSets() const { return mCmdSets; }
 	void GetValidCommands(std::vector<U8> &cmds) const
 	{
@@ -477,6 +686,20 @@ public:
 
 		return *this;
 	}
+	SpiFlash &operator+(OpcodeExtension ext)
+	{
+		if (mActiveCmdSet)
+			mActiveCmdSet->SetOpcodeExtension(ext);
+
+		return *this;
+	}
+	SpiFlash &operator+(CmdRole role)
+	{
+		if (mCurrentCmd)
+			mCurrentCmd->Set(role);
+
+		return *this;
+	}
 	SpiFlash &operator+(const DummyBytes &db)
 	{
 		if (mCurrentCmd)
@@ -488,6 +711,15 @@ public:
 	{
 		if (mCurrentCmd)
 			mCurrentCmd->Set(dc);
+
+		return *this;
+	}
+	SpiFlash &operator+(const EraseSize &es)
+	{
+		if (mCurrentCmd)
+			mCurrentCmd->Set(es);
+
+		return *this;
 	}
 	SpiFlash &operator+(const BitField &field)
 	{
@@ -522,6 +754,8 @@ static SpiCmdData *Cmd12(U8 ins, const char *n1, const char *n2 = nullptr, const
 static SpiCmdData *Cmd4(U8 ins, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) { return Cmd(ins, CM_4, n1, n2, n3); }
 static SpiCmdData *Cmd14(U8 ins, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) { return Cmd(ins, CM_14, n1, n2, n3); }
 static SpiCmdData *Cmd24(U8 ins, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) { return Cmd(ins, CM_24, n1, n2, n3); }
+static SpiCmdData *Cmd8(U8 ins, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) { return Cmd(ins, CM_8, n1, n2, n3); }
+static SpiCmdData *Cmd18(U8 ins, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) { return Cmd(ins, CM_18, n1, n2, n3); }
 static SpiCmdData *Cmd124(U8 ins, const char *n1, const char *n2 = nullptr, const char *n3 = nullptr) { return Cmd(ins, CM_124, n1, n2, n3); }
 
 extern SpiFlash spiFlash;
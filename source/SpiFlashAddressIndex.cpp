@@ -0,0 +1,221 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include "SpiFlashAddressIndex.h"
+
+static bool RangeLess(const AddressRange &a, const AddressRange &b)
+{
+	return a.mFirst < b.mFirst || (a.mFirst == b.mFirst && a.mTransaction < b.mTransaction);
+}
+
+void AddressIndex::Add(U32 first, U32 last, U64 transaction)
+{
+	AddressRange range = { first, last, last, transaction };
+
+	std::lock_guard<std::mutex> lock(mLock);
+	mPending.push_back(range);
+}
+
+size_t AddressIndex::GetCount()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	return mRanges.size() + mPending.size();
+}
+
+// Ranges sorted by start form implicit binary tree where node at index i
+// of level k has children at i -/+ 2^(k-1), leaves are at even indexes.
+void AddressIndex::Build()
+{
+	if (mPending.empty())
+		return;
+
+	std::sort(mPending.begin(), mPending.end(), RangeLess);
+	size_t mid = mRanges.size();
+	mRanges.insert(mRanges.end(), mPending.begin(), mPending.end());
+	std::inplace_merge(mRanges.begin(), mRanges.begin() + mid, mRanges.end(), RangeLess);
+	mPending.clear();
+
+	S64 n = S64(mRanges.size());
+	S64 i;
+	S64 lastIx = 0;
+	U32 last = 0;
+	int k;
+
+	for (i = 0; i < n; i += 2)
+	{
+		lastIx = i;
+		last = mRanges[i].mMaxLast = mRanges[i].mLast;
+	}
+	for (k = 1; (S64(1) << k) <= n; ++k)
+	{
+		S64 x = S64(1) << (k - 1);
+		S64 i0 = (x << 1) - 1;
+		S64 step = x << 2;
+		for (i = i0; i < n; i += step)
+		{
+			U32 el = mRanges[i - x].mMaxLast;
+			U32 er = i + x < n ? mRanges[i + x].mMaxLast : last;
+			U32 e = mRanges[i].mLast;
+			e = std::max(e, std::max(el, er));
+			mRanges[i].mMaxLast = e;
+		}
+		// Move to parent of last node, it may be outside of array
+		lastIx = ((lastIx >> k) & 1) ? lastIx - x : lastIx + x;
+		if (lastIx < n && mRanges[lastIx].mMaxLast > last)
+			last = mRanges[lastIx].mMaxLast;
+	}
+	mRootLevel = k - 1;
+}
+
+void AddressIndex::Query(U32 first, U32 last, std::vector<AddressRange> &result)
+{
+	struct StackEntry
+	{
+		S64 x;
+		int k;
+		bool leftDone;
+	} stack[64];
+	int t = 0;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	Build();
+	result.clear();
+	if (mRanges.empty())
+		return;
+
+	const S64 n = S64(mRanges.size());
+	const AddressRange *r = &mRanges[0];
+
+	stack[t].k = mRootLevel;
+	stack[t].x = (S64(1) << mRootLevel) - 1;
+	stack[t++].leftDone = false;
+	while (t)
+	{
+		StackEntry z = stack[--t];
+		if (z.k <= 3)
+		{
+			// Small subtree, scan it linearly
+			S64 i0 = z.x >> z.k << z.k;
+			S64 i1 = i0 + (S64(1) << (z.k + 1)) - 1;
+			if (i1 >= n)
+				i1 = n;
+			for (S64 i = i0; i < i1 && r[i].mFirst <= last; ++i)
+				if (first <= r[i].mLast)
+					result.push_back(r[i]);
+		}
+		else if (!z.leftDone)
+		{
+			S64 y = z.x - (S64(1) << (z.k - 1));
+			stack[t].k = z.k;
+			stack[t].x = z.x;
+			stack[t++].leftDone = true;
+			// Left child can be outside of array, or it may contain overlapping ranges
+			if (y >= n || r[y].mMaxLast >= first)
+			{
+				stack[t].k = z.k - 1;
+				stack[t].x = y;
+				stack[t++].leftDone = false;
+			}
+		}
+		else if (z.x < n && r[z.x].mFirst <= last)
+		{
+			if (first <= r[z.x].mLast)
+				result.push_back(r[z.x]);
+			stack[t].k = z.k - 1;
+			stack[t].x = z.x + (S64(1) << (z.k - 1));
+			stack[t++].leftDone = false;
+		}
+	}
+}
+
+static void Write32(std::ofstream &f, U32 v)
+{
+	U8 b[4] = { U8(v), U8(v >> 8), U8(v >> 16), U8(v >> 24) };
+	f.write(reinterpret_cast<const char *>(b), 4);
+}
+
+// File: "SFAIDX1\0", U64 count, then count times U32 first, U32 last, U64 transaction
+// ordered by first address, all little endian
+bool AddressIndex::Save(const char *file)
+{
+	std::ofstream f(file, std::ios::out | std::ios::binary);
+
+	if (!f.is_open())
+		return false;
+
+	std::lock_guard<std::mutex> lock(mLock);
+	Build();
+
+	U64 count = mRanges.size();
+	f.write("SFAIDX1", 8);
+	Write32(f, U32(count));
+	Write32(f, U32(count >> 32));
+	for (size_t i = 0; i < mRanges.size(); ++i)
+	{
+		Write32(f, mRanges[i].mFirst);
+		Write32(f, mRanges[i].mLast);
+		Write32(f, U32(mRanges[i].mTransaction));
+		Write32(f, U32(mRanges[i].mTransaction >> 32));
+	}
+	f.close();
+
+	return true;
+}
+
+bool AddressIndex::ParseRange(const char *text, U32 &first, U32 &last)
+{
+	char *end;
+
+	if (text == nullptr)
+		return false;
+
+	unsigned long long a = strtoull(text, &end, 0);
+	if (end == text || a > 0xFFFFFFFFULL)
+		return false;
+	while (*end == ' ')
+		end++;
+
+	first = last = U32(a);
+	if (*end == '\0')
+		return true;
+
+	char sep = *end++;
+	const char *s = end;
+	unsigned long long b = strtoull(s, &end, 0);
+	if (end == s || *end != '\0')
+		return false;
+
+	if (sep == '-' && b >= a && b <= 0xFFFFFFFFULL)
+		last = U32(b);
+	else if (sep == '+' && b > 0 && a + b - 1 <= 0xFFFFFFFFULL)
+		last = U32(a + b - 1);
+	else
+		return false;
+
+	return true;
+}
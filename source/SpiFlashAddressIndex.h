@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_ADDRESS_INDEX_H
+#define SPIFLASH_ADDRESS_INDEX_H
+
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct AddressRange
+{
+	U32 mFirst;
+	// Last address (inclusive) so whole 4 GiB space can be expressed
+	U32 mLast;
+	// Biggest mLast in subtree (implicit interval tree)
+	U32 mMaxLast;
+	U64 mTransaction;
+};
+
+// Interval tree over addresses touched by transactions.
+// Ranges are collected during decode, tree is (re)built lazily on first
+// query after new ranges arrived, queries are O(log n + k).
+class AddressIndex
+{
+	std::vector<AddressRange> mRanges;
+	// Ranges added since last query
+	std::vector<AddressRange> mPending;
+	int mRootLevel;
+	mutable std::mutex mLock;
+
+	void Build();
+public:
+	AddressIndex() : mRootLevel(-1) {}
+
+	void Add(U32 first, U32 last, U64 transaction);
+	// Transactions overlapping [first, last] in address order
+	void Query(U32 first, U32 last, std::vector<AddressRange> &result);
+	bool Save(const char *file);
+	size_t GetCount();
+
+	// Accepts "start-end", "start+length" or single address
+	static bool ParseRange(const char *text, U32 &first, U32 &last);
+};
+
+#endif //SPIFLASH_ADDRESS_INDEX_H
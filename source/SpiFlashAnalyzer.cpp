@@ -27,11 +27,19 @@ SOFTWARE.
 #include "SpiFlashAnalyzerResults.h"
 
 #include "SpiFlash.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <chrono>
 
 SpiFlashAnalyzer::SpiFlashAnalyzer()
 	: Analyzer2(),
 	mSettings(new SpiFlashAnalyzerSettings()),
-	mSimulationInitilized(false)
+	mSimulationInitilized(false),
+	mReruns(0),
+	mInferring(false),
+	mHoldPending(0),
+	mDataPosition(0)
 {
 	SetAnalyzerSettings(mSettings.get());
 }
@@ -39,6 +47,7 @@ SpiFlashAnalyzer::SpiFlashAnalyzer()
 SpiFlashAnalyzer::~SpiFlashAnalyzer()
 {
 	KillThread();
+	mCache.Finish(mCacheState);
 }
 
 AnalyzerChannelData *SpiFlashAnalyzer::GetAnalyzerChannelData(Channel& channel)
@@ -59,6 +68,9 @@ void SpiFlashAnalyzer::SetupResults()
 		mResults->AddChannelBubblesWillAppearOn(mSettings->mChipSelect);
 	else
 		mResults->AddChannelBubblesWillAppearOn(mSettings->mClock);
+	for (U32 i = 1; i < MAX_DEVICES; ++i)
+		if (mSettings->GetChipSelect(i) != UNDEFINED_CHANNEL)
+			mResults->AddChannelBubblesWillAppearOn(mSettings->GetChipSelect(i));
 
 	if (mSettings->mMosi != UNDEFINED_CHANNEL)
 		mResults->AddChannelBubblesWillAppearOn(mSettings->mMosi);
@@ -70,6 +82,10 @@ void SpiFlashAnalyzer::SetupResults()
 void SpiFlashAnalyzer::AddFrame(U64 start, U64 end, U64 d1, U64 d2, U8 type, U8 flags)
 {
 	Frame f;
+
+	if (mInferring)
+		return;
+
 	f.mStartingSampleInclusive = S64(start);
 	f.mEndingSampleInclusive = S64(end);
 	f.mData1 = d1;
@@ -77,57 +93,549 @@ void SpiFlashAnalyzer::AddFrame(U64 start, U64 end, U64 d1, U64 d2, U8 type, U8
 	f.mFlags = flags;
 	f.mType = type;
 
-	mResults->AddFrame(f);
-	mResults->CommitResults();
+	// Results decide when frame becomes visible (status polls are held back)
+	mResults->AddDecodedFrame(f);
+	mCache.AddFrame(f);
 }
 
-// TODO: Remove this once there is no going back in time
-U64 pos;
+ChannelReader *SpiFlashAnalyzer::AttachChannel(ChannelReader &reader, Channel &channel)
+{
+	AnalyzerChannelData *data = GetAnalyzerChannelData(channel);
 
-void SpiFlashAnalyzer::Setup()
+	if (data == nullptr)
+		return nullptr;
+	reader.Attach(data);
+	return &reader;
+}
+
+void SpiFlashAnalyzer::ResetDecodeState(BusMode busMode, SpiCmdData *lockedCmd)
 {
-	mLockedCmd = nullptr;
-	mChipSelect = GetAnalyzerChannelData(mSettings->mChipSelect);
-	mClock = GetAnalyzerChannelData(mSettings->mClock);
-	mMosi = GetAnalyzerChannelData(mSettings->mMosi);
-	mMiso = GetAnalyzerChannelData(mSettings->mMiso);
-	mD2 = GetAnalyzerChannelData(mSettings->mD2);
-	mD3 = GetAnalyzerChannelData(mSettings->mD3);
 	if (mSettings->mSpiMode == 0)
 		mClockIdleState = BIT_LOW;
 	else if (mSettings->mSpiMode == 3)
 		mClockIdleState = BIT_HIGH;
 
-	mDefaultBusMode = BusMode(mSettings->mBusMode);
+	mDefaultBusMode = busMode;
+	// Whole protocol in DTR (4D-4D-4D), command byte included
+	mDtrProtocol = (mSettings->mBusMode & BUS_MODE_DTR) != 0;
 	mCurrentBusMode = mDefaultBusMode;
+	mAddressLength = mSettings->mAddressLength;
+	mExtendedAddress = 0;
+	mLockedCmd = lockedCmd;
+	if (lockedCmd)
+		UpdateBusMode(BusMode(lockedCmd->mModeData));
+
+	// Every device starts in same state, with command set of its own manufacturer
+	for (U32 i = 0; i < MAX_DEVICES; ++i)
+	{
+		DeviceState &d = mDevices[i];
+		d.mDefaultBusMode = mDefaultBusMode;
+		d.mLockedCmd = mLockedCmd;
+		d.mAddressLength = mAddressLength;
+		d.mExtendedAddress = 0;
+		d.mCmdSet = spiFlash.GetCommandSet(mSettings->GetManufacturer(i));
+		if (d.mCmdSet == nullptr)
+			d.mCmdSet = spiFlash.GetCommandSet(0);
+		d.mCmdSetConfirmed = false;
+	}
+	mDevice = 0;
+	mChipSelect = mDevices[0].mChipSelect;
+	mCmdSet = mDevices[0].mCmdSet;
+	mCmdSetConfirmed = false;
+	mCmdSetPlanPos = 0;
+	mCmdSetSwitches.clear();
+	mSeenSinceId.clear();
+	mReinterpret = false;
+
+	mCachedClockCount = 0;
+	mHoldPending = 0;
+	mCommandEnd = 0;
+	mClockRecovery.Reset(mSettings->mGapPeriods);
+	mDataPosition = 0;
+}
+
+void SpiFlashAnalyzer::Setup()
+{
+	// Transactions cached by previous run are kept
+	mCache.Finish(mCacheState);
+
+	mDevices[0].mChipSelect = AttachChannel(mReaders[0], mSettings->mChipSelect);
+	mDeviceCount = 1;
+	for (U32 i = 1; i < MAX_DEVICES; ++i)
+	{
+		Channel chipSelect = mSettings->GetChipSelect(i);
+		mDevices[i].mChipSelect = mDevices[0].mChipSelect ? AttachChannel(mReaders[9 + i], chipSelect) : nullptr;
+		if (mDevices[i].mChipSelect)
+			mDeviceCount++;
+	}
+	mClock = AttachChannel(mReaders[1], mSettings->mClock);
+	mMosi = AttachChannel(mReaders[2], mSettings->mMosi);
+	mMiso = AttachChannel(mReaders[3], mSettings->mMiso);
+	mD2 = AttachChannel(mReaders[4], mSettings->mD2);
+	mD3 = AttachChannel(mReaders[5], mSettings->mD3);
+	mD4 = AttachChannel(mReaders[6], mSettings->mD4);
+	mD5 = AttachChannel(mReaders[7], mSettings->mD5);
+	mD6 = AttachChannel(mReaders[8], mSettings->mD6);
+	mD7 = AttachChannel(mReaders[9], mSettings->mD7);
+	ChannelReader *lines[8] = { mMosi, mMiso, mD2, mD3, mD4, mD5, mD6, mD7 };
+	memcpy(mLines, lines, sizeof(mLines));
+
+	// Auto start state begins as single, inferred later
+	BusMode busMode = BusMode(mSettings->mBusMode & ~BUS_MODE_DTR);
+	if (busMode == 0)
+		busMode = SINGLE;
 	// Continues read mode selected as starting point
+	SpiCmdData *lockedCmd = nullptr;
 	U8 manufacturer = (U8)(mSettings->mContinuousRead >> 8);
 	U8 code = (U8)mSettings->mContinuousRead;
 	CmdSet *cmdSet = spiFlash.GetCommandSet(manufacturer);
 	if (cmdSet)
+		lockedCmd = cmdSet->GetCommand(busMode, code);
+	ResetDecodeState(busMode, lockedCmd);
+	mResults->SetupAnalyses(GetSampleRate());
+
+	// Command set switches found by previous run apply to same settings only
+	std::string key = mSettings->GetDecodeKey(GetSampleRate());
+	if (key != mCmdSetPlanKey)
+	{
+		mCmdSetPlanKey = key;
+		mCmdSetPlan.clear();
+		mReruns = 0;
+	}
+	for (size_t i = 0; i < mCmdSetPlan.size(); ++i)
 	{
-		SpiCmdData *cmd = cmdSet->GetCommand(mCurrentBusMode, code);
-		if (cmd != NULL)
+		char sw[24];
+		snprintf(sw, sizeof(sw), " %llx", (unsigned long long)mCmdSetPlan[i]);
+		key += sw;
+	}
+
+	// Without CS there is no safe place to resume decoding after cached frames,
+	// cache state keeps only one device
+	if (mSettings->mDecodeCache && mChipSelect && mDeviceCount == 1)
+		mCache.Begin(key);
+	else
+		mCache.Close();
+	UpdateCacheState();
+}
+
+void SpiFlashAnalyzer::InferStartState()
+{
+	ChannelReader *channels[10] = { mChipSelect, mClock, mMosi, mMiso, mD2, mD3, mD4, mD5, mD6, mD7 };
+	U32 transactions = 0;
+	int i;
+
+	// Record first transactions, every start state is decoded from memory one after another
+	for (i = 0; i < 10; ++i)
+		if (channels[i])
+			channels[i]->StartRecording();
+	while (transactions < INFER_TRANSACTIONS && mChipSelect->RecordNextEdge())
+		if (mChipSelect->GetBitState() == BIT_HIGH)
+			transactions++;
+	U64 end = mChipSelect->GetSampleNumber();
+	for (i = 0; i < 10; ++i)
+		if (channels[i])
+			channels[i]->RecordTo(end);
+
+	// Command mode first, equal score keeps earlier state
+	std::vector<const SpiCmdData *> continuousReads;
+	mCmdSet->GetContinousReadCommands(continuousReads);
+	// Higher opcodes first, so 0xEB Quad I/O read wins over word reads with same score
+	std::vector<U8> codes;
+	for (size_t j = 0; j < continuousReads.size(); ++j)
+		codes.push_back(continuousReads[j]->GetCode());
+	std::sort(codes.begin(), codes.end(), std::greater<U8>());
+	codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+	std::vector<StartState> states;
+	BusMode busModes[] = { SINGLE, DUAL, QUAD };
+	for (i = 0; i < 3; ++i)
+	{
+		BusMode busMode = busModes[i];
+		if ((busMode == DUAL && mMiso == nullptr) || (busMode == QUAD && (mD2 == nullptr || mD3 == nullptr)))
+			continue;
+		StartState state = { busMode, nullptr };
+		states.push_back(state);
+		for (size_t j = 0; j < codes.size(); ++j)
 		{
-			mLockedCmd = cmd;
-			mCurrentBusMode = BusMode(cmd->mModeData);
+			state.mLockedCmd = mCmdSet->GetCommand(busMode, codes[j]);
+			if (state.mLockedCmd && state.mLockedCmd->mContinuousRead)
+				states.push_back(state);
 		}
 	}
-	mCachedClockCount = 0;
-	pos = 0;
+
+	size_t best = 0;
+	int bestScore = 0;
+	mInferring = true;
+	for (size_t s = 0; s < states.size(); ++s)
+	{
+		for (i = 0; i < 10; ++i)
+			if (channels[i])
+				channels[i]->Rewind(true);
+		ResetDecodeState(states[s].mBusMode, states[s].mLockedCmd);
+		mInferScore = 0;
+		for (U32 n = 0; n < transactions; ++n)
+		{
+			AdvanceToCommandStart();
+			AnalyzeCommandBits();
+		}
+		if (s == 0 || mInferScore > bestScore)
+		{
+			best = s;
+			bestScore = mInferScore;
+		}
+	}
+	mInferring = false;
+
+	// Decode from start with the best state, recorded edges continue with live data
+	for (i = 0; i < 10; ++i)
+		if (channels[i])
+			channels[i]->Rewind(false);
+	ResetDecodeState(states[best].mBusMode, states[best].mLockedCmd);
+}
+
+U32 SpiFlashAnalyzer::ClockEdgesLeft()
+{
+	U32 count = 0;
+
+	CacheClock(1);
+	for (int i = 0; i < mCachedClockCount; ++i)
+		if ((mCachedClocks[i] >> 1) < mCommandEnd)
+			count++;
+	return count;
+}
+
+void SpiFlashAnalyzer::UpdateCacheState()
+{
+	mCacheState.mResumeSample = mCommandEnd;
+	mCacheState.mLockedCmdRef = mLockedCmd ? mLockedCmd->GetRef() : CMD_REF_NONE;
+	mCacheState.mDefaultBusMode = U8(mDefaultBusMode);
+	mCacheState.mClockIdleState = U8(mClockIdleState);
+	mCacheState.mAddressLength = U8(mAddressLength);
+	mCacheState.mExtendedAddress = mExtendedAddress;
+	mCacheState.mCmdSetId = U8(mCmdSet->GetId());
+	mCacheState.mCmdSetConfirmed = mCmdSetConfirmed;
+}
+
+bool SpiFlashAnalyzer::GetCacheEdgeHash(U64 start, bool wait, U64 &hash, U64 &end)
+{
+	ChannelReader *channels[9] = { mClock, mLines[0], mLines[1], mLines[2], mLines[3], mLines[4], mLines[5],
+		mLines[6], mLines[7] };
+	U64 sample;
+
+	// Transaction ends at second CS edge from start
+	if (mChipSelect->GetSampleNumber() != start || !mChipSelect->PeekEdge(0, sample, wait) ||
+		!mChipSelect->PeekEdge(1, end, wait))
+		return false;
+	hash = Fnv1a(&sample, sizeof(sample));
+	hash = Fnv1a(&end, sizeof(end), hash);
+
+	// Edges are looked at without moving channels, clock edges already read are cached
+	for (U32 i = 0; i < 9; ++i)
+	{
+		ChannelReader *channel = channels[i];
+		U32 edges = 0;
+
+		if (channel == nullptr)
+			continue;
+		if (channel == mClock)
+		{
+			for (int j = 0; j < mCachedClockCount; ++j)
+			{
+				sample = mCachedClocks[j] >> 1;
+				if (sample > start && sample <= end)
+				{
+					hash = Fnv1a(&sample, sizeof(sample), Fnv1a(&i, sizeof(i), hash));
+					edges++;
+				}
+			}
+		}
+		else if (channel->GetSampleNumber() > start)
+		{
+			return false;
+		}
+
+		for (size_t ahead = 0;; ++ahead)
+		{
+			// Data up to end is captured, edge that is not there yet comes after end
+			if (!channel->PeekEdge(ahead, sample, false) || sample > end)
+				break;
+			if (sample > start)
+			{
+				// Peeked edges are kept until decoded, too long transaction is not hashed
+				if (edges >= CACHE_MAX_EDGES)
+					return false;
+				hash = Fnv1a(&sample, sizeof(sample), Fnv1a(&i, sizeof(i), hash));
+				edges++;
+			}
+			else if (ahead >= CACHE_SKIP_EDGES)
+			{
+				return false;
+			}
+		}
+		hash = Fnv1a(&edges, sizeof(edges), hash);
+	}
+	return true;
+}
+
+void SpiFlashAnalyzer::StartCacheTransaction()
+{
+	U64 hash;
+	U64 end;
+
+	// Waits for end of next transaction like decoding does, cache ends where edges can't be hashed
+	if (mCommandEnd == mCacheState.mResumeSample && GetCacheEdgeHash(mCommandEnd, true, hash, end))
+		mCache.StartTransaction(hash, mCacheState);
+	else
+		mCache.Finish(mCacheState);
+}
+
+void SpiFlashAnalyzer::LoadFromCache()
+{
+	DecodeCacheState state;
+	DecodeCacheState before;
+	U64 cached;
+	U64 hash;
+	U64 end;
+	Frame f;
+	U64 frames = 0;
+	bool replayed = false;
+
+	if (!mCache.Lookup(state))
+		return;
+
+	// Replay frames exactly as they were decoded, as long as each transaction has
+	// the same edges in this capture, capture that ends earlier is not waited for
+	while (mCache.ReadTransaction(cached, before))
+	{
+		if (!GetCacheEdgeHash(mCommandEnd, false, hash, end) || hash != cached)
+		{
+			state = before;
+			break;
+		}
+
+		while (mCache.ReadFrame(f))
+		{
+			mResults->AddDecodedFrame(f);
+
+			if (f.mType == FT_CMD)
+			{
+				mResults->EndTransaction();
+				if ((++frames & 0xFFF) == 0)
+				{
+					mResults->CommitResults();
+					ReportProgress(f.mEndingSampleInclusive);
+					CheckIfThreadShouldExit();
+				}
+			}
+		}
+
+		// Transaction edges are in data captured so far
+		mCommandEnd = end;
+		mChipSelect->AdvanceToAbsPosition(mCommandEnd);
+		mClock->AdvanceToAbsPosition(mCommandEnd);
+		CacheDropOlderClocks(mCommandEnd + 1);
+		AdvanceDataToAbsPosition(mCommandEnd);
+		replayed = true;
+	}
+	mResults->CommitResults();
+	mCache.Finish(state);
+	if (!replayed)
+		return;
+
+	// Continue decoding where cached data ended
+	mLockedCmd = spiFlash.GetCommandByRef(state.mLockedCmdRef);
+	mDefaultBusMode = BusMode(state.mDefaultBusMode);
+	mCurrentBusMode = mDefaultBusMode;
+	mClockIdleState = BitState(state.mClockIdleState);
+	mAddressLength = state.mAddressLength;
+	mExtendedAddress = state.mExtendedAddress;
+	if (spiFlash.GetCommandSet(state.mCmdSetId))
+		mCmdSet = spiFlash.GetCommandSet(state.mCmdSetId);
+	mCmdSetConfirmed = state.mCmdSetConfirmed != 0;
+	mSeenSinceId.clear();
+	UpdateCacheState();
+	ReportProgress(mCommandEnd);
+}
+
+void SpiFlashAnalyzer::ApplyCmdSetPlan()
+{
+	while (mCmdSetPlanPos < mCmdSetPlan.size() && (mCmdSetPlan[mCmdSetPlanPos] >> 16) <= mCommandStart)
+	{
+		U64 sw = mCmdSetPlan[mCmdSetPlanPos++];
+		U32 device = U8(sw >> 8) % MAX_DEVICES;
+		// Active device has its state in decoder members
+		CmdSet *&deviceCmdSet = device == mDevice ? mCmdSet : mDevices[device].mCmdSet;
+		bool &confirmed = device == mDevice ? mCmdSetConfirmed : mDevices[device].mCmdSetConfirmed;
+		CmdSet *cmdSet = spiFlash.GetCommandSet(U8(sw));
+		if (cmdSet)
+			deviceCmdSet = cmdSet;
+		confirmed = true;
+		mCmdSetSwitches.push_back(sw);
+		ForgetSeenCommands(device);
+	}
+}
+
+void SpiFlashAnalyzer::ForgetSeenCommands(U32 device)
+{
+	mSeenSinceId.erase(mSeenSinceId.lower_bound(device << 16), mSeenSinceId.lower_bound((device + 1) << 16));
+}
+
+void SpiFlashAnalyzer::FollowJedecId(U8 manufacturer, bool newDevice)
+{
+	CmdSet *cmdSet = spiFlash.GetCommandSetByJedecId(manufacturer);
+
+	// No answer or unknown manufacturer, next JEDEC ID read decides
+	if (cmdSet == nullptr)
+		return;
+
+	// Another device, address mode starts from settings
+	if (newDevice)
+	{
+		mAddressLength = mSettings->mAddressLength;
+		mExtendedAddress = 0;
+	}
+
+	if (cmdSet != mCmdSet)
+	{
+		// Earliest ambiguous transaction since previous JEDEC ID that new command set decodes
+		// differently, command set is switched there when decoding runs again. Ambiguous is
+		// everything decoded with command set from settings and unknown commands after that.
+		U64 first = U64(~0);
+		std::map<U32, SeenCommand>::const_iterator i;
+		for (i = mSeenSinceId.lower_bound(mDevice << 16); i != mSeenSinceId.lower_bound((mDevice + 1) << 16); ++i)
+		{
+			const SpiCmdData *cmd = cmdSet->GetCommand(BusMode(U8(i->first >> 8)), U8(i->first));
+			U32 ref = cmd ? cmd->GetRef() : CMD_REF_UNKNOWN | U8(i->first);
+			if (ref != i->second.mRef && (!mCmdSetConfirmed || IsUnknownCmdRef(i->second.mRef)) &&
+				i->second.mStart < first)
+				first = i->second.mStart;
+		}
+		if (first != U64(~0))
+		{
+			mCmdSetSwitches.push_back(first << 16 | mDevice << 8 | manufacturer);
+			mReinterpret = true;
+		}
+		mCmdSet = cmdSet;
+	}
+	mCmdSetConfirmed = true;
+	ForgetSeenCommands(mDevice);
+}
+
+void SpiFlashAnalyzer::SelectDevice(U32 device)
+{
+	if (device == mDevice)
+		return;
+
+	DeviceState &from = mDevices[mDevice];
+	from.mDefaultBusMode = mDefaultBusMode;
+	from.mLockedCmd = mLockedCmd;
+	from.mAddressLength = mAddressLength;
+	from.mExtendedAddress = mExtendedAddress;
+	from.mCmdSet = mCmdSet;
+	from.mCmdSetConfirmed = mCmdSetConfirmed;
+
+	const DeviceState &to = mDevices[device];
+	mDefaultBusMode = to.mDefaultBusMode;
+	mCurrentBusMode = mDefaultBusMode;
+	mLockedCmd = to.mLockedCmd;
+	mAddressLength = to.mAddressLength;
+	mExtendedAddress = to.mExtendedAddress;
+	mCmdSet = to.mCmdSet;
+	mCmdSetConfirmed = to.mCmdSetConfirmed;
+	mChipSelect = to.mChipSelect;
+	mDevice = device;
+}
+
+bool SpiFlashAnalyzer::NextDevice(U32 &device)
+{
+	U64 first = U64(~0);
+	U64 limit = mCommandEnd;
+
+	// Previous transaction was cut by end of data, it ends when its CS goes inactive
+	if (limit == U64(~0))
+	{
+		if (!mChipSelect->DoMoreTransitionsExistInCurrentData())
+			return false;
+		limit = mChipSelect->GetSampleOfNextEdge();
+	}
+
+	// Device whose CS goes active first, CS active at start of data or during
+	// transaction of other device (bus conflict) is skipped
+	for (U32 i = 0; i < MAX_DEVICES; ++i)
+	{
+		ChannelReader *cs = mDevices[i].mChipSelect;
+		if (cs == nullptr)
+			continue;
+		while (cs->DoMoreTransitionsExistInCurrentData() &&
+			(cs->GetBitState() == BIT_LOW || cs->GetSampleOfNextEdge() < limit))
+			cs->AdvanceToNextEdge();
+		if (cs->DoMoreTransitionsExistInCurrentData() && cs->GetSampleOfNextEdge() < first)
+		{
+			first = cs->GetSampleOfNextEdge();
+			device = i;
+		}
+	}
+	return first != U64(~0);
+}
+
+bool SpiFlashAnalyzer::MoreEdgesInCurrentData()
+{
+	if (mChipSelect == nullptr)
+		return mClock->DoMoreTransitionsExistInCurrentData();
+	for (U32 i = 0; i < MAX_DEVICES; ++i)
+		if (mDevices[i].mChipSelect && mDevices[i].mChipSelect->DoMoreTransitionsExistInCurrentData())
+			return true;
+	return false;
 }
 
 void SpiFlashAnalyzer::AdvanceDataToAbsPosition(U64 AbsolutePosition)
 {
-	if (pos > AbsolutePosition)
+	// Data lines don't go back in time
+	if (mDataPosition > AbsolutePosition)
 	{
 		return;
 	}
-	pos = AbsolutePosition;
-	if (mMosi) mMosi->AdvanceToAbsPosition(AbsolutePosition);
-	if (mMiso) mMiso->AdvanceToAbsPosition(AbsolutePosition);
-	if (mD2) mD2->AdvanceToAbsPosition(AbsolutePosition);
-	if (mD3) mD3->AdvanceToAbsPosition(AbsolutePosition);
+	mDataPosition = AbsolutePosition;
+	for (int i = 0; i < 8; ++i)
+		if (mLines[i])
+			mLines[i]->AdvanceToAbsPosition(AbsolutePosition);
+}
+
+void SpiFlashAnalyzer::SampleDataAt(U64 edge, U32 lines, U32 mode)
+{
+	TimingMargins &timing = mResults->GetTimingMargins();
+	U32 measured = lines | mHoldPending;
+
+	// Transitions passed on the way to sampling edge give margins, the first one ends
+	// hold of previous sampling of that line and the last one starts setup
+	for (U32 i = 0; measured && mDataPosition <= edge; ++i, measured >>= 1)
+	{
+		ChannelReader *line = mLines[i];
+		if (!(measured & 1) || line == nullptr)
+			continue;
+		bool sampled = (lines >> i) & 1;
+		U64 transition = 0;
+		while (line->WouldAdvancingToAbsPositionCauseTransition(edge))
+		{
+			line->AdvanceToNextEdge();
+			transition = line->GetSampleNumber();
+			if (mHoldPending & (1 << i))
+			{
+				timing.AddMargin(MK_HOLD, mHoldMode[i], i, transition - mHoldEdge[i]);
+				mHoldPending &= ~(1 << i);
+			}
+			if (!sampled)
+				break;
+		}
+		if (!sampled)
+			continue;
+		if (transition)
+			timing.AddMargin(MK_SETUP, mode, i, edge - transition);
+		mHoldPending |= 1 << i;
+		mHoldEdge[i] = edge;
+		mHoldMode[i] = U8(mode);
+	}
+	AdvanceDataToAbsPosition(edge);
 }
 
 void SpiFlashAnalyzer::CacheDropOlderClocks(U64 limit)
@@ -154,12 +662,18 @@ void SpiFlashAnalyzer::CacheClock(int num, U64 lowerLimit)
 	if (lowerLimit)
 		CacheDropOlderClocks(lowerLimit);
 
+	if (num > CLOCK_CACHE_SIZE)
+		num = CLOCK_CACHE_SIZE;
+
 	// No cached clocks, move clock forward
 	if (mClock->GetSampleNumber() < lowerLimit)
 		mClock->AdvanceToAbsPosition(lowerLimit);
 
 	while (mCachedClockCount < num && mClock->DoMoreTransitionsExistInCurrentData())
 	{
+		// Without CS next transaction may follow, its edges are found by clock recovery
+		if (mChipSelect == NULL && mCommandEnd != U64(~0) && mClock->GetSampleOfNextEdge() > mCommandEnd)
+			break;
 		mClock->AdvanceToNextEdge();
 		if (mClock->GetBitState() == BIT_HIGH)
 			mCachedClocks[mCachedClockCount++] = (mClock->GetSampleNumber() << 1) + 1;
@@ -173,6 +687,19 @@ void SpiFlashAnalyzer::AdvanceToCommandStart()
 	// If CS is present just move to next falling edge
 	if (mChipSelect != NULL)
 	{
+		// Transaction of device whose CS goes active first, lines are shared
+		if (mDeviceCount > 1)
+		{
+			U32 device = 0;
+			while (!NextDevice(device))
+			{
+				// Nothing more in data captured so far
+				CheckIfThreadShouldExit();
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			SelectDevice(device);
+		}
+
 		if (mChipSelect->GetBitState() == BIT_HIGH)
 		{
 			mChipSelect->AdvanceToNextEdge();
@@ -192,7 +719,8 @@ void SpiFlashAnalyzer::AdvanceToCommandStart()
 			if ((mSettings->mSpiMode == 0 && !clockHigh) ||
 				(mSettings->mSpiMode == 3 && clockHigh))
 			{
-				mResults->AddMarker(mCommandStart, AnalyzerResults::ErrorSquare, mSettings->mClock);
+				if (!mInferring)
+					mResults->AddMarker(mCommandStart, AnalyzerResults::ErrorSquare, mSettings->mClock);
 			}
 			else if (mSettings->mSpiMode == 0xFF)
 				// For auto mode take current clock state as idle state
@@ -210,48 +738,31 @@ void SpiFlashAnalyzer::AdvanceToCommandStart()
 	}
 	else
 	{
-		// TODO: Rethink clocks !!!
-		// Hardware generated clock should have some pattern
-		U64 edges[10];
-
-		if (mSettings->mSpiMode == 0 && mClock->GetBitState() == BIT_HIGH)
-			mClock->AdvanceToNextEdge();
-		else if (mSettings->mSpiMode == 3 && mClock->GetBitState() == BIT_LOW)
-			mClock->AdvanceToNextEdge();
-		else
-			mClockIdleState = BIT_LOW;
-
-		U64 sample = mClock->GetSampleNumber();
-		// Assume that clock is in idle now
-		mClock->AdvanceToNextEdge();
-		edges[0] = mClock->GetSampleNumber(); // rising edge
-		mClock->AdvanceToNextEdge();
-		edges[1] = mClock->GetSampleNumber(); // falling edge
-		while (true)
-		{
-			mClock->AdvanceToNextEdge();
-			edges[2] = mClock->GetSampleNumber(); // rising edge
-			mClock->AdvanceToNextEdge();
-			edges[3] = mClock->GetSampleNumber(); // falling edge
-			int d1 = int(edges[1] - edges[0]);
-			int d2 = int(edges[2] - edges[1]);
-			int d3 = int(edges[3] - edges[2]);
-			if (d3 == 0)
-				return;
-			// If positive pulses differe more then 10 % and 2 samples
-			// or negative puls differes from positive more than 30 % and 2 samples
-			// lets move to place where clock is more stable
-			if ((abs(d1 - d3) > 2 && (abs(d1 - d2) > d1 / 10)) ||
-				(abs(d2 - d1) > 2 && (abs(d1 - d2) > d1 / 30)))
-			{
-				edges[0] = edges[2];
-				edges[1] = edges[3];
-				continue;
-			}
-			mClock->AdvanceToAbsPosition(edges[0]);
-			mCommandStart = mClock->GetSampleNumber();
-			break;
-		}
+		// Without CS transaction is clocking between pauses of clock
+		U64 first;
+		U64 last;
+		bool cut = mCommandEnd == U64(~0);
+
+		// Edges of previous transaction that were not decoded don't start next one
+		if (!cut && mClock->GetSampleNumber() < mCommandEnd)
+			mClock->AdvanceToAbsPosition(mCommandEnd);
+		bool complete = mClockRecovery.Next(*mClock, cut, first, last);
+
+		// Frame covers half period around clocking
+		U64 margin = mClockRecovery.GetHalfPeriod();
+		if (margin == 0)
+			margin = 1;
+		mCommandStart = first > margin ? first - margin : 0;
+		if (!cut && mCommandStart <= mCommandEnd)
+			mCommandStart = mCommandEnd + 1;
+		mCommandEnd = complete ? last + margin : ~0;
+
+		// Clock stays in idle state during pause
+		bool clockHigh = mClock->GetBitState() == BIT_HIGH;
+		if ((mSettings->mSpiMode == 0 && clockHigh) || (mSettings->mSpiMode == 3 && !clockHigh))
+			mResults->AddMarker(first, AnalyzerResults::ErrorSquare, mSettings->mClock);
+		else if (mSettings->mSpiMode == 0xFF)
+			mClockIdleState = clockHigh ? BIT_HIGH : BIT_LOW;
 	}
 	AdvanceDataToAbsPosition(mCommandStart);
 }
@@ -262,48 +773,37 @@ U8 SpiFlashAnalyzer::GetBits(BusMode busMode, bool dirIn)
 
 	if (busMode == SINGLE)
 	{
-		if (dirIn)
-		{
-			if (mMiso)
-				b = mMiso->GetBitState() == BIT_HIGH ? 1 : 0;
-		}
-		else
-		{
-			if (mMosi)
-				b = mMosi->GetBitState() == BIT_HIGH ? 1 : 0;
-		}
-	}
-	else
-	{
-		if (mMosi)
-			b = mMosi->GetBitState() == BIT_HIGH ? 1 : 0;
-		if (mMiso)
-			b |= mMiso->GetBitState() == BIT_HIGH ? 2 : 0;
-	}
-	if (busMode == QUAD)
-	{
-		if (mD2)
-			b |= mD2->GetBitState() == BIT_HIGH ? 4 : 0;
-		if (mD3)
-			b |= mD3->GetBitState() == BIT_HIGH ? 8 : 0;
+		ChannelReader *line = dirIn ? mMiso : mMosi;
+		return (line && line->GetBitState() == BIT_HIGH) ? 1 : 0;
 	}
+	// Whole sample at once, octal gives byte per edge
+	for (int i = 0; i < busMode; ++i)
+		if (mLines[i] && mLines[i]->GetBitState() == BIT_HIGH)
+			b |= U8(1 << i);
 
 	return b;
 }
 
-int SpiFlashAnalyzer::ExtractBits(U64 &start, U64 &end, U32 &val, U8 neededBits)
+int SpiFlashAnalyzer::ExtractBits(U64 &start, U64 &end, U32 &val, U32 neededBits, bool dtr)
 {
 	BusMode busMode = mCurrentBusMode;
-	U8 bitCount = 0;
+	U32 bitCount = 0;
 	val = 0;
 	int i;
-	int clockEdgesPerByte = 2 * neededBits / busMode;
+	int samples = int(neededBits / busMode);
+	// SDR samples on rising edges only, DTR on every edge
+	int step = dtr ? 1 : 2;
+	int clockEdgesPerByte = dtr ? samples : 2 * samples;
 
 	CacheClock(clockEdgesPerByte, mCommandStart);
 
 	// Start time of first clock edge (rising or falling)
 	start = mCachedClocks[0] >> 1;
 
+	// Let i point to rising edge time in table, DTR continues with next edge
+	// (previous DTR phase may have ended on rising edge)
+	i = (dtr || (mCachedClocks[0] & 1)) ? 0 : 1;
+
 	// Not enough clocks to form a byte, and those clocks are in active CS?
 	if (mCachedClockCount < clockEdgesPerByte || (mCachedClocks[clockEdgesPerByte - 1] >> 1) > mCommandEnd)
 	{
@@ -316,17 +816,22 @@ int SpiFlashAnalyzer::ExtractBits(U64 &start, U64 &end, U32 &val, U8 neededBits)
 		return -1;
 	}
 
-	// Let i point to rising edge time in table
-	i = (mCachedClocks[0] & 1) ? 0 : 1;
+	// Lines sampled by this phase get setup/hold margins
+	U32 lines = 0;
+	if (!mInferring)
+		lines = busMode == SINGLE ? (mDirIn ? 2 : 1) : (1 << busMode) - 1;
+	U32 mode = TimingMargins::ModeIndex(busMode, dtr);
 
 	while (bitCount < neededBits)
 	{
-		AdvanceDataToAbsPosition(mCachedClocks[i] >> 1);
-		mResults->AddMarker(mCachedClocks[i] >> 1, AnalyzerResults::UpArrow, mSettings->mClock);
+		SampleDataAt(mCachedClocks[i] >> 1, lines, mode);
+		if (!mInferring)
+			mResults->AddMarker(mCachedClocks[i] >> 1, (mCachedClocks[i] & 1) ? AnalyzerResults::UpArrow :
+				AnalyzerResults::DownArrow, mSettings->mClock);
 		val <<= busMode;
 		val |= GetBits(busMode, mDirIn);
 		bitCount += busMode;
-		i += 2;
+		i += step;
 	}
 	end = mCachedClocks[clockEdgesPerByte - 1] >> 1;
 	CacheDropOlderClocks(end + 1);
@@ -362,9 +867,10 @@ int SpiFlashAnalyzer::ExtractMosiMiso(U64 &start, U64 &end, U8 &mosi, U8 &miso)
 		// Let i point to rising edge time in table
 		i = (mCachedClocks[0] & 1) ? 0 : 1;
 
+		U32 lines = mInferring ? 0 : 3;
 		for (bitCount = 0; bitCount < 8; ++bitCount, i += 2)
 		{
-			AdvanceDataToAbsPosition(mCachedClocks[i] >> 1);
+			SampleDataAt(mCachedClocks[i] >> 1, lines, TimingMargins::ModeIndex(SINGLE, false));
 			if (mMosi)
 				mosi = (mosi << 1) + (mMosi->GetBitState() == BIT_HIGH ? 1 : 0);
 			if (mMiso)
@@ -377,15 +883,18 @@ int SpiFlashAnalyzer::ExtractMosiMiso(U64 &start, U64 &end, U8 &mosi, U8 &miso)
 	return ret;
 }
 
+static inline U64 RegisterRef(const RegisterData *reg)
+{
+	return reg ? reg->GetRef() : CMD_REF_NONE;
+}
+
 void SpiFlashAnalyzer::AnalyzeCommandBits()
 {
 	int b;
 
-	union
-	{
-		SpiCmdData *data;
-		intptr_t code;
-	} cmd;
+	SpiCmdData *cmd = nullptr;
+	// Stable reference stored in frames
+	U32 cmdRef = CMD_REF_NONE;
 	U64 cmdExtra;
 
 	U32 val;
@@ -396,85 +905,141 @@ void SpiFlashAnalyzer::AnalyzeCommandBits()
 	U64 end;
 
 	U8 m;
-
-	cmd.data = nullptr;
-	mResults->CommitPacketAndStartNewPacket();
+	// First data byte, register value or manufacturer ID
+	U32 firstByte = 0;
+	// All phases before data decoded
+	bool dataPhase = false;
+
+	// Bus mode used for command, stored in command frame flags
+	U8 cmdBusMode = U8(mCurrentBusMode);
+	if (mDtrProtocol)
+		cmdBusMode |= CMD_FLAG_DTR;
+	if (mAddressLength == 32)
+		cmdBusMode |= CMD_FLAG_ADDR4;
 
 	mDirIn = false;
+	// Margins are kept within transaction
+	mHoldPending = 0;
+	mResults->GetTimingMargins().StartTransaction();
+
+	ApplyCmdSetPlan();
 
 	do
 	{
 		cmdExtra = 0;
 		if (mLockedCmd != nullptr)
-			cmd.data = mLockedCmd;
+		{
+			cmd = mLockedCmd;
+			cmdRef = cmd->GetRef();
+		}
 		else
 		{
-			b = ExtractBits(start, end, val, 8);
+			// Octal commands can have second opcode byte
+			OpcodeExtension ext = mCurrentBusMode == OCTAL ? mCmdSet->GetOpcodeExtension() : OPCODE_EXT_NONE;
+			U8 cmdBits = (ext == OPCODE_EXT_INVERT || (ext == OPCODE_EXT_REPEAT && mDtrProtocol)) ? 16 : 8;
+			b = ExtractBits(start, end, val, cmdBits, mDtrProtocol);
 			if (b < 0)
 			{
-				// Not enough bits for decoding command set value that is more then byte
-				// but not enough for valid pointer
-				cmd.code = 0x100;
+				// Not enough bits for decoding command
 				break;
 			}
 
-			cmd.data = spiFlash.GetCommand(mCurrentBusMode, U8(val));
-			if (cmd.data == nullptr)
-				cmd.code = (int)val;
+			U8 code = U8(val >> (cmdBits - 8));
+			cmd = mCmdSet->GetCommand(mCurrentBusMode, code);
+			// Extension not matching opcode, not a command
+			if (cmdBits == 16 && U8(val) != (ext == OPCODE_EXT_INVERT ? U8(~code) : code))
+				cmd = nullptr;
+			cmdRef = cmd ? cmd->GetRef() : CMD_REF_UNKNOWN | code;
 
 			// Add command to MOSI line
-			AddFrame(start, end, val, reinterpret_cast<U64>(cmd.data), FT_CMD_BYTE, 0);
+			AddFrame(start, end, val, DeviceRef(cmdRef, mDevice), FT_CMD_BYTE, 0);
 		}
 
-		if (cmd.code > 0x100)
+		if (cmd)
 		{
-			UpdateBusMode((BusMode)cmd.data->mModeArgs);
-			if (cmd.data->mAddressBits)
+			// Phases after command byte
+			bool dtr = cmd->mDtr || mDtrProtocol;
+
+			UpdateBusMode((BusMode)cmd->mModeArgs);
+			if (cmd->mAddressBits)
 			{
-				U32 addressLength = (cmd.data->mAddressBits != 0xFF) ? cmd.data->mAddressBits  : mSettings->mAddressLength;
+				U32 addressLength = (cmd->mAddressBits != 0xFF) ? cmd->mAddressBits : mAddressLength;
 				addr = 0;
-				if (ExtractBits(start, end, addr, addressLength) < 0)
+				if (ExtractBits(start, end, addr, addressLength, dtr) < 0)
 					break;
-				AddFrame(start, end, addr, 0, FT_OUT_ADDR24, 0);
-				cmdExtra = U64(addr) << 24;
+				// Upper address bits of 3-byte address come from extended address register
+				if (addressLength == 24 && cmd->IsArrayAccess())
+					addr |= U32(mExtendedAddress) << 24;
+				AddFrame(start, end, addr, 0, addressLength == 32 ? FT_OUT_ADDR32 : FT_OUT_ADDR24, 0);
+				cmdExtra = U64(addr) << 32;
 			}
-			if (cmd.data->mContinuousRead)
+			if (cmd->mContinuousRead)
 			{
-				if (ExtractBits(start, end, val, 8) < 0)
+				if (ExtractBits(start, end, val, 8, dtr) < 0)
 					break;
 				m = U8(val);
-				mLockedCmd = ((m & 0x30) == 0x20) ? cmd.data : nullptr;
+				mLockedCmd = ((m & 0x30) == 0x20) ? cmd : nullptr;
 				AddFrame(start, end, val, 0, FT_M, 0);
 			}
 
 			U64 dummyStart = 0;
 			U64 dummyEnd = 0;
-
-			if (cmd.data->mDummyBytes)
+			U32 dummyCycles = cmd->mDummyBytes ? cmd->mDummyCount * 8 / mCurrentBusMode :
+				cmd->mDummyCycles ? cmd->mDummyCount : 0;
+
+			// Dummy clocks configured by register written earlier, M bits count in
+			int waitCycles = mResults->GetRegisters(mDevice).WaitCycles(cmd, cmdBusMode & 0x0F);
+			// Power up values from SFDP read by host
+			if (waitCycles < 0)
+				waitCycles = mResults->GetSfdp(mDevice).WaitCycles(cmd, cmdBusMode & 0x0F);
+			if (waitCycles >= 0)
 			{
-				if (ExtractBits(dummyStart, dummyEnd, val, cmd.data->mDummyCount * 8) < 0)
-					break;
+				int modeCycles = cmd->mContinuousRead ? 8 / mCurrentBusMode / (dtr ? 2 : 1) : 0;
+				dummyCycles = waitCycles > modeCycles ? U32(waitCycles - modeCycles) : 0;
 			}
-			else if (cmd.data->mDummyCycles)
+
+			// Dummy cycles are whole clock periods, in DTR two edges each
+			// counted from where previous phase ended. Long waits (SFDP allows
+			// up to 38) are taken in parts that fit in clock cache.
+			for (U32 left = dummyCycles; left > 0; )
 			{
-				if (ExtractBits(dummyStart, dummyEnd, val, cmd.data->mDummyCycles) < 0)
+				U32 cycles = left > MAX_DUMMY_CHUNK ? MAX_DUMMY_CHUNK : left;
+				U32 dummyBits = cycles * mCurrentBusMode * (dtr ? 2 : 1);
+				U64 chunkStart;
+				U32 chunkVal;
+
+				if (ExtractBits(chunkStart, dummyEnd, chunkVal, dummyBits, dtr) < 0)
+				{
+					dummyEnd = 0;
 					break;
+				}
+				if (left == dummyCycles)
+				{
+					dummyStart = chunkStart;
+					val = 0;
+				}
+				// Value keeps last bits, as if sampled at once
+				val = dummyBits >= 32 ? chunkVal : (val << dummyBits) | chunkVal;
+				left -= cycles;
 			}
+			if (dummyCycles && dummyEnd == 0)
+				break;
 
 			// Dummy cycles or byte found
 			if (dummyEnd)
 			{
-				AddFrame(dummyStart, dummyEnd, val, 0, FT_DUMMY, 0);
+				AddFrame(dummyStart, dummyEnd, val, dummyCycles, FT_DUMMY, 0);
 				end = dummyEnd;
 			}
 
 			// Change bus mode if command require change for data phase
-			UpdateBusMode(BusMode(cmd.data->mModeData));
+			UpdateBusMode(BusMode(cmd->mModeData));
+			dataPhase = true;
 
-			switch (cmd.data->mCmdOp)
+			switch (cmd->mCmdOp)
 			{
 			case OP_DATA_WRITE:
-				while (ExtractBits(start, end, val, 8) >= 0)
+				while (ExtractBits(start, end, val, 8, dtr) >= 0)
 				{
 					AddFrame(start, end, val, 0, FT_OUT_BYTE, 0);
 					cmdExtra++;
@@ -482,35 +1047,60 @@ void SpiFlashAnalyzer::AnalyzeCommandBits()
 				break;
 			case OP_DATA_READ:
 				mDirIn = true;
-				while (ExtractBits(start, end, val, 8) >= 0)
+				while (ExtractBits(start, end, val, 8, dtr) >= 0)
 				{
 					AddFrame(start, end, 0, val, FT_IN_BYTE, 0);
+					if (U32(cmdExtra) == 0)
+						firstByte = val;
 					cmdExtra++;
 				}
 				break;
 			case OP_REG_WRITE:
-				while (ExtractBits(start, end, val, 8) >= 0)
+				while (ExtractBits(start, end, val, 8, dtr) >= 0)
 				{
-					AddFrame(start, end, val,
-						reinterpret_cast<U64>(cmd.data->GetRegister(size_t(cmdExtra))), FT_OUT_REG, 0);
+					AddFrame(start, end, val, RegisterRef(cmd->GetRegister(size_t(cmdExtra))), FT_OUT_REG, 0);
+					if (U32(cmdExtra) == 0)
+						firstByte = val;
 					cmdExtra++;
 				}
 				break;
 			case OP_REG_READ:
 				mDirIn = true;
-				while (ExtractBits(start, end, val, 8) >= 0)
+				while (ExtractBits(start, end, val, 8, dtr) >= 0)
 				{
-					AddFrame(start, end, reinterpret_cast<U64>(cmd.data->GetRegister(size_t(cmdExtra))),
-						val, FT_IN_REG, 0);
+					AddFrame(start, end, RegisterRef(cmd->GetRegister(size_t(cmdExtra))), val, FT_IN_REG, 0);
 					cmdExtra++;
 				}
 				break;
 			}
 			// Commands like Enter QPI or Exit QPI change bus mode
-			if (cmd.data->mModeChange)
-				mDefaultBusMode = BusMode(cmd.data->mModeChange);
+			if (cmd->mModeChange)
+				mDefaultBusMode = BusMode(cmd->mModeChange);
+			// Address length and upper address bits for following commands
+			switch (cmd->mRole)
+			{
+			case ROLE_ENTER_4BYTE:
+				mAddressLength = 32;
+				break;
+			case ROLE_EXIT_4BYTE:
+				mAddressLength = 24;
+				break;
+			case ROLE_WRITE_EXTENDED_ADDRESS:
+				if (cmdExtra)
+					mExtendedAddress = U8(firstByte);
+				break;
+			case ROLE_WRITE_BANK_REGISTER:
+				if (cmdExtra)
+				{
+					mAddressLength = (firstByte & 0x80) ? 32 : 24;
+					mExtendedAddress = U8(firstByte & 0x7F);
+				}
+				break;
+			default:
+				break;
+			}
 		}
-		else if (cmd.code < 0x100)
+		else
 		{
 			U8 miso, mosi;
 			while (ExtractMosiMiso(start, end, mosi, miso) >= 0)
@@ -518,32 +1108,99 @@ void SpiFlashAnalyzer::AnalyzeCommandBits()
 		}
 	} while (0);
 
-	if (cmd.code != 0x100)
+	// Start state hypothesis scored by how well transaction fits command
+	if (mInferring)
 	{
-		AddFrame(mCommandStart, mCommandEnd, cmdExtra, reinterpret_cast<U64>(cmd.data), FT_CMD, 0);
-		ReportProgress(mCommandEnd);
+		if (cmd == nullptr && cmdRef != CMD_REF_NONE)
+			mInferScore -= 4;
+		else if (cmd)
+		{
+			mInferScore += 2;
+			if (!dataPhase)
+				mInferScore -= 3;
+			else if (ClockEdgesLeft())
+				mInferScore -= 2;
+			if (cmd->IsArrayAccess() && (cmdExtra >> 32) >= mSettings->mCapacity)
+				mInferScore -= 1;
+		}
+		mCurrentBusMode = mDefaultBusMode;
+		return;
 	}
 
+	// Quad command while QE bit is known to be cleared
+	if (cmd && mResults->GetRegisters(mDevice).QuadDisabled() &&
+		((cmdBusMode & 0x0F) == QUAD || cmd->mModeArgs == QUAD || cmd->mModeData == QUAD))
+		cmdBusMode |= DISPLAY_AS_WARNING_FLAG;
+
+	if (cmdRef != CMD_REF_NONE)
+	{
+		U8 deviceId = mResults->GetDeviceId(mDevice);
+		AddFrame(mCommandStart, mCommandEnd, cmdExtra, DeviceRef(cmdRef, mDevice), FT_CMD, cmdBusMode);
+		mResults->EndTransaction();
+		ReportProgress(mCommandEnd);
+
+		// SFDP tells that device uses only one address length
+		if (cmd && cmd->mRole == ROLE_READ_SFDP && mResults->GetSfdp(mDevice).FixedAddressLength())
+			mAddressLength = mResults->GetSfdp(mDevice).FixedAddressLength();
+
+		if (mSettings->mFollowJedecId && cmd && cmd->IsJedecIdRead())
+		{
+			if (U32(cmdExtra))
+				FollowJedecId(U8(firstByte), mResults->GetDeviceId(mDevice) != deviceId);
+		}
+		else if (mSettings->mFollowJedecId)
+		{
+			U8 code = cmd ? cmd->GetCode() : U8(cmdRef);
+			SeenCommand seen = { mCommandStart, cmdRef };
+			mSeenSinceId.insert(std::make_pair(mDevice << 16 | U32(cmdBusMode & 0x0F) << 8 | code, seen));
+		}
+	}
 
 	// Set default bus mode
 	mCurrentBusMode = mDefaultBusMode;
+
+	// Transaction cut by end of data is not cached, it will be decoded again
+	if (mCommandEnd != U64(~0))
+	{
+		mCache.CommitTransaction();
+		UpdateCacheState();
+	}
 }
 
 void SpiFlashAnalyzer::WorkerThread()
 {
 	Setup();
+	// Start state is not known, it is inferred from first transactions
+	if (mSettings->mBusMode == 0 && mChipSelect && mDeviceCount == 1)
+		InferStartState();
 
 	for (;;)
 	{
+		// All data decoded so far, show held back frames
+		if (!MoreEdgesInCurrentData())
+			mResults->Flush();
+		if (mCache.IsWriting())
+			StartCacheTransaction();
 		AdvanceToCommandStart();
 		AnalyzeCommandBits();
+		if (mCache.IsProbing() && mCache.GetTransactionCount() >= DecodeCache::PROBE_TRANSACTIONS)
+			LoadFromCache();
 		CheckIfThreadShouldExit();
 	}
 }
 
 bool SpiFlashAnalyzer::NeedsRerun()
 {
-	return false;
+	// Decode again with command set switched before transactions that JEDEC ID showed were
+	// decoded with wrong command set, stop when switches do not move any more
+	// Switches of different devices are found out of order
+	std::vector<U64> switches = mCmdSetSwitches;
+	std::sort(switches.begin(), switches.end());
+	if (!mReinterpret || switches == mCmdSetPlan || mReruns >= MAX_RERUNS)
+		return false;
+	mCmdSetPlan = switches;
+	mReruns++;
+	return true;
 }
 
 U32 SpiFlashAnalyzer::GenerateSimulationData(U64 minimum_sample_index, U32 device_sample_rate, SimulationChannelDescriptor** simulation_channels)
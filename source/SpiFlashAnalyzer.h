@@ -24,9 +24,13 @@ SOFTWARE.
 #ifndef SPIFLASH_ANALYZER_H
 #define SPIFLASH_ANALYZER_H
 
+#include <map>
 #include <Analyzer.h>
 #include "SpiFlashAnalyzerResults.h"
 #include "SpiFlashSimulationDataGenerator.h"
+#include "SpiFlashDecodeCache.h"
+#include "SpiFlashChannelReader.h"
+#include "SpiFlashClockRecovery.h"
 
 #include "SpiFlash.h"
 
@@ -53,12 +57,20 @@ protected: //vars
 	SpiFlashSimulationDataGenerator mSimulationDataGenerator;
 	bool mSimulationInitilized;
 
-	AnalyzerChannelData *mChipSelect;
-	AnalyzerChannelData *mClock;
-	AnalyzerChannelData *mMosi;
-	AnalyzerChannelData *mMiso;
-	AnalyzerChannelData *mD2;
-	AnalyzerChannelData *mD3;
+	// CS, clock, D0 .. D7, CS 2 .. CS 4, nullptr entries below for channels that are not set
+	ChannelReader mReaders[10 + MAX_DEVICES - 1];
+	ChannelReader *mChipSelect;
+	ChannelReader *mClock;
+	ChannelReader *mMosi;
+	ChannelReader *mMiso;
+	ChannelReader *mD2;
+	ChannelReader *mD3;
+	ChannelReader *mD4;
+	ChannelReader *mD5;
+	ChannelReader *mD6;
+	ChannelReader *mD7;
+	// D0 (MOSI) .. D7, bit n of multi line sample comes from mLines[n]
+	ChannelReader *mLines[8];
 
 	//Serial analysis vars:
 	U32 mSampleRateHz;
@@ -66,6 +78,12 @@ protected: //vars
 	U32 mEndOfStopBitOffset;
 	BusMode mCurrentBusMode;
 	BusMode mDefaultBusMode;
+	// All phases sampled on both edges (4D-4D-4D)
+	bool mDtrProtocol;
+	// Length of address of commands without fixed length, changed by EN4B/EX4B
+	U32 mAddressLength;
+	// A31-A24 of 3-byte addresses from extended/bank address register
+	U8 mExtendedAddress;
 	bool mDirIn;
 
 	// Starting sample, CS activated
@@ -73,26 +91,108 @@ protected: //vars
 	// Ending sample, CS deactivated
 	U64 mCommandEnd;
 	BitState mClockIdleState;
+	// Transaction boundaries when there is no CS
+	ClockRecovery mClockRecovery;
 	// Continues read mode active after CS is activated
 	SpiCmdData *mLockedCmd;
+	DecodeCache mCache;
+	// Decoder state after last complete transaction
+	DecodeCacheState mCacheState;
+	// All edges of transaction are hashed for cache, transaction with more edges on one
+	// channel is not cached, edges before transaction that can be skipped
+	enum { CACHE_MAX_EDGES = 0x40000, CACHE_SKIP_EDGES = 4096 };
+
+	// Command set used for decoding, follows Read JEDEC ID
+	CmdSet *mCmdSet;
+	// Command set was given by JEDEC ID, not just by settings
+	bool mCmdSetConfirmed;
+	struct SeenCommand
+	{
+		U64 mStart;
+		U32 mRef;
+	};
+	// Commands decoded since last Read JEDEC ID by device << 16 | bus mode << 8 | opcode, first occurrence
+	std::map<U32, SeenCommand> mSeenSinceId;
+	// Command set switches of this run as sample << 16 | device << 8 | command set id, placed at first
+	// ambiguous transaction before JEDEC ID that new command set decodes differently
+	std::vector<U64> mCmdSetSwitches;
+	// Switches found by previous run, applied when transaction starts
+	std::vector<U64> mCmdSetPlan;
+	size_t mCmdSetPlanPos;
+	std::string mCmdSetPlanKey;
+	// Transactions before JEDEC ID were decoded with other command set
+	bool mReinterpret;
+	U32 mReruns;
+	enum { MAX_RERUNS = 4 };
+
+	// Decoding state of devices sharing clock and data lines, active device is kept in
+	// members above and stored back here when transaction of other device starts
+	struct DeviceState
+	{
+		ChannelReader *mChipSelect;
+		BusMode mDefaultBusMode;
+		SpiCmdData *mLockedCmd;
+		U32 mAddressLength;
+		U8 mExtendedAddress;
+		CmdSet *mCmdSet;
+		bool mCmdSetConfirmed;
+	};
+	DeviceState mDevices[MAX_DEVICES];
+	U32 mDevice;
+	U32 mDeviceCount;
+
+	// Start state is being inferred, transactions are only scored
+	bool mInferring;
+	int mInferScore;
+	enum { INFER_TRANSACTIONS = 32 };
+	struct StartState
+	{
+		BusMode mBusMode;
+		SpiCmdData *mLockedCmd;
+	};
 private:
 	void AddFrame(U64 start, U64 end, U64 d1, U64 d2, U8 type, U8 flags);
 	void Setup();
+	ChannelReader *AttachChannel(ChannelReader &reader, Channel &channel);
+	void ResetDecodeState(BusMode busMode, SpiCmdData *lockedCmd);
+	void InferStartState();
+	U32 ClockEdgesLeft();
+	void SelectDevice(U32 device);
+	bool NextDevice(U32 &device);
+	bool MoreEdgesInCurrentData();
+	void ForgetSeenCommands(U32 device);
 	void AdvanceToCommandStart();
 	void AdvanceDataToAbsPosition(U64 AbsolutePosition);
+	// Data lines to sampling edge, lines in mask get setup/hold margins
+	void SampleDataAt(U64 edge, U32 lines, U32 mode);
 	void SetupResults();
 	void AnalyzeCommandBits();
+	void UpdateCacheState();
+	// Hash of edges of all channels in transaction that follows start
+	bool GetCacheEdgeHash(U64 start, bool wait, U64 &hash, U64 &end);
+	void StartCacheTransaction();
+	void LoadFromCache();
+	void ApplyCmdSetPlan();
+	void FollowJedecId(U8 manufacturer, bool newDevice);
 	void UpdateBusMode(BusMode busMode) { if (busMode) mCurrentBusMode = busMode; }
 	U8 GetBits(BusMode busMode, bool dirIn);
-	int ExtractBits(U64 &start, U64 &end, U32 &val, U8 bitCount);
+	int ExtractBits(U64 &start, U64 &end, U32 &val, U32 bitCount, bool dtr = false);
 	int ExtractMosiMiso(U64 &start, U64 &end, U8 &mosi, U8 &miso);
 
 	void CacheClock(int num, U64 limit = 0);
 	void CacheDropOlderClocks(U64 limit);
 
-	U64 mCachedClocks[64];
+	enum { CLOCK_CACHE_SIZE = 64, MAX_DUMMY_CHUNK = 16 };
+	U64 mCachedClocks[CLOCK_CACHE_SIZE];
 	U8 mCachedClockCount;
 
+	// Lines sampled in this transaction that did not change since, hold is still growing
+	U32 mHoldPending;
+	U64 mHoldEdge[8];
+	U8 mHoldMode[8];
+	// Data lines of this analyzer were advanced to this sample
+	U64 mDataPosition;
+
 };
 
 extern "C" ANALYZER_EXPORT const char* __cdecl GetAnalyzerName();
@@ -28,14 +28,23 @@ SOFTWARE.
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
 
 #include "SpiFlash.h"
+#include "SpiFlashPcapng.h"
+#include <algorithm>
 
 SpiFlashAnalyzerResults::SpiFlashAnalyzerResults(SpiFlashAnalyzer* analyzer, SpiFlashAnalyzerSettings* settings)
 	: AnalyzerResults(),
 	mSettings(settings),
-	mAnalyzer(analyzer)
+	mAnalyzer(analyzer),
+	mFrameCount(0),
+	mHolding(false),
+	mFirstFrame(INVALID_RESULT_INDEX),
+	mLastFrame(0)
 {
+	mPoll.mCount = 0;
+	memset(mDeviceId, 0, sizeof(mDeviceId));
 }
 
 SpiFlashAnalyzerResults::~SpiFlashAnalyzerResults()
@@ -68,6 +77,65 @@ static std::string RegisterString(RegisterData *reg, U64 val, bool full = false)
 	return s.str();
 }
 
+// Device of command when more CS lines share the bus, empty for device on CS
+static std::string DeviceText(U64 ref)
+{
+	char s[16] = "";
+
+	if (RefDevice(ref))
+		snprintf(s, sizeof(s), "CS%u ", RefDevice(ref) + 1);
+	return s;
+}
+
+// Longest command name with address and byte count if present
+static std::string CommandText(const Frame &frame, DisplayBase display_base)
+{
+	char number_str[128];
+	std::string s;
+	SpiCmdData *cmd = spiFlash.GetCommandByRef(frame.mData2);
+
+	if (cmd)
+	{
+		s = cmd->mNames.back();
+		if (cmd->mAddressBits)
+		{
+			U32 addr = U32(frame.mData1 >> 32);
+			AnalyzerHelpers::GetNumberString(addr, Hexadecimal, AddressBits(addr), number_str, 128);
+			s += "  A=";
+			s += number_str;
+		}
+		if (cmd->mCmdOp == OP_DATA_READ || cmd->mCmdOp == OP_DATA_WRITE)
+		{
+			AnalyzerHelpers::GetNumberString(frame.mData1 & 0xFFFFFFFF, Decimal, 32, number_str, 128);
+			s += "  bytes:";
+			s += number_str;
+			if (frame.mType == FT_CMD && (frame.mData1 & 0xFFFFFFFF))
+			{
+				snprintf(number_str, sizeof(number_str), "  crc32c=%08X", U32(frame.mData2 >> 32));
+				s += number_str;
+			}
+		}
+	}
+	else if (IsUnknownCmdRef(frame.mData2))
+	{
+		AnalyzerHelpers::GetNumberString(RefOpcode(frame.mData2), display_base, 8, number_str, 128);
+		s = "?? CMD=";
+		s += number_str;
+	}
+	if (frame.mType == FT_POLL)
+	{
+		AnalyzerHelpers::GetNumberString(frame.mData1 & 0xFFFFFFFF, Decimal, 32, number_str, 128);
+		s += "  polls:";
+		s += number_str;
+		AnalyzerHelpers::GetNumberString(frame.mData1 >> 32, display_base, 8, number_str, 128);
+		s += "  last=";
+		s += number_str;
+	}
+	if (s.size())
+		s = DeviceText(frame.mData2) + s;
+	return s;
+}
+
 void SpiFlashAnalyzerResults::AddRegisterResult(RegisterData *reg, U64 val, DisplayBase display_base)
 {
 	char number_str[128];
@@ -89,73 +157,70 @@ void SpiFlashAnalyzerResults::GenerateBubbleText(U64 frame_index, Channel& chann
 	Frame frame = GetFrame(frame_index);
 
 	char number_str[128];
-	char number_str2[10];
 	std::stringstream fulls, shorts;
 
-	if (frame.mType == FT_CMD && channel == mSettings->mChipSelect)
+	// Command goes to CS line of its device
+	if (frame.mType == FT_CMD && channel == mSettings->GetChipSelect(RefDevice(frame.mData2)))
 	{
-		SpiCmdData *cmd = reinterpret_cast<SpiCmdData *>(frame.mData2);
-		if (U64(cmd) > 0x100)
+		SpiCmdData *cmd = spiFlash.GetCommandByRef(frame.mData2);
+		if (cmd)
 		{
-			size_t i;
-			const char *s[4] = { 0 };
-			for (i = 0; i < cmd->mNames.size(); ++i)
+			for (size_t i = 0; i < cmd->mNames.size(); ++i)
 				AddResultString(cmd->mNames[i].c_str());
-			if (cmd->mAddressBits)
-			{
-				U32 addr = U32(frame.mData1 >> 24);
-				s[0] = "  A=";
-				s[1] = number_str;
-				AnalyzerHelpers::GetNumberString(addr, Hexadecimal, AddressBits(addr), number_str, 128);
-			}
-			if (cmd->mCmdOp == OP_DATA_READ || cmd->mCmdOp == OP_DATA_WRITE)
-			{
-				s[2] = "  bytes:";
-				s[3] = number_str2;
-				AnalyzerHelpers::GetNumberString(frame.mData1 & 0xFFFFFF, Decimal, 24, number_str2, 128);
-			}
 			// Add longest name with address and byte count if present
-			AddResultString(cmd->mNames[i - 1].c_str(), s[0], s[1], s[2], s[3]);
+			AddResult(CommandText(frame, display_base));
 		}
 		else
 		{
 			AddResultString("??");
-			if (frame.mData2 != 0x100)
-			{
-				AnalyzerHelpers::GetNumberString(frame.mData2, display_base, 8, number_str, 128);
-				AddResultString("?? CMD=", number_str);
-			}
+			if (IsUnknownCmdRef(frame.mData2))
+				AddResult(CommandText(frame, display_base));
 		}
 	}
+	else if (frame.mType == FT_POLL && channel == mSettings->GetChipSelect(RefDevice(frame.mData2)))
+	{
+		char time_str[32];
+		SpiCmdData *cmd = spiFlash.GetCommandByRef(frame.mData2);
+		AnalyzerHelpers::GetNumberString(frame.mData1 & 0xFFFFFFFF, Decimal, 32, number_str, 128);
+		AddResultString("x", number_str);
+		if (cmd)
+			AddResultString(cmd->mNames[0].c_str(), " x", number_str);
+		AddResult(CommandText(frame, display_base));
+		// Time device was busy as seen by polling
+		double busy = double(frame.mEndingSampleInclusive - frame.mStartingSampleInclusive) / mAnalyzer->GetSampleRate();
+		snprintf(time_str, sizeof(time_str), "  busy %.3f ms", busy * 1e3);
+		AddResult(CommandText(frame, display_base) + time_str);
+	}
 	else if (frame.mType == FT_CMD_BYTE && channel == mSettings->mMosi)
 	{
-		SpiCmdData *cmd = reinterpret_cast<SpiCmdData *>(frame.mData2);
-		if (frame.mData2 == 0x100)
+		SpiCmdData *cmd = spiFlash.GetCommandByRef(frame.mData2);
+		if (frame.mData2 == CMD_REF_NONE)
 			AddResultString("?"); // Not enough bits
-		else if (frame.mData2 < 0x100)
+		else if (cmd == nullptr)
 		{
 			// Normal byte and CMD=0xXX
-			AnalyzerHelpers::GetNumberString(frame.mData2, display_base, 8, number_str, 128);
+			AnalyzerHelpers::GetNumberString(RefOpcode(frame.mData2), display_base, 8, number_str, 128);
 			AddResultString(number_str);
-			AnalyzerHelpers::GetNumberString(frame.mData2, Hexadecimal, 8, number_str, 128);
+			AnalyzerHelpers::GetNumberString(RefOpcode(frame.mData2), Hexadecimal, 8, number_str, 128);
 			AddResultString("CMD=", number_str);
 		}
 		else
 		{
 			size_t i;
-			U8 b = cmd->GetCode();
-			AnalyzerHelpers::GetNumberString(b, display_base, 8, number_str, 128);
+			// Two byte opcode shown whole
+			U32 bits = frame.mData1 > 0xFF ? 16 : 8;
+			AnalyzerHelpers::GetNumberString(frame.mData1, display_base, bits, number_str, 128);
 			AddResultString(number_str);
-			AnalyzerHelpers::GetNumberString(b, Hexadecimal, 8, number_str, 128);
+			AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, bits, number_str, 128);
 			AddResultString("CMD=", number_str);
 			for (i = 0; i < cmd->mNames.size(); ++i)
 				AddResultString(cmd->mNames[i].c_str());
 			AddResultString(cmd->mNames[i - 1].c_str(), " CMD=", number_str);
 		}
 	}
-	else if (frame.mType == FT_OUT_ADDR24 && channel == mSettings->mMosi)
+	else if ((frame.mType == FT_OUT_ADDR24 || frame.mType == FT_OUT_ADDR32) && channel == mSettings->mMosi)
 	{
-		AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, AddressBits(U32(frame.mData1 >> 24)),
+		AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, frame.mType == FT_OUT_ADDR32 ? 32 : AddressBits(U32(frame.mData1)),
 			number_str, 128);
 		AddResultString("A");
 		AddResultString(number_str);
@@ -168,11 +233,11 @@ void SpiFlashAnalyzerResults::GenerateBubbleText(U64 frame_index, Channel& chann
 	}
 	else if (frame.mType == FT_IN_REG && channel == mSettings->mMiso)
 	{
-		AddRegisterResult(reinterpret_cast<RegisterData *>(frame.mData1), frame.mData2, display_base);
+		AddRegisterResult(spiFlash.GetRegisterByRef(frame.mData1), frame.mData2, display_base);
 	}
 	else if (frame.mType == FT_OUT_REG && channel == mSettings->mMosi)
 	{
-		AddRegisterResult(reinterpret_cast<RegisterData *>(frame.mData2), frame.mData1, display_base);
+		AddRegisterResult(spiFlash.GetRegisterByRef(frame.mData2), frame.mData1, display_base);
 	}
 	else if ((frame.mType == FT_M) && channel == mSettings->mMosi)
 	{
@@ -194,9 +259,18 @@ void SpiFlashAnalyzerResults::GenerateBubbleText(U64 frame_index, Channel& chann
 	}
 }
 
-void SpiFlashAnalyzerResults::GenerateExportFile(const char* file, DisplayBase display_base, U32 export_type_user_id)
+void SpiFlashAnalyzerResults::FetchFrames(ExportChunk &chunk, U64 first, U64 end)
 {
-	std::ofstream file_stream(file, std::ios::out);
+	chunk.mFirstFrame = first;
+	chunk.mFrames.reserve(size_t(end - first));
+	for (U64 i = first; i < end; ++i)
+		chunk.mFrames.push_back(GetFrame(i));
+}
+
+void SpiFlashAnalyzerResults::ExportCsv(const char* file, DisplayBase display_base)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	ParallelExport exporter;
 
 	U64 trigger_sample = mAnalyzer->GetTriggerSample();
 	U32 sample_rate = mAnalyzer->GetSampleRate();
@@ -204,69 +278,938 @@ void SpiFlashAnalyzerResults::GenerateExportFile(const char* file, DisplayBase d
 	file_stream << "Time [s],Value" << '\n';
 
 	U64 num_frames = GetNumFrames();
-	for (U32 i = 0; i < num_frames; i++)
-	{
-		Frame frame = GetFrame(i);
+	U64 chunk_frames = ParallelExport::FRAMES_PER_CHUNK;
+	exporter.Run((num_frames + chunk_frames - 1) / chunk_frames,
+		[&](ExportChunk &chunk)
+		{
+			U64 first = chunk.mIndex * chunk_frames;
+			FetchFrames(chunk, first, std::min(first + chunk_frames, num_frames));
+		},
+		[&](ExportChunk &chunk)
+		{
+			char time_str[128];
+			char number_str[128];
+
+			for (size_t i = 0; i < chunk.mFrames.size(); ++i)
+			{
+				const Frame &frame = chunk.mFrames[i];
+				AnalyzerHelpers::GetTimeString(frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128);
+				AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 8, number_str, 128);
+				chunk.mText += time_str;
+				chunk.mText += ',';
+				chunk.mText += number_str;
+				chunk.mText += '\n';
+			}
+		},
+		[&](const ExportChunk &chunk)
+		{
+			file_stream.write(chunk.mText.data(), chunk.mText.size());
+			return !UpdateExportProgressAndCheckForCancel(chunk.mFirstFrame + chunk.mFrames.size(), num_frames);
+		});
 
-		char time_str[128];
-		AnalyzerHelpers::GetTimeString(frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128);
+	file_stream.close();
+}
 
-		char number_str[128];
-		AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 8, number_str, 128);
+static U64 SampleToNs(U64 sample, U32 sampleRate)
+{
+	// Split to avoid overflow for long captures
+	return (sample / sampleRate) * 1000000000ULL + (sample % sampleRate) * 1000000000ULL / sampleRate;
+}
+
+void SpiFlashAnalyzerResults::FormatPcapngPackets(ExportChunk &chunk, U32 sample_rate)
+{
+	PcapngWriter writer(chunk.mText);
+	// Data phase of one transaction, never grows above snap length
+	std::vector<U8> data;
+	U64 dataLength = 0;
+	bool cmdByteSeen = false;
 
-		file_stream << time_str << "," << number_str << '\n';
+	data.reserve(PCAPNG_SNAPLEN);
 
-		if (UpdateExportProgressAndCheckForCancel(i, num_frames) == true)
+	for (size_t i = 0; i < chunk.mFrames.size(); i++)
+	{
+		const Frame &frame = chunk.mFrames[i];
+
+		switch (frame.mType)
 		{
-			file_stream.close();
-			return;
+		case FT_CMD_BYTE:
+			cmdByteSeen = true;
+			continue;
+		case FT_OUT_BYTE:
+		case FT_OUT_REG:
+			if (data.size() < PCAPNG_SNAPLEN)
+				data.push_back(U8(frame.mData1));
+			dataLength++;
+			continue;
+		case FT_IN_BYTE:
+		case FT_IN_REG:
+			if (data.size() < PCAPNG_SNAPLEN)
+				data.push_back(U8(frame.mData2));
+			dataLength++;
+			continue;
+		case FT_IN_OUT:
+			// Raw exchange, MOSI followed by MISO
+			if (data.size() + 1 < PCAPNG_SNAPLEN)
+			{
+				data.push_back(U8(frame.mData1));
+				data.push_back(U8(frame.mData2));
+			}
+			dataLength += 2;
+			continue;
+		case FT_CMD:
+			break;
+		case FT_POLL:
+			// Whole polling run in one packet, data is last register value
+			data.assign(1, U8(frame.mData1 >> 32));
+			dataLength = 1;
+			break;
+		default:
+			continue;
+		}
+
+		// Command frame is added after all frames of the transaction
+		PcapngSpiHeader header = PcapngSpiHeader();
+		header.mVersion = PCAPNG_SPI_HEADER_VERSION;
+		SpiCmdData *cmd = spiFlash.GetCommandByRef(frame.mData2);
+		header.mCmdLines = frame.mFlags & 0x0F;
+		header.mDataLength = U32(dataLength);
+		if (cmd)
+		{
+			header.mFlags = PSF_KNOWN_CMD;
+			header.mOpcode = cmd->GetCode();
+			if (frame.mType == FT_POLL)
+			{
+				header.mFlags |= PSF_POLL_SUMMARY;
+				header.mAddress = U32(frame.mData1);
+			}
+			else if (!cmdByteSeen)
+				header.mFlags |= PSF_CONTINUOUS_READ;
+			if (frame.mType == FT_CMD && dataLength && (cmd->mCmdOp == OP_DATA_READ || cmd->mCmdOp == OP_DATA_WRITE))
+			{
+				header.mFlags |= PSF_DIGEST;
+				header.mDigest = U32(frame.mData2 >> 32);
+			}
+			if (cmd->mDtr || (frame.mFlags & CMD_FLAG_DTR))
+				header.mFlags |= PSF_DTR;
+			if (frame.mFlags & CMD_FLAG_DTR)
+				header.mFlags |= PSF_DTR_COMMAND;
+			header.mAddressLines = cmd->mModeArgs ? cmd->mModeArgs : header.mCmdLines;
+			header.mDataLines = cmd->mModeData ? cmd->mModeData : header.mAddressLines;
+			if (cmd->mAddressBits)
+			{
+				header.mFlags |= PSF_ADDRESS;
+				header.mAddressBits = U8(cmd->mAddressBits != 0xFF ? cmd->mAddressBits : (frame.mFlags & CMD_FLAG_ADDR4) ? 32 : 24);
+				header.mAddress = U32(frame.mData1 >> 32);
+			}
+			switch (cmd->mCmdOp)
+			{
+			case OP_DATA_WRITE:
+			case OP_REG_WRITE:
+				header.mDirection = PSD_OUT;
+				break;
+			case OP_DATA_READ:
+			case OP_REG_READ:
+				header.mDirection = PSD_IN;
+				break;
+			default:
+				header.mDirection = PSD_NONE;
+				break;
+			}
 		}
+		else
+		{
+			header.mCmdLines = header.mAddressLines = header.mDataLines = header.mCmdLines;
+			if ((frame.mData2 & CMD_REF_MASK) == CMD_REF_NONE)
+				header.mFlags = PSF_INCOMPLETE;
+			else
+			{
+				header.mOpcode = RefOpcode(frame.mData2);
+				header.mDirection = dataLength ? PSD_IN_OUT : PSD_NONE;
+			}
+		}
+
+		writer.WritePacket(SampleToNs(frame.mStartingSampleInclusive, sample_rate), header,
+			data.empty() ? nullptr : &data[0], data.size());
+
+		data.clear();
+		dataLength = 0;
+		cmdByteSeen = false;
 	}
+}
+
+void SpiFlashAnalyzerResults::ExportPcapng(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	ParallelExport exporter;
+	std::string header;
+
+	if (!file_stream.is_open())
+		return;
+
+	PcapngWriter(header).WriteHeader();
+	file_stream.write(header.data(), header.size());
+
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+	U64 num_frames = GetNumFrames();
+	U64 num_transactions = mTransactions.GetCount();
+	// Chunks never split transaction, they start at first frame of transaction
+	U64 chunk_transactions = ParallelExport::FRAMES_PER_CHUNK / 16;
+	U64 chunk_count = num_transactions ? (num_transactions + chunk_transactions - 1) / chunk_transactions : 1;
+	if (num_frames == 0)
+		chunk_count = 0;
+
+	exporter.Run(chunk_count,
+		[&](ExportChunk &chunk)
+		{
+			TransactionEntry entry;
+			U64 first = 0;
+			U64 end = num_frames;
+			if (chunk.mIndex && mTransactions.Get(chunk.mIndex * chunk_transactions, entry))
+				first = entry.mFirstFrame;
+			if (mTransactions.Get((chunk.mIndex + 1) * chunk_transactions, entry))
+				end = entry.mFirstFrame;
+			FetchFrames(chunk, first, end);
+		},
+		[&](ExportChunk &chunk)
+		{
+			FormatPcapngPackets(chunk, sample_rate);
+		},
+		[&](const ExportChunk &chunk)
+		{
+			file_stream.write(chunk.mText.data(), chunk.mText.size());
+			return !UpdateExportProgressAndCheckForCancel(chunk.mFirstFrame + chunk.mFrames.size(), num_frames);
+		});
 
 	file_stream.close();
+
+	// Address index goes next to the capture
+	mAddressIndex.Save((std::string(file) + ".aidx").c_str());
 }
 
-void SpiFlashAnalyzerResults::GenerateFrameTabularText(U64 frame_index, DisplayBase display_base)
+void SpiFlashAnalyzerResults::ExportAddressQuery(const char* file, DisplayBase display_base)
 {
-	ClearTabularText();
-	Frame frame = GetFrame(frame_index);
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	ParallelExport exporter;
+	std::vector<AddressRange> ranges;
+	U32 first;
+	U32 last;
 
-	char number_str[128];
-	char number_str2[10];
-	if (frame.mType == FT_CMD)
-	{
-		SpiCmdData *cmd = reinterpret_cast<SpiCmdData *>(frame.mData2);
-		if (U64(cmd) > 0x100)
+	U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+
+	file_stream << "Transaction,Time [s],Command,First,Last" << '\n';
+
+	if (AddressIndex::ParseRange(mSettings->mAddressQuery.c_str(), first, last))
+		mAddressIndex.Query(first, last, ranges);
+
+	// Chunk holds command frame of each range, mFirstFrame is index of first range
+	U64 chunk_ranges = ParallelExport::FRAMES_PER_CHUNK / 4;
+	exporter.Run((ranges.size() + chunk_ranges - 1) / chunk_ranges,
+		[&](ExportChunk &chunk)
 		{
-			const char *s[4] = { 0 };
-			if (cmd->mAddressBits)
+			chunk.mFirstFrame = chunk.mIndex * chunk_ranges;
+			U64 end = std::min(chunk.mFirstFrame + chunk_ranges, U64(ranges.size()));
+			for (U64 i = chunk.mFirstFrame; i < end; ++i)
 			{
-				U32 addr = U32(frame.mData1 >> 24);
-				s[0] = "  A=";
-				s[1] = number_str;
-				AnalyzerHelpers::GetNumberString(addr, Hexadecimal, AddressBits(addr), number_str, 128);
+				TransactionEntry entry;
+				if (mTransactions.Get(ranges[size_t(i)].mTransaction, entry))
+				{
+					chunk.mFrames.push_back(GetFrame(entry.GetLastFrame()));
+				}
+				else
+				{
+					chunk.mFrames.push_back(Frame());
+					chunk.mFrames.back().mData2 = CMD_REF_NONE;
+				}
 			}
-			if (cmd->mCmdOp == OP_DATA_READ || cmd->mCmdOp == OP_DATA_WRITE)
+		},
+		[&](ExportChunk &chunk)
+		{
+			char time_str[128];
+			char first_str[32];
+			char last_str[32];
+			char id_str[32];
+
+			for (size_t i = 0; i < chunk.mFrames.size(); ++i)
 			{
-				s[2] = "  bytes:";
-				s[3] = number_str2;
-				AnalyzerHelpers::GetNumberString(frame.mData1 & 0xFFFFFF, Decimal, 24, number_str2, 128);
+				const Frame &frame = chunk.mFrames[i];
+				const AddressRange &range = ranges[size_t(chunk.mFirstFrame + i)];
+				if ((frame.mData2 & CMD_REF_MASK) == CMD_REF_NONE)
+					continue;
+
+				AnalyzerHelpers::GetTimeString(frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128);
+				AnalyzerHelpers::GetNumberString(range.mFirst, Hexadecimal, 32, first_str, 32);
+				AnalyzerHelpers::GetNumberString(range.mLast, Hexadecimal, 32, last_str, 32);
+				snprintf(id_str, sizeof(id_str), "%llu", (unsigned long long)range.mTransaction);
+
+				chunk.mText += id_str;
+				chunk.mText += ',';
+				chunk.mText += time_str;
+				chunk.mText += ',';
+				chunk.mText += CommandText(frame, display_base);
+				chunk.mText += ',';
+				chunk.mText += first_str;
+				chunk.mText += ',';
+				chunk.mText += last_str;
+				chunk.mText += '\n';
 			}
-			// Add longest name with address and byte count if present
-			AddTabularText(cmd->mNames.back().c_str(), s[0], s[1], s[2], s[3]);
+		},
+		[&](const ExportChunk &chunk)
+		{
+			file_stream.write(chunk.mText.data(), chunk.mText.size());
+			return !UpdateExportProgressAndCheckForCancel(chunk.mFirstFrame + chunk.mFrames.size(), ranges.size());
+		});
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportTimeline(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	ParallelExport exporter;
+	std::vector<TimelineBucket> buckets;
+
+	U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+
+	file_stream << "Time [s],Duration [s],Transactions,Bytes,Payload bits,Overhead bits,Busy [%],"
+		"Effective SCK [Hz],Gaps,Average gap [s],Max gap [s]" << '\n';
+
+	// Finest resolution that keeps file reasonable
+	U64 last_sample = mTimeline.GetLastSample();
+	int level = mTimeline.GetLevel(0, last_sample, 100000);
+	U64 bucket_samples = mTimeline.GetBucketSamples(level);
+	mTimeline.Get(level, 0, last_sample, buckets);
+
+	// mFirstFrame is index of first bucket in chunk
+	U64 chunk_buckets = ParallelExport::FRAMES_PER_CHUNK;
+	U64 chunk_count = (buckets.size() + chunk_buckets - 1) / chunk_buckets;
+	exporter.Run(chunk_count,
+		[&](ExportChunk &chunk)
+		{
+			chunk.mFirstFrame = chunk.mIndex * chunk_buckets;
+		},
+		[&](ExportChunk &chunk)
+		{
+			char time_str[128];
+			char line[300];
+			U64 end = std::min(chunk.mFirstFrame + chunk_buckets, U64(buckets.size()));
+
+			for (U64 i = chunk.mFirstFrame; i < end; ++i)
+			{
+				const TimelineBucket &b = buckets[size_t(i)];
+				AnalyzerHelpers::GetTimeString(i * bucket_samples, trigger_sample, sample_rate, time_str, 128);
+				snprintf(line, sizeof(line), "%s,%.9f,%llu,%llu,%llu,%llu,%.2f,%.0f,%llu,%.9f,%.9f\n",
+					time_str, double(bucket_samples) / sample_rate,
+					(unsigned long long)b.mTransactions, (unsigned long long)b.mBytes,
+					(unsigned long long)b.mPayloadBits, (unsigned long long)b.mOverheadBits,
+					100.0 * b.mBusySamples / bucket_samples,
+					b.mClockSamples ? double(b.mClockCycles) * sample_rate / b.mClockSamples : 0.0,
+					(unsigned long long)b.mGapCount,
+					b.mGapCount ? double(b.mGapSamples) / b.mGapCount / sample_rate : 0.0,
+					double(b.mGapMax) / sample_rate);
+				chunk.mText += line;
+			}
+		},
+		[&](const ExportChunk &chunk)
+		{
+			file_stream.write(chunk.mText.data(), chunk.mText.size());
+			return !UpdateExportProgressAndCheckForCancel(chunk.mIndex + 1, chunk_count);
+		});
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportCommandStats(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	std::vector<CommandStatsEntry> entries;
+	CommandStats stats;
+	U64 total = 0;
+	char line[512];
+
+	double us = 1e6 / mAnalyzer->GetSampleRate();
+
+	// Entries of other devices have device in command reference, they stay separate
+	for (U32 device = 0; device < MAX_DEVICES; ++device)
+		stats.Merge(mCommandStats[device]);
+	stats.GetEntries(entries);
+	for (size_t i = 0; i < entries.size(); ++i)
+		total += entries[i].mDuration.GetSum();
+
+	file_stream << "Command,Opcode,Count,Bytes,CS active [s],Share [%],"
+		"CS active min [us],mean [us],p50 [us],p90 [us],p99 [us],max [us],"
+		"Clocks mean,p50,p99,max,Gap to next p50 [us],p99 [us],max [us]" << '\n';
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const CommandStatsEntry &e = entries[i];
+		const SpiCmdData *cmd = spiFlash.GetCommandByRef(e.mCmdRef);
+		U8 opcode = cmd ? cmd->GetCode() : U8(RefOpcode(e.mCmdRef));
+
+		snprintf(line, sizeof(line), "%s%s,0x%02X,%llu,%llu,%.9f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,"
+			"%.1f,%llu,%llu,%llu,%.3f,%.3f,%.3f\n",
+			DeviceText(e.mCmdRef).c_str(), cmd ? cmd->mNames.back().c_str() : "??", opcode,
+			(unsigned long long)e.mDuration.GetCount(), (unsigned long long)e.mBytes,
+			e.mDuration.GetSum() * us / 1e6, total ? 100.0 * e.mDuration.GetSum() / total : 0.0,
+			e.mDuration.GetMin() * us, e.mDuration.GetMean() * us, e.mDuration.GetPercentile(50) * us,
+			e.mDuration.GetPercentile(90) * us, e.mDuration.GetPercentile(99) * us, e.mDuration.GetMax() * us,
+			e.mClocks.GetMean(), (unsigned long long)e.mClocks.GetPercentile(50),
+			(unsigned long long)e.mClocks.GetPercentile(99), (unsigned long long)e.mClocks.GetMax(),
+			e.mGapToNext.GetPercentile(50) * us, e.mGapToNext.GetPercentile(99) * us, e.mGapToNext.GetMax() * us);
+		file_stream << line;
+
+		if (UpdateExportProgressAndCheckForCancel(i, entries.size()) == true)
+			break;
+	}
+
+	file_stream.close();
+}
+
+static std::string OperationFlagsText(U8 flags)
+{
+	std::string s;
+
+	if (flags & OF_OUTLIER)
+		s += " outlier";
+	if (flags & OF_NO_WREN)
+		s += " no-WREN";
+	if (flags & OF_NOT_SEEN_BUSY)
+		s += " ready-at-first-read";
+	return s.size() ? s.substr(1) : s;
+}
+
+void SpiFlashAnalyzerResults::ExportLatency(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	std::vector<DeviceOperation> operations;
+	std::vector<LatencyEntry> entries;
+	char time_str[128];
+	char line[512];
+
+	U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+	double us = 1e6 / sample_rate;
+
+	mLatency.GetOperations(operations);
+	mLatency.GetEntries(entries);
+
+	// Summary per operation type first
+	file_stream << "Operation,Opcode,Count,Limit [us],Outliers,Busy min [us],mean [us],p50 [us],p90 [us],p99 [us],max [us]" << '\n';
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const LatencyEntry &e = entries[i];
+		const SpiCmdData *cmd = spiFlash.GetCommandByRef(e.mCmdRef);
+		snprintf(line, sizeof(line), "%s,0x%02X,%llu,%.3f,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			cmd ? cmd->mNames.back().c_str() : "??", cmd ? cmd->GetCode() : 0,
+			(unsigned long long)e.mBusy.GetCount(), e.mLimit * us, (unsigned long long)e.mOutliers,
+			e.mBusy.GetMin() * us, e.mBusy.GetMean() * us, e.mBusy.GetPercentile(50) * us,
+			e.mBusy.GetPercentile(90) * us, e.mBusy.GetPercentile(99) * us, e.mBusy.GetMax() * us);
+		file_stream << line;
+	}
+	for (int k = 0; k < LK_COUNT; ++k)
+	{
+		Histogram h;
+		U64 outliers;
+		U64 limit;
+		mLatency.GetLatency(LatencyKind(k), h, outliers, limit);
+		if (h.GetCount() == 0)
+			continue;
+		snprintf(line, sizeof(line), "%s,,%llu,%.3f,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			LatencyTracker::GetLatencyName(LatencyKind(k)), (unsigned long long)h.GetCount(), limit * us,
+			(unsigned long long)outliers, h.GetMin() * us, h.GetMean() * us, h.GetPercentile(50) * us,
+			h.GetPercentile(90) * us, h.GetPercentile(99) * us, h.GetMax() * us);
+		file_stream << line;
+	}
+	snprintf(line, sizeof(line), "Not confirmed by status read,,%llu\n", (unsigned long long)mLatency.GetUnconfirmed());
+	file_stream << line;
+
+	// Every completed operation
+	file_stream << '\n' << "Time [s],Operation,Address,Busy [us],Resolution [us],WREN to command [us],"
+		"Suspends,Suspended [us],Flags" << '\n';
+	for (size_t i = 0; i < operations.size(); ++i)
+	{
+		const DeviceOperation &op = operations[i];
+		const SpiCmdData *cmd = spiFlash.GetCommandByRef(op.mCmdRef);
+		char address_str[16] = "";
+		if (op.mFlags & OF_ADDRESS)
+			snprintf(address_str, sizeof(address_str), "0x%08X", op.mAddress);
+		AnalyzerHelpers::GetTimeString(op.mStart, trigger_sample, sample_rate, time_str, 128);
+		snprintf(line, sizeof(line), "%s,%s,%s,%.3f,%.3f,%.3f,%u,%.3f,%s\n",
+			time_str, cmd ? cmd->mNames.back().c_str() : "??", address_str, op.mBusy * us, op.mResolution * us,
+			op.mWrenGap * us, unsigned(op.mSuspends), op.mSuspended * us, OperationFlagsText(op.mFlags).c_str());
+		file_stream << line;
+
+		if (UpdateExportProgressAndCheckForCancel(i, operations.size()) == true)
+			break;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportXip(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	XipReport r;
+	char line[200];
+
+	mXip.GetReport(r);
+	U64 fetches = r.mSequentialFetches + r.mRandomFetches;
+	U64 lookups = r.mHits + r.mMisses;
+
+	file_stream << "Item,Value" << '\n';
+	snprintf(line, sizeof(line), "Cache,%u B line / %u ways / %u sets / %u prefetch (%u B)\n",
+		r.mConfig.mLineSize, r.mConfig.mWays, r.mConfig.mSets, r.mConfig.mPrefetch,
+		r.mConfig.mLineSize * r.mConfig.mWays * r.mConfig.mSets);
+	file_stream << line;
+	snprintf(line, sizeof(line), "Sequential fetches,%llu\nSequential bytes,%llu\nRandom fetches,%llu\nRandom bytes,%llu\n"
+		"Sequential share [%%],%.2f\n",
+		(unsigned long long)r.mSequentialFetches, (unsigned long long)r.mSequentialBytes,
+		(unsigned long long)r.mRandomFetches, (unsigned long long)r.mRandomBytes,
+		fetches ? 100.0 * r.mSequentialFetches / fetches : 0.0);
+	file_stream << line;
+	snprintf(line, sizeof(line), "Line hits,%llu\nLine misses,%llu\nHit rate [%%],%.2f\n",
+		(unsigned long long)r.mHits, (unsigned long long)r.mMisses, lookups ? 100.0 * r.mHits / lookups : 0.0);
+	file_stream << line;
+	snprintf(line, sizeof(line), "Prefetched lines,%llu\nPrefetched lines used,%llu\n",
+		(unsigned long long)r.mPrefetched, (unsigned long long)r.mPrefetchUsed);
+	file_stream << line;
+	// Negative when cache line fills read more than captured fetches
+	snprintf(line, sizeof(line), "Captured bus bytes,%llu\nCache model bus bytes,%llu\nBus bytes saved,%lld\n",
+		(unsigned long long)r.mBusBytes, (unsigned long long)r.mModelBytes, (long long)(r.mBusBytes - r.mModelBytes));
+	file_stream << line;
+
+	file_stream << '\n' << "Region,Misses" << '\n';
+	for (size_t i = 0; i < r.mHotMisses.size(); ++i)
+	{
+		snprintf(line, sizeof(line), "0x%08X,%llu\n", r.mHotMisses[i].mAddress, (unsigned long long)r.mHotMisses[i].mMisses);
+		file_stream << line;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportEfficiency(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	FindingTotal totals[FI_COUNT];
+	std::vector<Finding> findings;
+	char time_str[128];
+	char line[300];
+	U64 wasted = 0;
+
+	U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+	double us = 1e6 / sample_rate;
+
+	mEfficiency.GetTotals(totals);
+	mEfficiency.GetFindings(findings);
+
+	file_stream << "Finding,Count,Wasted [us]" << '\n';
+	for (int i = 0; i < FI_COUNT; ++i)
+	{
+		snprintf(line, sizeof(line), "%s,%llu,%.3f\n", DriverEfficiency::GetFindingName(FindingType(i)),
+			(unsigned long long)totals[i].mCount, totals[i].mWasted * us);
+		file_stream << line;
+		wasted += totals[i].mWasted;
+	}
+	snprintf(line, sizeof(line), "Total,,%.3f\n", wasted * us);
+	file_stream << line;
+
+	file_stream << '\n' << "Time [s],Transaction,Finding,Address,Wasted [us]" << '\n';
+	for (size_t i = 0; i < findings.size(); ++i)
+	{
+		const Finding &f = findings[i];
+		AnalyzerHelpers::GetTimeString(f.mSample, trigger_sample, sample_rate, time_str, 128);
+		snprintf(line, sizeof(line), "%s,%llu,%s,0x%08X,%.3f\n", time_str, (unsigned long long)f.mTransaction,
+			DriverEfficiency::GetFindingName(FindingType(f.mType)), f.mAddress, f.mWasted * us);
+		file_stream << line;
+
+		if (UpdateExportProgressAndCheckForCancel(i, findings.size()) == true)
+			break;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportReference(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	ReferenceTotals totals;
+	std::vector<ReferenceMismatch> mismatches;
+	char line[300];
+
+	mReference.GetTotals(totals);
+	mReference.GetMismatches(mismatches);
+
+	snprintf(line, sizeof(line), "Reads,%llu\nBytes,%llu\nMismatched reads,%llu\nMismatched bytes,%llu\n"
+		"Bytes outside image,%llu\n", (unsigned long long)totals.mReads, (unsigned long long)totals.mBytes,
+		(unsigned long long)totals.mMismatchedReads, (unsigned long long)totals.mMismatchedBytes,
+		(unsigned long long)totals.mOutsideBytes);
+	file_stream << line;
+
+	file_stream << '\n' << "Transaction,Address,Expected,Actual" << '\n';
+	for (size_t i = 0; i < mismatches.size(); ++i)
+	{
+		const ReferenceMismatch &m = mismatches[i];
+		snprintf(line, sizeof(line), "%llu,0x%08X,0x%02X,0x%02X\n", (unsigned long long)m.mTransaction,
+			m.mAddress, m.mExpected, m.mActual);
+		file_stream << line;
+
+		if (UpdateExportProgressAndCheckForCancel(i, mismatches.size()) == true)
+			break;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportEmulator(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	EmulatorTotals totals;
+	std::vector<EmulatorFinding> findings;
+	char time_str[128];
+	char line[300];
+
+	U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+
+	mEmulator.GetTotals(totals);
+	mEmulator.GetFindings(findings);
+
+	snprintf(line, sizeof(line), "Reads,%llu\nChecked bytes,%llu\nLearned bytes,%llu\nPrograms,%llu\nErases,%llu\n"
+		"Model blocks,%llu\nModel memory [KiB],%llu\n", (unsigned long long)totals.mReads,
+		(unsigned long long)totals.mCheckedBytes, (unsigned long long)totals.mLearnedBytes,
+		(unsigned long long)totals.mPrograms, (unsigned long long)totals.mErases, (unsigned long long)totals.mBlocks,
+		(unsigned long long)(totals.mBlocks * sizeof(EmulatorBlock) / 1024));
+	file_stream << line;
+	for (int i = 0; i < EF_COUNT; ++i)
+	{
+		snprintf(line, sizeof(line), "%s,%llu\n", FlashEmulator::GetFindingName(EmulatorFindingType(i)),
+			(unsigned long long)totals.mFindings[i]);
+		file_stream << line;
+	}
+
+	file_stream << '\n' << "Time [s],Transaction,Finding,Area,Address,Bytes,Expected,Actual" << '\n';
+	for (size_t i = 0; i < findings.size(); ++i)
+	{
+		const EmulatorFinding &f = findings[i];
+		AnalyzerHelpers::GetTimeString(f.mSample, trigger_sample, sample_rate, time_str, 128);
+		snprintf(line, sizeof(line), "%s,%llu,%s,%s,0x%08X,%u", time_str, (unsigned long long)f.mTransaction,
+			FlashEmulator::GetFindingName(EmulatorFindingType(f.mType)), f.mOtp ? "OTP" : "Array", f.mAddress, f.mCount);
+		file_stream << line;
+		if (f.mCount)
+		{
+			snprintf(line, sizeof(line), ",0x%02X,0x%02X", f.mExpected, f.mActual);
+			file_stream << line;
 		}
-		else
+		file_stream << '\n';
+
+		if (UpdateExportProgressAndCheckForCancel(i, findings.size()) == true)
+			break;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportWear(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	WearTotals totals;
+	std::vector<WearEntry> entries;
+	char line[300];
+
+	mWear.GetTotals(totals);
+	snprintf(line, sizeof(line), "Sector erases,%llu\nBlock erases,%llu\nChip erases,%llu\nPrograms,%llu\n"
+		"Programmed bytes,%llu\n", (unsigned long long)totals.mSectorErases, (unsigned long long)totals.mBlockErases,
+		(unsigned long long)totals.mChipErases, (unsigned long long)totals.mPrograms,
+		(unsigned long long)totals.mProgrammedBytes);
+	file_stream << line;
+
+	mWear.GetTopSectors(entries);
+	file_stream << '\n' << "Sector,Erases,Programmed bytes" << '\n';
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		snprintf(line, sizeof(line), "0x%08X,%u,%u\n", entries[i].mAddress, entries[i].mErases,
+			entries[i].mProgrammedBytes);
+		file_stream << line;
+	}
+
+	mWear.GetTopBlocks(entries);
+	file_stream << '\n' << "Block,Erases,Programmed bytes" << '\n';
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		snprintf(line, sizeof(line), "0x%08X,%u,%u\n", entries[i].mAddress, entries[i].mErases,
+			entries[i].mProgrammedBytes);
+		file_stream << line;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportWearMap(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	ParallelExport exporter;
+	WearHeatMap map;
+	std::string header;
+
+	mWear.GetHeatMap(map);
+	WearMap::WriteHeatMapHeader(map, header);
+	file_stream.write(header.data(), header.size());
+
+	// mFirstFrame is first sector row in chunk, 64 rows cover 32 MiB
+	U64 chunk_rows = 64;
+	U64 chunk_count = (map.mRows + chunk_rows - 1) / chunk_rows;
+	exporter.Run(chunk_count,
+		[&](ExportChunk &chunk)
+		{
+			chunk.mFirstFrame = chunk.mIndex * chunk_rows;
+		},
+		[&](ExportChunk &chunk)
 		{
-			if (frame.mData2 != 0x100)
+			WearMap::WriteHeatMapRows(map, U32(chunk.mFirstFrame), U32(chunk_rows), chunk.mText);
+		},
+		[&](const ExportChunk &chunk)
+		{
+			file_stream.write(chunk.mText.data(), chunk.mText.size());
+			return !UpdateExportProgressAndCheckForCancel(chunk.mIndex + 1, chunk_count);
+		});
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportDigests(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	std::vector<DigestRange> ranges;
+	char line[300];
+
+	mDigests.GetRanges(ranges);
+
+	file_stream << "First transaction,Last transaction,Data,Address,Length,CRC-32C,SHA-256" << '\n';
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		const DigestRange &r = ranges[i];
+		int n = snprintf(line, sizeof(line), "%llu,%llu,%s,0x%08X,%u,%08X,", (unsigned long long)r.mFirstTransaction,
+			(unsigned long long)r.mLastTransaction, r.mProgram ? "Program" : "Read", r.mAddress, r.mLength, r.mCrc);
+		for (int j = 0; j < Sha256::DIGEST_SIZE; ++j)
+			n += snprintf(line + n, sizeof(line) - n, "%02x", r.mSha256[j]);
+		file_stream << line << '\n';
+
+		if (UpdateExportProgressAndCheckForCancel(i, ranges.size()) == true)
+			break;
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::ExportSfdp(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	static const char *addressBytes[] = { "3", "3 or 4", "4" };
+	static const char *instructions[] = { "13", "0C", "3C", "BC", "6C", "EC", "12", "34", "3E",
+		"erase type 1", "erase type 2", "erase type 3", "erase type 4", "0E", "BE", "EE" };
+	SfdpParameters p;
+	char line[300];
+
+	file_stream << "Parameter,Value" << '\n';
+	for (U32 device = 0; device < MAX_DEVICES; ++device)
+	{
+		// Table of every device on shared lines
+		if (device > 0)
+		{
+			if (mSettings->GetChipSelect(device) == UNDEFINED_CHANNEL)
+				continue;
+			file_stream << "Device,CS " << device + 1 << '\n';
+		}
+		mSfdp[device].GetParameters(p);
+		if (!p.mValid)
+		{
+			file_stream << "Basic Flash Parameter Table,not read" << '\n';
+			continue;
+		}
+		snprintf(line, sizeof(line), "Basic Flash Parameter Table,%u.%u %u DWORDs", p.mMajor, p.mMinor, p.mDwords);
+		file_stream << line << '\n';
+		file_stream << "Address bytes," << addressBytes[p.mAddressBytes] << '\n';
+		snprintf(line, sizeof(line), "Density,%llu Mbit", (unsigned long long)(p.mDensityBits >> 20));
+		file_stream << line << '\n';
+		for (size_t i = 0; i < p.mFastReads.size(); ++i)
+		{
+			const SfdpFastRead &r = p.mFastReads[i];
+			snprintf(line, sizeof(line), "Fast read %u-%u-%u,0x%02X mode clocks %u dummy clocks %u", r.mCmdLines,
+				r.mAddressLines, r.mDataLines, r.mOpcode, r.mModeClocks, r.mDummyClocks);
+			file_stream << line << '\n';
+		}
+		if (p.mPageSize)
+			file_stream << "Page size," << p.mPageSize << '\n';
+		if (p.mEnter4Byte || p.mExit4Byte)
+		{
+			snprintf(line, sizeof(line), "Enter 4-byte addressing,0x%03X\nExit 4-byte addressing,0x%02X",
+				p.mEnter4Byte, p.mExit4Byte);
+			file_stream << line << '\n';
+		}
+		if (p.mHave4ByteTable)
+		{
+			file_stream << "4-byte address instructions,";
+			for (int i = 0; i < 16; ++i)
+				if (p.m4ByteInstructions & (1 << i))
+					file_stream << instructions[i] << ' ';
+			file_stream << '\n';
+		}
+	}
+
+	file_stream.close();
+}
+
+static void TimingRow(std::ofstream &file_stream, const char *group, MarginKind kind, const Histogram &h, double ns)
+{
+	char line[300];
+
+	if (h.GetCount() == 0)
+		return;
+	snprintf(line, sizeof(line), "%s,%s,%llu,%.1f,%.1f,%.1f,%.1f\n", group, TimingMargins::GetKindName(kind),
+		(unsigned long long)h.GetCount(), h.GetMin() * ns, h.GetPercentile(1) * ns, h.GetPercentile(10) * ns,
+		h.GetPercentile(50) * ns);
+	file_stream << line;
+}
+
+void SpiFlashAnalyzerResults::ExportTiming(const char* file)
+{
+	std::ofstream file_stream(file, std::ios::out | std::ios::binary);
+	static const char *lineNames[TimingMargins::LINE_COUNT] = { "D0 (MOSI)", "D1 (MISO)", "D2", "D3", "D4", "D5", "D6", "D7" };
+	std::vector<TimingRecord> worst;
+	Histogram h;
+	char time_str[128];
+	char line[300];
+
+	U64 trigger_sample = mAnalyzer->GetTriggerSample();
+	U32 sample_rate = mAnalyzer->GetSampleRate();
+	double ns = 1e9 / sample_rate;
+
+	// Margins are counted in whole samples
+	snprintf(line, sizeof(line), "Resolution [ns],%.1f\n", ns);
+	file_stream << line;
+	file_stream << '\n' << "Group,Margin,Edges,min [ns],p1 [ns],p10 [ns],p50 [ns]" << '\n';
+	for (U32 mode = 0; mode < TimingMargins::MODE_COUNT; ++mode)
+		for (int k = 0; k < MK_COUNT; ++k)
+		{
+			mTiming.GetByMode(MarginKind(k), mode, h);
+			TimingRow(file_stream, TimingMargins::GetModeName(mode), MarginKind(k), h, ns);
+		}
+	for (U32 i = 0; i < TimingMargins::LINE_COUNT; ++i)
+		for (int k = 0; k < MK_COUNT; ++k)
+		{
+			mTiming.GetByLine(MarginKind(k), i, h);
+			TimingRow(file_stream, lineNames[i], MarginKind(k), h, ns);
+		}
+	for (int k = 0; k < MK_COUNT; ++k)
+	{
+		mTiming.GetCs(MarginKind(k), h);
+		TimingRow(file_stream, "CS", MarginKind(k), h, ns);
+	}
+
+	// Transactions with smallest data margin
+	mTiming.GetWorst(worst);
+	file_stream << '\n' << "Time [s],Transaction,Setup [ns],Setup mode,Setup line,Hold [ns],Hold mode,Hold line,"
+		"CS setup [ns],CS hold [ns]" << '\n';
+	for (size_t i = 0; i < worst.size(); ++i)
+	{
+		const TimingRecord &r = worst[i];
+		std::string fields[MK_COUNT * 3 + 2];
+		for (int k = 0; k < MK_COUNT; ++k)
+		{
+			if (r.mMargin[k] != ~U64(0))
 			{
-				AnalyzerHelpers::GetNumberString(frame.mData2, display_base, 8, number_str, 128);
-				AddTabularText("?? CMD=", number_str);
+				snprintf(line, sizeof(line), "%.1f", r.mMargin[k] * ns);
+				fields[k * 3] = line;
+				fields[k * 3 + 1] = TimingMargins::GetModeName(r.mMode[k]);
+				fields[k * 3 + 2] = lineNames[r.mLine[k]];
+			}
+			if (r.mCsMargin[k] != ~U64(0))
+			{
+				snprintf(line, sizeof(line), "%.1f", r.mCsMargin[k] * ns);
+				fields[MK_COUNT * 3 + k] = line;
 			}
 		}
+		AnalyzerHelpers::GetTimeString(r.mSample, trigger_sample, sample_rate, time_str, 128);
+		file_stream << time_str << ',' << r.mTransaction;
+		for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); ++f)
+			file_stream << ',' << fields[f];
+		file_stream << '\n';
+	}
+
+	file_stream.close();
+}
+
+void SpiFlashAnalyzerResults::GenerateExportFile(const char* file, DisplayBase display_base, U32 export_type_user_id)
+{
+	switch (export_type_user_id)
+	{
+	case EXPORT_PCAPNG:
+		ExportPcapng(file);
+		break;
+	case EXPORT_ADDRESS_QUERY:
+		ExportAddressQuery(file, display_base);
+		break;
+	case EXPORT_TIMELINE:
+		ExportTimeline(file);
+		break;
+	case EXPORT_COMMAND_STATS:
+		ExportCommandStats(file);
+		break;
+	case EXPORT_LATENCY:
+		ExportLatency(file);
+		break;
+	case EXPORT_XIP:
+		ExportXip(file);
+		break;
+	case EXPORT_EFFICIENCY:
+		ExportEfficiency(file);
+		break;
+	case EXPORT_REFERENCE:
+		ExportReference(file);
+		break;
+	case EXPORT_EMULATOR:
+		ExportEmulator(file);
+		break;
+	case EXPORT_WEAR:
+		ExportWear(file);
+		break;
+	case EXPORT_WEAR_MAP:
+		ExportWearMap(file);
+		break;
+	case EXPORT_DIGESTS:
+		ExportDigests(file);
+		break;
+	case EXPORT_SFDP:
+		ExportSfdp(file);
+		break;
+	case EXPORT_TIMING:
+		ExportTiming(file);
+		break;
+	case EXPORT_CSV:
+	default:
+		ExportCsv(file, display_base);
+		break;
+	}
+}
+
+void SpiFlashAnalyzerResults::GenerateFrameTabularText(U64 frame_index, DisplayBase display_base)
+{
+	ClearTabularText();
+	Frame frame = GetFrame(frame_index);
+
+	char number_str[128];
+	if (frame.mType == FT_CMD || frame.mType == FT_POLL)
+	{
+		std::string s = CommandText(frame, display_base);
+		if (s.size())
+			AddTabularText(s.c_str());
 	}
-	else if (frame.mType == FT_OUT_ADDR24)
+	else if (frame.mType == FT_OUT_ADDR24 || frame.mType == FT_OUT_ADDR32)
 	{
-		AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, AddressBits(U32(frame.mData1 >> 24)),
+		AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, frame.mType == FT_OUT_ADDR32 ? 32 : AddressBits(U32(frame.mData1)),
 			number_str, 128);
 		AddTabularText("A=", number_str);
 	}
@@ -291,14 +1234,406 @@ void SpiFlashAnalyzerResults::GenerateFrameTabularText(U64 frame_index, DisplayB
 	}
 }
 
+void SpiFlashAnalyzerResults::SetupAnalyses(U32 sampleRate)
+{
+	XipCacheConfig xipCache;
+
+	mTimeline.SetSampleRate(sampleRate);
+	mLatency.SetSampleRate(sampleRate);
+	if (XipCacheConfig::Parse(mSettings->mXipCache.c_str(), xipCache))
+		mXip.Configure(xipCache);
+	mReference.Open(mSettings->mReferenceImage);
+	mEmulator.Configure(mSettings->mCapacity);
+	mWear.Configure(mSettings->mCapacity);
+	mDigests.Clear();
+	mTiming.Clear();
+	for (U32 i = 0; i < MAX_DEVICES; ++i)
+	{
+		mRegisters[i].Clear();
+		mSfdp[i].Clear();
+		mDeviceId[i] = U8(mSettings->GetManufacturer(i));
+	}
+}
+
+void SpiFlashAnalyzerResults::AccountFrame(const Frame &f)
+{
+	TransactionFrameCounts &c = mCounts;
+	SpiTransaction &t = mCurrent;
+	bool payload = false;
+
+	switch (f.mType)
+	{
+	case FT_CMD_BYTE:
+		// Octal opcode with extension byte
+		c.mCmdBytes += f.mData1 > 0xFF ? 2 : 1;
+		break;
+	case FT_OUT_ADDR24:
+	case FT_OUT_ADDR32:
+		c.mAddresses++;
+		t.mHaveAddress = true;
+		t.mAddress = U32(f.mData1);
+		break;
+	case FT_M:
+		c.mModeBytes++;
+		break;
+	case FT_DUMMY:
+		c.mDummyCycles += U32(f.mData2);
+		break;
+	case FT_OUT_BYTE:
+	case FT_OUT_REG:
+		t.mData.push_back(U8(f.mData1));
+		payload = true;
+		break;
+	case FT_IN_BYTE:
+	case FT_IN_REG:
+		t.mData.push_back(U8(f.mData2));
+		payload = true;
+		break;
+	case FT_IN_OUT:
+		t.mData.push_back(U8(f.mData1));
+		t.mData.push_back(U8(f.mData2));
+		c.mExchanges++;
+		payload = true;
+		break;
+	case FT_CMD:
+		// Command frame is added after all frames of the transaction
+		t.mStart = f.mStartingSampleInclusive;
+		t.mEnd = f.mEndingSampleInclusive;
+		t.mCmdRef = U32(f.mData2);
+		t.mDevice = U8(RefDevice(f.mData2));
+		t.mCmdSetId = U8(RefSetId(f.mData2));
+		t.mBusMode = f.mFlags & 0x0F;
+		t.mCmdDtr = (f.mFlags & CMD_FLAG_DTR) != 0;
+		t.mAddressBits = (f.mFlags & CMD_FLAG_ADDR4) ? 32 : 24;
+		return;
+	default:
+		return;
+	}
+
+	if (payload && t.mDataStart == 0)
+		t.mDataStart = f.mStartingSampleInclusive;
+
+	if (c.mPrevEnd == 0)
+	{
+		t.mFirstClock = f.mStartingSampleInclusive;
+	}
+	else if (U64(f.mStartingSampleInclusive) > c.mPrevEnd)
+	{
+		U64 gap = f.mStartingSampleInclusive - c.mPrevEnd;
+		t.mGapSum += gap;
+		t.mGapCount++;
+		if (gap > t.mGapMax)
+			t.mGapMax = gap > 0xFFFFFFFF ? 0xFFFFFFFF : U32(gap);
+	}
+	c.mPrevEnd = f.mEndingSampleInclusive;
+}
+
+void SpiFlashAnalyzerResults::FinishTransaction(SpiTransaction &t)
+{
+	const TransactionFrameCounts &c = mCounts;
+
+	t.mCmd = spiFlash.GetCommandByRef(t.mCmdRef);
+	t.mOpcode = t.mCmd ? t.mCmd->GetCode() : U8(RefOpcode(t.mCmdRef));
+	t.mContinuous = t.mCmd != nullptr && c.mCmdBytes == 0;
+
+	// Lines used by each phase, same rules as decoder
+	U32 cmdLines = t.mBusMode ? t.mBusMode : 1;
+	U32 argLines = (t.mCmd && t.mCmd->mModeArgs) ? t.mCmd->mModeArgs : cmdLines;
+	U32 dataLines = (t.mCmd && t.mCmd->mModeData) ? t.mCmd->mModeData : argLines;
+	U32 addressBits = (t.mCmd && t.mCmd->mAddressBits != 0xFF) ? t.mCmd->mAddressBits : t.mAddressBits;
+
+	// Full duplex exchange of unknown command, 8 clocks carry 16 bits
+	U32 dataBytes = U32(t.mData.size()) - 2 * c.mExchanges;
+	t.mPayloadBits = dataBytes * 8 + c.mExchanges * 16;
+	t.mOverheadBits = c.mCmdBytes * 8 + c.mAddresses * addressBits + c.mModeBytes * 8 + c.mDummyCycles * argLines;
+	// DTR phases take one clock for two bits on each line, dummy cycles are whole clocks
+	U32 cmdEdges = t.mCmdDtr ? 2 : 1;
+	U32 argEdges = (t.mCmdDtr || (t.mCmd && t.mCmd->mDtr)) ? 2 : 1;
+	t.mClockCycles = c.mCmdBytes * 8 / cmdLines / cmdEdges + (c.mAddresses * addressBits + c.mModeBytes * 8) / argLines / argEdges +
+		c.mDummyCycles + dataBytes * 8 / dataLines / argEdges + c.mExchanges * 8;
+
+	t.mLastClock = c.mPrevEnd ? c.mPrevEnd : t.mStart;
+	if (t.mFirstClock == 0)
+		t.mFirstClock = t.mStart;
+	// Transaction cut by end of capture
+	if (t.mEnd == U64(~0) || t.mEnd < t.mLastClock)
+		t.mEnd = t.mLastClock;
+	t.mByteCount = U32(t.mData.size());
+}
+
+void SpiFlashAnalyzerResults::AddDecodedFrame(const Frame &frame)
+{
+	if (mFrameCount++ == 0)
+	{
+		mCurrent.Clear();
+		memset(&mCounts, 0, sizeof(mCounts));
+		mFirstFrame = INVALID_RESULT_INDEX;
+		// Status register reads are held back, they may end up in poll summary
+		const SpiCmdData *cmd = frame.mType == FT_CMD_BYTE ? spiFlash.GetCommandByRef(frame.mData2) : nullptr;
+		mHolding = cmd != nullptr && cmd->IsBusyPoll();
+		if (!mHolding)
+			FlushPollRun();
+	}
+
+	AccountFrame(frame);
+
+	// Command frame carries CRC-32C of read/program data in upper half of mData2
+	Frame cmdFrame(frame);
+	const Frame *f = &frame;
+	if (frame.mType == FT_CMD && !mCurrent.mData.empty())
+	{
+		const SpiCmdData *cmd = spiFlash.GetCommandByRef(frame.mData2);
+		if (cmd && (cmd->mCmdOp == OP_DATA_READ || cmd->mCmdOp == OP_DATA_WRITE))
+		{
+			cmdFrame.mData2 = (frame.mData2 & CMD_REF_MASK) |
+				U64(Crc32c(0, &mCurrent.mData[0], mCurrent.mData.size())) << 32;
+			f = &cmdFrame;
+		}
+	}
+
+	if (mHolding)
+	{
+		mHeldFrames.push_back(*f);
+		// Too long for status polling
+		if (mHeldFrames.size() > MAX_HELD_FRAMES)
+		{
+			FlushPollRun();
+			ReleaseHeldFrames();
+			mHolding = false;
+		}
+	}
+	else
+	{
+		U64 frameIndex = AddFrame(*f);
+		CommitResults();
+		if (mFirstFrame == INVALID_RESULT_INDEX)
+			mFirstFrame = frameIndex;
+		mLastFrame = frameIndex;
+	}
+}
+
+void SpiFlashAnalyzerResults::ReleaseHeldFrames()
+{
+	for (size_t i = 0; i < mHeldFrames.size(); ++i)
+	{
+		U64 frameIndex = AddFrame(mHeldFrames[i]);
+		if (mFirstFrame == INVALID_RESULT_INDEX)
+			mFirstFrame = frameIndex;
+		mLastFrame = frameIndex;
+	}
+	CommitResults();
+	mHeldFrames.clear();
+}
+
+U64 SpiFlashAnalyzerResults::CommitTransaction(U64 firstFrame, U64 lastFrame, const SpiTransaction &t)
+{
+	// One packet per transaction, packet and transaction IDs are the same
+	U64 packetId = CommitPacketAndStartNewPacket();
+	U64 transactionId = mTransactions.Add(firstFrame, lastFrame, t);
+	AddPacketToTransaction(transactionId, packetId);
+
+	return transactionId;
+}
+
+U64 SpiFlashAnalyzerResults::AddPoll(const SpiTransaction &t)
+{
+	int busy = t.mCmd->GetBusy(t.mData);
+
+	if (mPoll.mCount && mPoll.mCmdRef != t.mCmdRef)
+		FlushPollRun();
+
+	// Run starts with device busy
+	if (mPoll.mCount == 0 && busy != 1)
+	{
+		ReleaseHeldFrames();
+		return CommitTransaction(mFirstFrame, mLastFrame, t);
+	}
+
+	if (mPoll.mCount == 0)
+	{
+		mPoll.mId = mTransactions.GetCount();
+		mPoll.mCmdRef = t.mCmdRef;
+		mPoll.mBusMode = t.mBusMode;
+		mPoll.mOpcode = t.mOpcode;
+		mPoll.mStart = t.mStart;
+		mPoll.mClockCycles = 0;
+		mPoll.mClockSpan = 0;
+		mPoll.mFirstFrames.swap(mHeldFrames);
+	}
+	mHeldFrames.clear();
+	mPoll.mCount++;
+	mPoll.mEnd = t.mEnd;
+	mPoll.mValue = t.mData.size() ? t.mData.back() : 0;
+	mPoll.mClockCycles += t.mClockCycles;
+	mPoll.mClockSpan += t.mLastClock - t.mFirstClock;
+
+	U64 id = mPoll.mId;
+	// Device ready, run is complete
+	if (busy == 0)
+		FlushPollRun();
+
+	return id;
+}
+
+void SpiFlashAnalyzerResults::FlushPollRun()
+{
+	if (mPoll.mCount == 0)
+		return;
+
+	SpiTransaction summary;
+	summary.Clear();
+	summary.mOpcode = mPoll.mOpcode;
+	summary.mBusMode = mPoll.mBusMode;
+	summary.mClockCycles = U32(mPoll.mClockCycles > 0xFFFFFFFF ? 0xFFFFFFFF : mPoll.mClockCycles);
+	// Index only keeps span between first and last clock
+	summary.mFirstClock = 0;
+	summary.mLastClock = mPoll.mClockSpan;
+
+	if (mPoll.mCount == 1)
+	{
+		// Single poll stays as it was decoded
+		U64 firstFrame = INVALID_RESULT_INDEX;
+		U64 lastFrame = 0;
+		for (size_t i = 0; i < mPoll.mFirstFrames.size(); ++i)
+		{
+			lastFrame = AddFrame(mPoll.mFirstFrames[i]);
+			if (firstFrame == INVALID_RESULT_INDEX)
+				firstFrame = lastFrame;
+		}
+		CommitResults();
+		CommitTransaction(firstFrame, lastFrame, summary);
+	}
+	else
+	{
+		Frame f;
+		f.mStartingSampleInclusive = S64(mPoll.mStart);
+		f.mEndingSampleInclusive = S64(mPoll.mEnd);
+		f.mData1 = mPoll.mCount | (U64(mPoll.mValue) << 32);
+		f.mData2 = mPoll.mCmdRef;
+		f.mType = FT_POLL;
+		f.mFlags = mPoll.mBusMode;
+		U64 frameIndex = AddFrame(f);
+		CommitResults();
+		CommitTransaction(frameIndex, frameIndex, summary);
+	}
+	mPoll.mCount = 0;
+	mPoll.mFirstFrames.clear();
+}
+
+void SpiFlashAnalyzerResults::EndTransaction()
+{
+	SpiTransaction &t = mCurrent;
+
+	if (mFrameCount == 0)
+		return;
+
+	FinishTransaction(t);
+	RegisterFile &registers = mRegisters[t.mDevice];
+	SfdpTable &sfdp = mSfdp[t.mDevice];
+	// Other device answered Read JEDEC ID, registers written to previous one do not apply
+	if (mSettings->mFollowJedecId && t.mCmd && t.mCmd->IsJedecIdRead() && !t.mData.empty() &&
+		t.mData[0] != mDeviceId[t.mDevice] && spiFlash.GetCommandSetByJedecId(t.mData[0]))
+	{
+		mDeviceId[t.mDevice] = t.mData[0];
+		registers.Clear();
+		sfdp.Clear();
+	}
+	registers.Add(t);
+	sfdp.Add(t);
+	if (t.mCmd)
+		t.mWrapLength = registers.WrapLength(t.mCmd);
+	t.mPageSize = sfdp.PageSize();
+	if (mHolding)
+		t.mId = AddPoll(t);
+	else
+		t.mId = CommitTransaction(mFirstFrame, mLastFrame, t);
+
+	mCommandStats[t.mDevice].Add(t);
+	mTiming.Add(t, mSettings->mChipSelect != UNDEFINED_CHANNEL);
+	// Device models and address based reports keep state of one flash, they follow device on CS only
+	if (t.mDevice == 0)
+	{
+		AddAddressRanges(t);
+		mTimeline.Add(t);
+		mLatency.Add(t);
+		mXip.Add(t);
+		mEfficiency.Add(t);
+		mReference.Add(t);
+		mEmulator.Add(t);
+		mWear.Add(t);
+		mDigests.Add(t);
+	}
+
+	mFrameCount = 0;
+	mHolding = false;
+}
+
+void SpiFlashAnalyzerResults::Flush()
+{
+	// Transaction in progress keeps poll run, it is flushed by next transaction
+	if (mFrameCount == 0)
+		FlushPollRun();
+}
+
+void SpiFlashAnalyzerResults::AddAddressRanges(const SpiTransaction &t)
+{
+	const SpiCmdData *cmd = t.mCmd;
+
+	if (cmd == nullptr)
+		return;
+
+	U32 addressBits = (cmd->mAddressBits && cmd->mAddressBits != 0xFF) ? cmd->mAddressBits : t.mAddressBits;
+	U32 lastAddress = addressBits >= 32 ? 0xFFFFFFFF : (1U << addressBits) - 1;
+
+	if (cmd->mEraseSize == ERASE_CHIP)
+	{
+		mAddressIndex.Add(0, lastAddress, t.mId);
+	}
+	else if (!t.mHaveAddress)
+	{
+		return;
+	}
+	else if (cmd->mEraseSize)
+	{
+		// Erase always covers whole sector or block
+		U32 first = t.mAddress & ~(cmd->mEraseSize - 1);
+		mAddressIndex.Add(first, first + (cmd->mEraseSize - 1), t.mId);
+	}
+	else if ((cmd->mCmdOp == OP_DATA_READ || cmd->mCmdOp == OP_DATA_WRITE) && t.mByteCount)
+	{
+		U64 last = U64(t.mAddress) + t.mByteCount - 1;
+		mAddressIndex.Add(t.mAddress, last > 0xFFFFFFFF ? 0xFFFFFFFF : U32(last), t.mId);
+	}
+}
+
+bool SpiFlashAnalyzerResults::GetTransaction(U64 transaction_id, TransactionEntry &entry) const
+{
+	return mTransactions.Get(transaction_id, entry);
+}
+
 void SpiFlashAnalyzerResults::GeneratePacketTabularText(U64 packet_id, DisplayBase display_base)
 {
-	ClearResultStrings();
-	AddResultString("not supported");
+	// Every transaction is committed as single packet
+	GenerateTransactionTabularText(packet_id, display_base);
 }
 
 void SpiFlashAnalyzerResults::GenerateTransactionTabularText(U64 transaction_id, DisplayBase display_base)
 {
-	ClearResultStrings();
-	AddResultString("not supported");
+	TransactionEntry entry;
+
+	ClearTabularText();
+	if (!mTransactions.Get(transaction_id, entry))
+		return;
+
+	std::string s = CommandText(GetFrame(entry.GetLastFrame()), display_base);
+	// Effective clock while transaction was clocking
+	if (entry.mClockCycles > 1 && entry.mClockSpan)
+	{
+		char sck_str[32];
+		snprintf(sck_str, sizeof(sck_str), "  SCK=%.2f MHz",
+			double(entry.mClockCycles) * mAnalyzer->GetSampleRate() / entry.mClockSpan / 1e6);
+		s += sck_str;
+	}
+	if (s.size())
+		AddTabularText(s.c_str());
 }
@@ -25,6 +25,22 @@ SOFTWARE.
 #define SPIFLASH_ANALYZER_RESULTS
 
 #include <AnalyzerResults.h>
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlashAddressIndex.h"
+#include "SpiFlashParallelExport.h"
+#include "SpiFlashTimeline.h"
+#include "SpiFlashCommandStats.h"
+#include "SpiFlashLatency.h"
+#include "SpiFlashXip.h"
+#include "SpiFlashEfficiency.h"
+#include "SpiFlashReference.h"
+#include "SpiFlashEmulator.h"
+#include "SpiFlashWear.h"
+#include "SpiFlashDigest.h"
+#include "SpiFlashRegisters.h"
+#include "SpiFlashSfdp.h"
+#include "SpiFlashTiming.h"
+#include "SpiFlash.h"
 
 enum FrameType
 {
@@ -32,18 +48,79 @@ enum FrameType
 	FT_OUT_ADDR24,
 	FT_OUT_ADDR32,
 	FT_IN_BYTE,
+	// mData1 = address << 32 | byte count, mData2 = command reference | CRC-32C of read/program data << 32
+	// mFlags = command bus mode | CMD_FLAG_DTR | CMD_FLAG_ADDR4
 	FT_CMD,
 	FT_CMD_BYTE,
+	// mData2 = clock cycles
 	FT_DUMMY,
 	FT_IN_OUT,
 	FT_M,
 	FT_IN_REG,
 	FT_OUT_REG,
+	// Run of status register reads while device was busy
+	// mData1 = poll count | last value << 32, mData2 = command reference
+	FT_POLL,
+};
+
+// FT_CMD flag, command byte was sampled on both clock edges
+#define CMD_FLAG_DTR 0x10
+// FT_CMD flag, device was in 4-byte address mode
+#define CMD_FLAG_ADDR4 0x20
+
+// Kinds of frames in transaction, bits and clocks are computed when command is known
+struct TransactionFrameCounts
+{
+	U32 mCmdBytes;
+	U32 mAddresses;
+	U32 mModeBytes;
+	// Sum of clock cycles of dummy phases
+	U32 mDummyCycles;
+	U32 mExchanges;
+	U64 mPrevEnd;
+};
+
+// Consecutive reads of status register while device reports busy
+struct PollRun
+{
+	// Transaction ID that summary will get
+	U64 mId;
+	U32 mCount;
+	U32 mCmdRef;
+	U8 mOpcode;
+	U8 mBusMode;
+	U8 mValue;
+	U64 mStart;
+	U64 mEnd;
+	U64 mClockCycles;
+	U64 mClockSpan;
+	// Frames of first poll, kept as they were when run has only one poll
+	std::vector<Frame> mFirstFrames;
+};
+
+enum ExportType
+{
+	EXPORT_CSV,
+	EXPORT_PCAPNG,
+	EXPORT_ADDRESS_QUERY,
+	EXPORT_TIMELINE,
+	EXPORT_COMMAND_STATS,
+	EXPORT_LATENCY,
+	EXPORT_XIP,
+	EXPORT_EFFICIENCY,
+	EXPORT_REFERENCE,
+	EXPORT_EMULATOR,
+	EXPORT_WEAR,
+	EXPORT_WEAR_MAP,
+	EXPORT_DIGESTS,
+	EXPORT_SFDP,
+	EXPORT_TIMING,
 };
 
 class SpiFlashAnalyzer;
 class SpiFlashAnalyzerSettings;
 class RegisterData;
+class SpiCmdData;
 
 class SpiFlashAnalyzerResults : public AnalyzerResults
 {
@@ -60,11 +137,81 @@ public:
 	virtual void GeneratePacketTabularText( U64 packet_id, DisplayBase display_base );
 	virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
 
+	// Setup of analyses from settings and sample rate, called before decoding
+	void SetupAnalyses(U32 sampleRate);
+	// Frames of transaction being decoded, FT_CMD frame is last
+	void AddDecodedFrame(const Frame &frame);
+	void EndTransaction();
+	// No more data for now, put everything that was held back to results
+	void Flush();
+	bool GetTransaction(U64 transaction_id, TransactionEntry &entry) const;
+	// Register values written by transactions decoded so far
+	const RegisterFile &GetRegisters(U32 device) const { return mRegisters[device]; }
+	// Parameters from SFDP read so far
+	const SfdpTable &GetSfdp(U32 device) const { return mSfdp[device]; }
+	// Manufacturer of device that last answered Read JEDEC ID (starts from settings)
+	U8 GetDeviceId(U32 device) const { return mDeviceId[device]; }
+	// Decoder adds margins of data lines at sampling edges here
+	TimingMargins &GetTimingMargins() { return mTiming; }
+
 protected: //functions
+	// Called on export thread, frames are formatted on worker threads
+	void FetchFrames(ExportChunk &chunk, U64 first, U64 end);
+	void FormatPcapngPackets(ExportChunk &chunk, U32 sample_rate);
+	void AccountFrame(const Frame &frame);
+	void FinishTransaction(SpiTransaction &transaction);
+	U64 AddPoll(const SpiTransaction &transaction);
+	void FlushPollRun();
+	void ReleaseHeldFrames();
+	U64 CommitTransaction(U64 firstFrame, U64 lastFrame, const SpiTransaction &transaction);
+	void AddAddressRanges(const SpiTransaction &transaction);
+	void ExportCsv(const char* file, DisplayBase display_base);
+	void ExportPcapng(const char* file);
+	void ExportAddressQuery(const char* file, DisplayBase display_base);
+	void ExportTimeline(const char* file);
+	void ExportCommandStats(const char* file);
+	void ExportLatency(const char* file);
+	void ExportXip(const char* file);
+	void ExportEfficiency(const char* file);
+	void ExportReference(const char* file);
+	void ExportEmulator(const char* file);
+	void ExportWear(const char* file);
+	void ExportWearMap(const char* file);
+	void ExportDigests(const char* file);
+	void ExportSfdp(const char* file);
+	void ExportTiming(const char* file);
 
 protected:  //vars
 	SpiFlashAnalyzerSettings* mSettings;
 	SpiFlashAnalyzer* mAnalyzer;
+	TransactionIndex mTransactions;
+	AddressIndex mAddressIndex;
+	Timeline mTimeline;
+	// Gap to next transaction is measured within device, export merges devices
+	CommandStats mCommandStats[MAX_DEVICES];
+	LatencyTracker mLatency;
+	XipModel mXip;
+	DriverEfficiency mEfficiency;
+	ReferenceImage mReference;
+	FlashEmulator mEmulator;
+	WearMap mWear;
+	RangeDigests mDigests;
+	TimingMargins mTiming;
+	// State of each device on shared lines, index is from command reference
+	SfdpTable mSfdp[MAX_DEVICES];
+	// Only touched by worker thread
+	RegisterFile mRegisters[MAX_DEVICES];
+	U8 mDeviceId[MAX_DEVICES];
+	// Transaction being decoded, only touched by worker thread
+	enum { MAX_HELD_FRAMES = 1024 };
+	SpiTransaction mCurrent;
+	TransactionFrameCounts mCounts;
+	U64 mFrameCount;
+	bool mHolding;
+	std::vector<Frame> mHeldFrames;
+	U64 mFirstFrame;
+	U64 mLastFrame;
+	PollRun mPoll;
 };
 
 #endif //SPIFLASH_ANALYZER_RESULTS
@@ -24,6 +24,10 @@ SOFTWARE.
 #include "SpiFlashAnalyzerSettings.h"
 #include <AnalyzerHelpers.h>
 #include "SpiFlash.h"
+#include "SpiFlashAnalyzerResults.h"
+#include "SpiFlashDecodeCache.h"
+#include "SpiFlashXip.h"
+#include "SpiFlashReference.h"
 
 SpiFlashAnalyzerSettings::SpiFlashAnalyzerSettings() :
 	mChipSelect(UNDEFINED_CHANNEL),
@@ -32,10 +36,25 @@ SpiFlashAnalyzerSettings::SpiFlashAnalyzerSettings() :
 	mMiso(UNDEFINED_CHANNEL),
 	mD2(UNDEFINED_CHANNEL),
 	mD3(UNDEFINED_CHANNEL),
+	mD4(UNDEFINED_CHANNEL),
+	mD5(UNDEFINED_CHANNEL),
+	mD6(UNDEFINED_CHANNEL),
+	mD7(UNDEFINED_CHANNEL),
 	mManufacturer(0),
 	mAddressLength(24),
 	mSpiMode(0xFF),
-	mBusMode(1)
+	mBusMode(1),
+	mDecodeCache(0),
+	mXipCache("32/4/64/0"),
+	mCapacity(0x1000000),
+	mFollowJedecId(1),
+	mChipSelect2(UNDEFINED_CHANNEL),
+	mChipSelect3(UNDEFINED_CHANNEL),
+	mChipSelect4(UNDEFINED_CHANNEL),
+	mManufacturer2(0),
+	mManufacturer3(0),
+	mManufacturer4(0),
+	mGapPeriods(8)
 {
 	mChipSelectInterface.reset(new AnalyzerSettingInterfaceChannel());
 	mChipSelectInterface->SetTitleAndTooltip("CS", "Select Chip select line");
@@ -63,20 +82,51 @@ SpiFlashAnalyzerSettings::SpiFlashAnalyzerSettings() :
 	mD3Interface->SetSelectionOfNoneIsAllowed(true);
 	mD3Interface->SetChannel(mD3);
 
-	mManufacturerInterface.reset(new AnalyzerSettingInterfaceNumberList());
-	mManufacturerInterface->SetTitleAndTooltip("Manufacturer", "Select flash manufacturer");
-	for (size_t i = 0; i < spiFlash.getCommandSets().size(); ++i)
-		mManufacturerInterface->AddNumber(spiFlash.getCommandSets()[i]->GetId(),
-			spiFlash.getCommandSets()[i]->GetName().c_str(), "");
-
-	mManufacturerInterface->SetNumber(mManufacturer);
+	mD4Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mD4Interface->SetTitleAndTooltip("D4", "Select D4 line (octal)");
+	mD4Interface->SetSelectionOfNoneIsAllowed(true);
+	mD4Interface->SetChannel(mD4);
+
+	mD5Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mD5Interface->SetTitleAndTooltip("D5", "Select D5 line (octal)");
+	mD5Interface->SetSelectionOfNoneIsAllowed(true);
+	mD5Interface->SetChannel(mD5);
+
+	mD6Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mD6Interface->SetTitleAndTooltip("D6", "Select D6 line (octal)");
+	mD6Interface->SetSelectionOfNoneIsAllowed(true);
+	mD6Interface->SetChannel(mD6);
+
+	mD7Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mD7Interface->SetTitleAndTooltip("D7", "Select D7 line (octal)");
+	mD7Interface->SetSelectionOfNoneIsAllowed(true);
+	mD7Interface->SetChannel(mD7);
+
+	mChipSelect2Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mChipSelect2Interface->SetTitleAndTooltip("CS 2", "Chip select of second device on same clock and data lines");
+	mChipSelect2Interface->SetSelectionOfNoneIsAllowed(true);
+	mChipSelect2Interface->SetChannel(mChipSelect2);
+
+	mChipSelect3Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mChipSelect3Interface->SetTitleAndTooltip("CS 3", "Chip select of third device on same clock and data lines");
+	mChipSelect3Interface->SetSelectionOfNoneIsAllowed(true);
+	mChipSelect3Interface->SetChannel(mChipSelect3);
+
+	mChipSelect4Interface.reset(new AnalyzerSettingInterfaceChannel());
+	mChipSelect4Interface->SetTitleAndTooltip("CS 4", "Chip select of fourth device on same clock and data lines");
+	mChipSelect4Interface->SetSelectionOfNoneIsAllowed(true);
+	mChipSelect4Interface->SetChannel(mChipSelect4);
+
+	mManufacturerInterface.reset(NewManufacturerInterface("Manufacturer", mManufacturer));
+	mManufacturer2Interface.reset(NewManufacturerInterface("CS 2 manufacturer", mManufacturer2));
+	mManufacturer3Interface.reset(NewManufacturerInterface("CS 3 manufacturer", mManufacturer3));
+	mManufacturer4Interface.reset(NewManufacturerInterface("CS 4 manufacturer", mManufacturer4));
 	spiFlash.SelectCmdSet(mManufacturer);
 
 	mAddressLengthInterface.reset(new AnalyzerSettingInterfaceNumberList());
 	mAddressLengthInterface->SetTitleAndTooltip("Address", "Select address length");
 	mAddressLengthInterface->AddNumber(24, "24 bits", "");
-	// TODO: Restore 32 bits
-	//mAddressLengthInterface->AddNumber(32, "32 bits", "");
+	mAddressLengthInterface->AddNumber(32, "32 bits", "");
 	mAddressLengthInterface->SetNumber(mAddressLength);
 
 	mSpiModeInterface.reset(new AnalyzerSettingInterfaceNumberList());
@@ -91,6 +141,10 @@ SpiFlashAnalyzerSettings::SpiFlashAnalyzerSettings() :
 	mBusModeInterface->AddNumber(1, "Single", "");
 	mBusModeInterface->AddNumber(2, "Dual", "");
 	mBusModeInterface->AddNumber(4, "Quad", "");
+	mBusModeInterface->AddNumber(4 | BUS_MODE_DTR, "Quad DTR (4D-4D-4D)", "Command, address and data on both clock edges");
+	mBusModeInterface->AddNumber(8, "Octal", "");
+	mBusModeInterface->AddNumber(8 | BUS_MODE_DTR, "Octal DTR (8D-8D-8D)", "Command, address and data on both clock edges");
+	mBusModeInterface->AddNumber(0, "Auto", "Bus mode and continuous read inferred from first transactions, needs CS");
 	mBusModeInterface->SetNumber(mBusMode);
 
 	mContinuousReadInterface.reset(new AnalyzerSettingInterfaceNumberList());
@@ -112,58 +166,265 @@ SpiFlashAnalyzerSettings::SpiFlashAnalyzerSettings() :
 	}
 	mContinuousReadInterface->SetNumber(0);
 
+	mAddressQueryInterface.reset(new AnalyzerSettingInterfaceText());
+	mAddressQueryInterface->SetTitleAndTooltip("Address range",
+		"Range for 'Export transactions touching address range', e.g. 0x1000-0x1FFF or 0x1000+4096");
+	mAddressQueryInterface->SetText(mAddressQuery.c_str());
+
+	mDecodeCacheInterface.reset(new AnalyzerSettingInterfaceNumberList());
+	mDecodeCacheInterface->SetTitleAndTooltip("Decode cache",
+		"Keep decoded frames in temporary directory, same capture is not decoded again (requires CS)");
+	mDecodeCacheInterface->AddNumber(0, "Off", "");
+	mDecodeCacheInterface->AddNumber(1, "On", "");
+	mDecodeCacheInterface->SetNumber(mDecodeCache);
+
+	mXipCacheInterface.reset(new AnalyzerSettingInterfaceText());
+	mXipCacheInterface->SetTitleAndTooltip("XIP cache",
+		"Cache model for 'Export XIP fetch report': line size/ways/sets/prefetch lines, e.g. 32/4/64/1");
+	mXipCacheInterface->SetText(mXipCache.c_str());
+
+	mReferenceImageInterface.reset(new AnalyzerSettingInterfaceText());
+	mReferenceImageInterface->SetTitleAndTooltip("Reference image",
+		"Binary file expected in flash from address 0, every read is compared with it");
+	mReferenceImageInterface->SetTextType(AnalyzerSettingInterfaceText::FilePath);
+	mReferenceImageInterface->SetText(mReferenceImage.c_str());
+
+	mCapacityInterface.reset(new AnalyzerSettingInterfaceNumberList());
+	mCapacityInterface->SetTitleAndTooltip("Capacity", "Flash size used by flash model and wear map");
+	mCapacityInterface->AddNumber(0x100000, "8 Mbit", "");
+	mCapacityInterface->AddNumber(0x200000, "16 Mbit", "");
+	mCapacityInterface->AddNumber(0x400000, "32 Mbit", "");
+	mCapacityInterface->AddNumber(0x800000, "64 Mbit", "");
+	mCapacityInterface->AddNumber(0x1000000, "128 Mbit", "");
+	mCapacityInterface->AddNumber(0x2000000, "256 Mbit", "");
+	mCapacityInterface->AddNumber(0x4000000, "512 Mbit", "");
+	mCapacityInterface->AddNumber(0x8000000, "1 Gbit", "");
+	mCapacityInterface->SetNumber(mCapacity);
+
+	mFollowJedecIdInterface.reset(new AnalyzerSettingInterfaceNumberList());
+	mFollowJedecIdInterface->SetTitleAndTooltip("Follow JEDEC ID",
+		"Switch command set to manufacturer found in Read JEDEC ID (0x9F) response");
+	mFollowJedecIdInterface->AddNumber(0, "Off", "");
+	mFollowJedecIdInterface->AddNumber(1, "On", "");
+	mFollowJedecIdInterface->SetNumber(mFollowJedecId);
+
+	mGapPeriodsInterface.reset(new AnalyzerSettingInterfaceNumberList());
+	mGapPeriodsInterface->SetTitleAndTooltip("Gap without CS",
+		"When CS is not set, clock pause longer than this ends transaction");
+	mGapPeriodsInterface->AddNumber(4, "4 clock periods", "");
+	mGapPeriodsInterface->AddNumber(8, "8 clock periods", "");
+	mGapPeriodsInterface->AddNumber(16, "16 clock periods", "");
+	mGapPeriodsInterface->AddNumber(32, "32 clock periods", "");
+	mGapPeriodsInterface->AddNumber(64, "64 clock periods", "");
+	mGapPeriodsInterface->SetNumber(mGapPeriods);
+
 	AddInterface(mChipSelectInterface.get());
 	AddInterface(mClockInterface.get());
 	AddInterface(mMosiInterface.get());
 	AddInterface(mMisoInterface.get());
 	AddInterface(mD2Interface.get());
 	AddInterface(mD3Interface.get());
+	AddInterface(mD4Interface.get());
+	AddInterface(mD5Interface.get());
+	AddInterface(mD6Interface.get());
+	AddInterface(mD7Interface.get());
 	AddInterface(mManufacturerInterface.get());
 	AddInterface(mAddressLengthInterface.get());
 	AddInterface(mSpiModeInterface.get());
 	AddInterface(mBusModeInterface.get());
 	AddInterface(mContinuousReadInterface.get());
+	AddInterface(mAddressQueryInterface.get());
+	AddInterface(mDecodeCacheInterface.get());
+	AddInterface(mXipCacheInterface.get());
+	AddInterface(mReferenceImageInterface.get());
+	AddInterface(mCapacityInterface.get());
+	AddInterface(mFollowJedecIdInterface.get());
+	AddInterface(mChipSelect2Interface.get());
+	AddInterface(mManufacturer2Interface.get());
+	AddInterface(mChipSelect3Interface.get());
+	AddInterface(mManufacturer3Interface.get());
+	AddInterface(mChipSelect4Interface.get());
+	AddInterface(mManufacturer4Interface.get());
+	AddInterface(mGapPeriodsInterface.get());
 
-	AddExportOption(0, "Export as text/csv file");
-	AddExportExtension(0, "text", "txt");
-	AddExportExtension(0, "csv", "csv");
+	AddExportOption(EXPORT_CSV, "Export as text/csv file");
+	AddExportExtension(EXPORT_CSV, "text", "txt");
+	AddExportExtension(EXPORT_CSV, "csv", "csv");
 
-	ClearChannels();
+	AddExportOption(EXPORT_PCAPNG, "Export as pcapng file");
+	AddExportExtension(EXPORT_PCAPNG, "pcapng", "pcapng");
+
+	AddExportOption(EXPORT_ADDRESS_QUERY, "Export transactions touching address range");
+	AddExportExtension(EXPORT_ADDRESS_QUERY, "csv", "csv");
+
+	AddExportOption(EXPORT_TIMELINE, "Export bus utilisation timeline");
+	AddExportExtension(EXPORT_TIMELINE, "csv", "csv");
+
+	AddExportOption(EXPORT_COMMAND_STATS, "Export command statistics");
+	AddExportExtension(EXPORT_COMMAND_STATS, "csv", "csv");
+
+	AddExportOption(EXPORT_LATENCY, "Export erase/program latency");
+	AddExportExtension(EXPORT_LATENCY, "csv", "csv");
+
+	AddExportOption(EXPORT_XIP, "Export XIP fetch report");
+	AddExportExtension(EXPORT_XIP, "csv", "csv");
+
+	AddExportOption(EXPORT_EFFICIENCY, "Export driver efficiency report");
+	AddExportExtension(EXPORT_EFFICIENCY, "csv", "csv");
+
+	AddExportOption(EXPORT_REFERENCE, "Export reference image mismatches");
+	AddExportExtension(EXPORT_REFERENCE, "csv", "csv");
+
+	AddExportOption(EXPORT_EMULATOR, "Export flash model findings");
+	AddExportExtension(EXPORT_EMULATOR, "csv", "csv");
+
+	AddExportOption(EXPORT_WEAR, "Export most erased sectors and blocks");
+	AddExportExtension(EXPORT_WEAR, "csv", "csv");
+
+	AddExportOption(EXPORT_WEAR_MAP, "Export erase heat map image");
+	AddExportExtension(EXPORT_WEAR_MAP, "bmp", "bmp");
 
-	AddChannel(mChipSelect, "Chip Select", false);
-	AddChannel(mClock, "Clock", false);
-	AddChannel(mMosi, "MOSI", false);
-	AddChannel(mMiso, "MISO", false);
-	AddChannel(mD2, "D2", false);
-	AddChannel(mD3, "D3", false);
+	AddExportOption(EXPORT_DIGESTS, "Export CRC-32C/SHA-256 of contiguous reads and programs");
+	AddExportExtension(EXPORT_DIGESTS, "csv", "csv");
+
+	AddExportOption(EXPORT_SFDP, "Export SFDP parameters");
+	AddExportExtension(EXPORT_SFDP, "csv", "csv");
+
+	AddExportOption(EXPORT_TIMING, "Export setup/hold timing margins");
+	AddExportExtension(EXPORT_TIMING, "csv", "csv");
+
+	AddChannels(false);
 }
 
 SpiFlashAnalyzerSettings::~SpiFlashAnalyzerSettings()
 {
 }
 
+AnalyzerSettingInterfaceNumberList *SpiFlashAnalyzerSettings::NewManufacturerInterface(const char *title, U32 manufacturer)
+{
+	AnalyzerSettingInterfaceNumberList *manufacturerInterface = new AnalyzerSettingInterfaceNumberList();
+
+	manufacturerInterface->SetTitleAndTooltip(title, "Select flash manufacturer");
+	for (size_t i = 0; i < spiFlash.getCommandSets().size(); ++i)
+		manufacturerInterface->AddNumber(spiFlash.getCommandSets()[i]->GetId(),
+			spiFlash.getCommandSets()[i]->GetName().c_str(), "");
+	manufacturerInterface->SetNumber(manufacturer);
+
+	return manufacturerInterface;
+}
+
+void SpiFlashAnalyzerSettings::AddChannels(bool isUsed)
+{
+	ClearChannels();
+
+	AddChannel(mChipSelect, "Chip Select", isUsed);
+	AddChannel(mClock, "Clock", isUsed);
+	AddChannel(mMosi, "MOSI", isUsed);
+	AddChannel(mMiso, "MISO", isUsed);
+	AddChannel(mD2, "D2", isUsed);
+	AddChannel(mD3, "D3", isUsed);
+	AddChannel(mD4, "D4", isUsed);
+	AddChannel(mD5, "D5", isUsed);
+	AddChannel(mD6, "D6", isUsed);
+	AddChannel(mD7, "D7", isUsed);
+	AddChannel(mChipSelect2, "Chip Select 2", isUsed);
+	AddChannel(mChipSelect3, "Chip Select 3", isUsed);
+	AddChannel(mChipSelect4, "Chip Select 4", isUsed);
+}
+
+const Channel &SpiFlashAnalyzerSettings::GetChipSelect(U32 device) const
+{
+	switch (device)
+	{
+	case 0:
+		return mChipSelect;
+	case 1:
+		return mChipSelect2;
+	case 2:
+		return mChipSelect3;
+	case 3:
+		return mChipSelect4;
+	default:
+		return UNDEFINED_CHANNEL;
+	}
+}
+
+U32 SpiFlashAnalyzerSettings::GetManufacturer(U32 device) const
+{
+	switch (device)
+	{
+	case 1:
+		return mManufacturer2;
+	case 2:
+		return mManufacturer3;
+	case 3:
+		return mManufacturer4;
+	default:
+		return mManufacturer;
+	}
+}
+
 bool SpiFlashAnalyzerSettings::SetSettingsFromInterfaces()
 {
+	U32 first;
+	U32 last;
+	const char *addressQuery = mAddressQueryInterface->GetText();
+
+	if (addressQuery && *addressQuery && !AddressIndex::ParseRange(addressQuery, first, last))
+	{
+		SetErrorText("Invalid address range, use start-end or start+length");
+		return false;
+	}
+	XipCacheConfig xipCache;
+	const char *xipText = mXipCacheInterface->GetText();
+	if (!XipCacheConfig::Parse(xipText, xipCache))
+	{
+		SetErrorText("Invalid XIP cache, use line/ways/sets/prefetch with power of two line size and sets");
+		return false;
+	}
+	const char *referenceImage = mReferenceImageInterface->GetText();
+	if (referenceImage && *referenceImage && !MappedFile().Open(referenceImage))
+	{
+		SetErrorText("Reference image can't be opened");
+		return false;
+	}
+	mAddressQuery = addressQuery ? addressQuery : "";
+	Channel chipSelect = mChipSelectInterface->GetChannel();
+	if (chipSelect == UNDEFINED_CHANNEL && (mChipSelect2Interface->GetChannel() != UNDEFINED_CHANNEL ||
+		mChipSelect3Interface->GetChannel() != UNDEFINED_CHANNEL || mChipSelect4Interface->GetChannel() != UNDEFINED_CHANNEL))
+	{
+		SetErrorText("CS 2..CS 4 can only be used together with CS");
+		return false;
+	}
+	mReferenceImage = referenceImage ? referenceImage : "";
+	mXipCache = xipText;
 	mManufacturer = U32(mManufacturerInterface->GetNumber());
 	mAddressLength = U32(mAddressLengthInterface->GetNumber());
 	mSpiMode = U32(mSpiModeInterface->GetNumber());
 	mBusMode = U32(mBusModeInterface->GetNumber());
 	mContinuousRead = U32(mContinuousReadInterface->GetNumber());
-	mChipSelect = mChipSelectInterface->GetChannel();
+	mDecodeCache = U32(mDecodeCacheInterface->GetNumber());
+	mCapacity = U32(mCapacityInterface->GetNumber());
+	mFollowJedecId = U32(mFollowJedecIdInterface->GetNumber());
+	mManufacturer2 = U32(mManufacturer2Interface->GetNumber());
+	mManufacturer3 = U32(mManufacturer3Interface->GetNumber());
+	mManufacturer4 = U32(mManufacturer4Interface->GetNumber());
+	mGapPeriods = U32(mGapPeriodsInterface->GetNumber());
+	mChipSelect = chipSelect;
 	mClock = mClockInterface->GetChannel();
 	mMosi = mMosiInterface->GetChannel();
 	mMiso = mMisoInterface->GetChannel();
 	mD2 = mD2Interface->GetChannel();
 	mD3 = mD3Interface->GetChannel();
+	mD4 = mD4Interface->GetChannel();
+	mD5 = mD5Interface->GetChannel();
+	mD6 = mD6Interface->GetChannel();
+	mD7 = mD7Interface->GetChannel();
+	mChipSelect2 = mChipSelect2Interface->GetChannel();
+	mChipSelect3 = mChipSelect3Interface->GetChannel();
+	mChipSelect4 = mChipSelect4Interface->GetChannel();
 
-	ClearChannels();
-
-	AddChannel(mChipSelect, "Chip Select", true);
-	AddChannel(mClock, "Clock", true);
-	AddChannel(mMosi, "MOSI", true);
-	AddChannel(mMiso, "MISO", true);
-	AddChannel(mD2, "D2", true);
-	AddChannel(mD3, "D3", true);
+	AddChannels(true);
 
 	spiFlash.SelectCmdSet(mManufacturer);
 
@@ -177,12 +438,29 @@ void SpiFlashAnalyzerSettings::UpdateInterfacesFromSettings()
 	mSpiModeInterface->SetNumber(mSpiMode);
 	mBusModeInterface->SetNumber(mBusMode);
 	mContinuousReadInterface->SetNumber(mContinuousRead);
+	mAddressQueryInterface->SetText(mAddressQuery.c_str());
+	mDecodeCacheInterface->SetNumber(mDecodeCache);
+	mXipCacheInterface->SetText(mXipCache.c_str());
+	mReferenceImageInterface->SetText(mReferenceImage.c_str());
+	mCapacityInterface->SetNumber(mCapacity);
+	mFollowJedecIdInterface->SetNumber(mFollowJedecId);
+	mManufacturer2Interface->SetNumber(mManufacturer2);
+	mManufacturer3Interface->SetNumber(mManufacturer3);
+	mManufacturer4Interface->SetNumber(mManufacturer4);
+	mGapPeriodsInterface->SetNumber(mGapPeriods);
 	mChipSelectInterface->SetChannel(mChipSelect);
 	mClockInterface->SetChannel(mClock);
 	mMosiInterface->SetChannel(mMosi);
 	mMisoInterface->SetChannel(mMiso);
 	mD2Interface->SetChannel(mD2);
 	mD3Interface->SetChannel(mD3);
+	mD4Interface->SetChannel(mD4);
+	mD5Interface->SetChannel(mD5);
+	mD6Interface->SetChannel(mD6);
+	mD7Interface->SetChannel(mD7);
+	mChipSelect2Interface->SetChannel(mChipSelect2);
+	mChipSelect3Interface->SetChannel(mChipSelect3);
+	mChipSelect4Interface->SetChannel(mChipSelect4);
 }
 
 void SpiFlashAnalyzerSettings::LoadSettings(const char* settings)
@@ -201,14 +479,31 @@ void SpiFlashAnalyzerSettings::LoadSettings(const char* settings)
 	text_archive >> mMiso;
 	text_archive >> mD2;
 	text_archive >> mD3;
-
-	ClearChannels();
-	AddChannel(mChipSelect, "Chip Select", true);
-	AddChannel(mClock, "Clock", true);
-	AddChannel(mMosi, "MOSI", true);
-	AddChannel(mMiso, "MISO", true);
-	AddChannel(mD2, "D2", true);
-	AddChannel(mD3, "D3", true);
+	const char *addressQuery;
+	if (text_archive >> &addressQuery)
+		mAddressQuery = addressQuery;
+	text_archive >> mDecodeCache;
+	const char *xipCache;
+	if (text_archive >> &xipCache)
+		mXipCache = xipCache;
+	const char *referenceImage;
+	if (text_archive >> &referenceImage)
+		mReferenceImage = referenceImage;
+	text_archive >> mCapacity;
+	text_archive >> mD4;
+	text_archive >> mD5;
+	text_archive >> mD6;
+	text_archive >> mD7;
+	text_archive >> mFollowJedecId;
+	text_archive >> mChipSelect2;
+	text_archive >> mChipSelect3;
+	text_archive >> mChipSelect4;
+	text_archive >> mManufacturer2;
+	text_archive >> mManufacturer3;
+	text_archive >> mManufacturer4;
+	text_archive >> mGapPeriods;
+
+	AddChannels(true);
 
 	UpdateInterfacesFromSettings();
 }
@@ -228,6 +523,55 @@ const char* SpiFlashAnalyzerSettings::SaveSettings()
 	text_archive << mMiso;
 	text_archive << mD2;
 	text_archive << mD3;
+	text_archive << mAddressQuery.c_str();
+	text_archive << mDecodeCache;
+	text_archive << mXipCache.c_str();
+	text_archive << mReferenceImage.c_str();
+	text_archive << mCapacity;
+	text_archive << mD4;
+	text_archive << mD5;
+	text_archive << mD6;
+	text_archive << mD7;
+	text_archive << mFollowJedecId;
+	text_archive << mChipSelect2;
+	text_archive << mChipSelect3;
+	text_archive << mChipSelect4;
+	text_archive << mManufacturer2;
+	text_archive << mManufacturer3;
+	text_archive << mManufacturer4;
+	text_archive << mGapPeriods;
 
 	return SetReturnString(text_archive.GetString());
 }
+
+
+std::string SpiFlashAnalyzerSettings::GetDecodeKey(U32 sampleRate) const
+{
+	char key[512];
+	U64 tables = 0;
+
+	// Frames store command references, any change in tables invalidates cache
+	for (size_t i = 0; i < spiFlash.getCommandSets().size(); ++i)
+	{
+		const CmdSet *cmdSet = spiFlash.getCommandSets()[i];
+		const SpiCmdData *cmd;
+		const RegisterData *reg;
+		for (size_t j = 0; (reg = cmdSet->GetRegisterByIndex(j)) != nullptr; ++j)
+			tables = Fnv1a(reg->GetName().data(), reg->GetName().size(), tables);
+		for (size_t j = 0; (cmd = cmdSet->GetCommandByIndex(j)) != nullptr; ++j)
+		{
+			U8 d[] = { U8(cmdSet->GetId()), cmd->GetCode(), U8(cmd->mCmdOp), cmd->mAddressBits, U8(cmd->mMode),
+				cmd->mModeArgs, cmd->mModeData, cmd->mModeChange, U8(cmd->mDummyBytes), U8(cmd->mDummyCycles),
+				cmd->mDummyCount, U8(cmd->mContinuousRead), U8(cmd->mDtr) };
+			tables = Fnv1a(d, sizeof(d), tables);
+		}
+	}
+	snprintf(key, sizeof(key), "%d %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %016llx",
+		DECODE_CACHE_VERSION, sampleRate, mManufacturer, mFollowJedecId, mAddressLength, mSpiMode, mBusMode,
+		mContinuousRead, mChipSelect.mChannelIndex, mClock.mChannelIndex, mMosi.mChannelIndex, mMiso.mChannelIndex,
+		mD2.mChannelIndex, mD3.mChannelIndex, mD4.mChannelIndex, mD5.mChannelIndex, mD6.mChannelIndex,
+		mD7.mChannelIndex, mChipSelect2.mChannelIndex, mChipSelect3.mChannelIndex, mChipSelect4.mChannelIndex,
+		mManufacturer2, mManufacturer3, mManufacturer4, (unsigned long long)tables);
+
+	return key;
+}
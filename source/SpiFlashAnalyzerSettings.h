@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
+#include <string>
 
 class SpiFlashAnalyzerSettings : public AnalyzerSettings
 {
@@ -37,6 +38,11 @@ public:
 	void UpdateInterfacesFromSettings();
 	virtual void LoadSettings( const char* settings );
 	virtual const char* SaveSettings();
+	// Everything that affects decoded frames, used as decode cache key
+	std::string GetDecodeKey(U32 sampleRate) const;
+	// Device on shared lines: 0 is CS, 1..3 are CS 2..CS 4, UNDEFINED_CHANNEL when not used
+	const Channel &GetChipSelect(U32 device) const;
+	U32 GetManufacturer(U32 device) const;
 
 
 	Channel mChipSelect;
@@ -45,11 +51,31 @@ public:
 	Channel mMiso;
 	Channel mD2;
 	Channel mD3;
+	Channel mD4;
+	Channel mD5;
+	Channel mD6;
+	Channel mD7;
 	U32 mManufacturer;
 	U32 mAddressLength;
 	U32 mSpiMode;
 	U32 mBusMode;
 	U32 mContinuousRead;
+	std::string mAddressQuery;
+	U32 mDecodeCache;
+	std::string mXipCache;
+	std::string mReferenceImage;
+	U32 mCapacity;
+	// Command set follows manufacturer ID of 0x9F responses
+	U32 mFollowJedecId;
+	// More devices sharing clock and data lines
+	Channel mChipSelect2;
+	Channel mChipSelect3;
+	Channel mChipSelect4;
+	U32 mManufacturer2;
+	U32 mManufacturer3;
+	U32 mManufacturer4;
+	// Without CS clock pause longer than this many clock periods ends transaction
+	U32 mGapPeriods;
 
 protected:
 	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mManufacturerInterface;
@@ -57,6 +83,16 @@ protected:
 	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mSpiModeInterface;
 	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mBusModeInterface;
 	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mContinuousReadInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceText> mAddressQueryInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mDecodeCacheInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceText> mXipCacheInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceText> mReferenceImageInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mCapacityInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mFollowJedecIdInterface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mManufacturer2Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mManufacturer3Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mManufacturer4Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceNumberList> mGapPeriodsInterface;
 
 	std::auto_ptr<AnalyzerSettingInterfaceChannel> mChipSelectInterface;
 	std::auto_ptr<AnalyzerSettingInterfaceChannel> mClockInterface;
@@ -64,6 +100,16 @@ protected:
 	std::auto_ptr<AnalyzerSettingInterfaceChannel> mMisoInterface;
 	std::auto_ptr<AnalyzerSettingInterfaceChannel> mD2Interface;
 	std::auto_ptr<AnalyzerSettingInterfaceChannel> mD3Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mD4Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mD5Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mD6Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mD7Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mChipSelect2Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mChipSelect3Interface;
+	std::auto_ptr<AnalyzerSettingInterfaceChannel> mChipSelect4Interface;
+
+	AnalyzerSettingInterfaceNumberList *NewManufacturerInterface(const char *title, U32 manufacturer);
+	void AddChannels(bool isUsed);
 };
 
 #endif //SPIFLASH_ANALYZER_SETTINGS
@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_CHANNEL_READER_H
+#define SPIFLASH_CHANNEL_READER_H
+
+#include <vector>
+
+#include <AnalyzerChannelData.h>
+
+// Channel data as seen by decoder. Calls go to Logic channel data, except that
+// edges recorded at start of capture can be read again after Rewind(), recorded
+// part is followed by live data as if nothing happened. Edges looked at ahead by
+// PeekEdge() are read the same way.
+class ChannelReader
+{
+	enum { PEEK_BLOCK = 256 };
+
+	AnalyzerChannelData *mData;
+	std::vector<U64> mEdges;
+	U64 mStart;
+	// Channel data is at this sample when recording ends
+	U64 mEnd;
+	BitState mStartState;
+	// Reading recorded edges
+	bool mReplay;
+	// Recorded edges only, live data is not touched
+	bool mRecordedOnly;
+	size_t mIx;
+	U64 mPos;
+
+	void GoLive()
+	{
+		mReplay = false;
+		mEdges.clear();
+	}
+public:
+	ChannelReader() : mData(nullptr), mStart(0), mEnd(0), mStartState(BIT_LOW), mReplay(false), mRecordedOnly(false),
+		mIx(0), mPos(0) {}
+
+	void Attach(AnalyzerChannelData *data)
+	{
+		mData = data;
+		GoLive();
+	}
+
+	void StartRecording()
+	{
+		GoLive();
+		mStart = mData->GetSampleNumber();
+		mStartState = mData->GetBitState();
+	}
+	// Records next edge if there is one in data captured so far
+	bool RecordNextEdge()
+	{
+		if (!mData->DoMoreTransitionsExistInCurrentData())
+			return false;
+		mData->AdvanceToNextEdge();
+		mEdges.push_back(mData->GetSampleNumber());
+		return true;
+	}
+	void RecordTo(U64 end)
+	{
+		while (mData->WouldAdvancingToAbsPositionCauseTransition(end))
+		{
+			mData->AdvanceToNextEdge();
+			mEdges.push_back(mData->GetSampleNumber());
+		}
+		if (end > mData->GetSampleNumber())
+			mData->AdvanceToAbsPosition(end);
+		mEnd = mData->GetSampleNumber();
+	}
+	// Sample of edge that follows current position after 'ahead' other edges. Edges are
+	// read ahead from channel data in blocks and kept for reading, without wait false
+	// is returned when edge is not in data captured so far.
+	bool PeekEdge(size_t ahead, U64 &sample, bool wait)
+	{
+		if (!mReplay)
+		{
+			mStart = mPos = mData->GetSampleNumber();
+			mEnd = mStart;
+			mStartState = mData->GetBitState();
+			mReplay = true;
+			mRecordedOnly = false;
+			mIx = 0;
+		}
+		else if (mIx >= PEEK_BLOCK && !mRecordedOnly)
+		{
+			// Drop edges already read, bit state follows edge count
+			if (mIx & 1)
+				mStartState = mStartState == BIT_LOW ? BIT_HIGH : BIT_LOW;
+			mEdges.erase(mEdges.begin(), mEdges.begin() + mIx);
+			mIx = 0;
+		}
+		while (mIx + ahead >= mEdges.size())
+		{
+			if (mRecordedOnly || (!wait && !mData->DoMoreTransitionsExistInCurrentData()))
+				return false;
+			mData->AdvanceToNextEdge();
+			mEdges.push_back(mData->GetSampleNumber());
+			for (size_t i = 1; i < PEEK_BLOCK && mData->DoMoreTransitionsExistInCurrentData(); ++i)
+			{
+				mData->AdvanceToNextEdge();
+				mEdges.push_back(mData->GetSampleNumber());
+			}
+			mEnd = mData->GetSampleNumber();
+		}
+		sample = mEdges[mIx + ahead];
+		return true;
+	}
+	// Back to start of recording, recordedOnly keeps reads within recorded samples
+	void Rewind(bool recordedOnly)
+	{
+		mReplay = true;
+		mRecordedOnly = recordedOnly;
+		mIx = 0;
+		mPos = mStart;
+	}
+
+	U64 GetSampleNumber()
+	{
+		return mReplay ? mPos : mData->GetSampleNumber();
+	}
+	BitState GetBitState()
+	{
+		if (!mReplay)
+			return mData->GetBitState();
+		return (mIx & 1) ? (mStartState == BIT_LOW ? BIT_HIGH : BIT_LOW) : mStartState;
+	}
+	U64 GetSampleOfNextEdge()
+	{
+		if (mReplay && mIx < mEdges.size())
+			return mEdges[mIx];
+		if (mReplay && mRecordedOnly)
+			return U64(~0);
+		return mData->GetSampleOfNextEdge();
+	}
+	bool DoMoreTransitionsExistInCurrentData()
+	{
+		if (mReplay && (mIx < mEdges.size() || mRecordedOnly))
+			return mIx < mEdges.size();
+		return mData->DoMoreTransitionsExistInCurrentData();
+	}
+	bool WouldAdvancingToAbsPositionCauseTransition(U64 sample)
+	{
+		if (mReplay && (mIx < mEdges.size() || mRecordedOnly))
+			return mIx < mEdges.size() && mEdges[mIx] <= sample;
+		return mData->WouldAdvancingToAbsPositionCauseTransition(sample);
+	}
+	void AdvanceToNextEdge()
+	{
+		if (mReplay && mIx < mEdges.size())
+			mPos = mEdges[mIx++];
+		else if (mReplay && mRecordedOnly)
+			mPos = mEnd;
+		else
+		{
+			if (mReplay)
+				GoLive();
+			mData->AdvanceToNextEdge();
+		}
+	}
+	void AdvanceToAbsPosition(U64 sample)
+	{
+		if (mReplay && (sample <= mEnd || mRecordedOnly))
+		{
+			while (mIx < mEdges.size() && mEdges[mIx] <= sample)
+				mIx++;
+			if (sample > mPos)
+				mPos = sample;
+		}
+		else
+		{
+			if (mReplay)
+				GoLive();
+			mData->AdvanceToAbsPosition(sample);
+		}
+	}
+};
+
+#endif //SPIFLASH_CHANNEL_READER_H
@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SpiFlashClockRecovery.h"
+
+void ClockRecovery::Reset(U32 gapPeriods)
+{
+	mHalfPeriods.Clear();
+	mHalfPeriod = 0;
+	mLocalHalfPeriod = 0;
+	mNextUpdate = MIN_HALF_PERIODS;
+	mGapPeriods = gapPeriods ? gapPeriods : 1;
+}
+
+U64 ClockRecovery::GapLimit(U64 localHalfPeriod) const
+{
+	// Slower clock of current transaction must not look like gaps
+	U64 half = mHalfPeriod > localHalfPeriod ? mHalfPeriod : localHalfPeriod;
+
+	if (half == 0)
+		return U64(~0);
+	return 2 * mGapPeriods * half;
+}
+
+void ClockRecovery::UpdateHalfPeriod()
+{
+	// Median is robust to pauses between bytes, refreshed as histogram grows
+	if (mHalfPeriods.GetCount() >= mNextUpdate)
+	{
+		U64 count = mHalfPeriods.GetCount();
+		mHalfPeriod = mHalfPeriods.GetPercentile(50);
+		mNextUpdate = count + (count < 65536 ? count : 65536);
+	}
+}
+
+bool ClockRecovery::Next(ChannelReader &clock, bool skipCurrent, U64 &first, U64 &last)
+{
+	U64 edge;
+	U64 limit = GapLimit(mLocalHalfPeriod);
+
+	if (skipCurrent)
+	{
+		U64 prev = clock.GetSampleNumber();
+		while (clock.PeekEdge(0, edge, true) && edge - prev <= limit)
+		{
+			clock.AdvanceToNextEdge();
+			prev = edge;
+		}
+	}
+
+	clock.PeekEdge(0, first, true);
+	last = first;
+	mLocalHalfPeriod = 0;
+	limit = GapLimit(0);
+	for (size_t i = 1; clock.PeekEdge(i, edge, false); ++i)
+	{
+		U64 half = edge - last;
+		if (half > limit)
+		{
+			UpdateHalfPeriod();
+			return true;
+		}
+		// First half period tells speed of this transaction
+		if (i == 1)
+		{
+			mLocalHalfPeriod = half;
+			limit = GapLimit(half);
+		}
+		mHalfPeriods.Add(half);
+		last = edge;
+	}
+	UpdateHalfPeriod();
+	return false;
+}
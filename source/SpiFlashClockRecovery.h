@@ -0,0 +1,58 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_CLOCK_RECOVERY_H
+#define SPIFLASH_CLOCK_RECOVERY_H
+
+#include "SpiFlashHistogram.h"
+#include "SpiFlashChannelReader.h"
+
+// Finds transactions on clock line when there is no CS. Clock period comes from
+// histogram of half periods seen so far, clock pause longer than gap periods ends
+// transaction.
+class ClockRecovery
+{
+	Histogram mHalfPeriods;
+	U64 mHalfPeriod;
+	// First half period of last transaction
+	U64 mLocalHalfPeriod;
+	U64 mNextUpdate;
+	U32 mGapPeriods;
+
+	U64 GapLimit(U64 localHalfPeriod) const;
+	void UpdateHalfPeriod();
+public:
+	enum { MIN_HALF_PERIODS = 16 };
+
+	ClockRecovery() { Reset(8); }
+
+	void Reset(U32 gapPeriods);
+	// Clock edges of next transaction, clock is left before first edge. Waits for
+	// transaction start, false when its end is not in data captured so far. With
+	// skipCurrent rest of transaction cut by end of data earlier is skipped first.
+	bool Next(ChannelReader &clock, bool skipCurrent, U64 &first, U64 &last);
+	// Estimated half period, 0 while unknown
+	U64 GetHalfPeriod() const { return mHalfPeriod; }
+};
+
+#endif //SPIFLASH_CLOCK_RECOVERY_H
@@ -0,0 +1,100 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include "SpiFlashCommandStats.h"
+#include "SpiFlashTransactionIndex.h"
+
+void CommandStatsEntry::Merge(const CommandStatsEntry &other)
+{
+	mBytes += other.mBytes;
+	mDuration.Merge(other.mDuration);
+	mClocks.Merge(other.mClocks);
+	mGapToNext.Merge(other.mGapToNext);
+}
+
+CommandStatsEntry &CommandStats::GetEntry(U32 cmdRef)
+{
+	Entries::iterator i = mEntries.find(cmdRef);
+
+	if (i == mEntries.end())
+	{
+		i = mEntries.insert(std::make_pair(cmdRef, CommandStatsEntry())).first;
+		i->second.mCmdRef = cmdRef;
+		i->second.mBytes = 0;
+	}
+	return i->second;
+}
+
+void CommandStats::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mEntries.clear();
+	mPrevRef = 0;
+	mPrevEnd = 0;
+}
+
+void CommandStats::Add(const SpiTransaction &t)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (mPrevRef && t.mStart >= mPrevEnd)
+		GetEntry(mPrevRef).mGapToNext.Add(t.mStart - mPrevEnd);
+
+	CommandStatsEntry &entry = GetEntry(t.mCmdRef);
+	entry.mBytes += t.mByteCount;
+	entry.mDuration.Add(t.mEnd - t.mStart);
+	entry.mClocks.Add(t.mClockCycles);
+
+	mPrevRef = t.mCmdRef;
+	mPrevEnd = t.mEnd;
+}
+
+void CommandStats::Merge(const CommandStats &other)
+{
+	if (&other == this)
+		return;
+
+	std::lock(mLock, other.mLock);
+	std::lock_guard<std::mutex> lock1(mLock, std::adopt_lock);
+	std::lock_guard<std::mutex> lock2(other.mLock, std::adopt_lock);
+
+	for (Entries::const_iterator i = other.mEntries.begin(); i != other.mEntries.end(); ++i)
+		GetEntry(i->first).Merge(i->second);
+}
+
+static bool LongerTotal(const CommandStatsEntry &a, const CommandStatsEntry &b)
+{
+	return a.mDuration.GetSum() > b.mDuration.GetSum();
+}
+
+void CommandStats::GetEntries(std::vector<CommandStatsEntry> &entries) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	entries.clear();
+	for (Entries::const_iterator i = mEntries.begin(); i != mEntries.end(); ++i)
+		entries.push_back(i->second);
+	std::sort(entries.begin(), entries.end(), LongerTotal);
+}
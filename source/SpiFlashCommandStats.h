@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_COMMAND_STATS_H
+#define SPIFLASH_COMMAND_STATS_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+
+#include "SpiFlashHistogram.h"
+
+struct SpiTransaction;
+
+struct CommandStatsEntry
+{
+	// Command reference, unknown opcodes have their own entries
+	U32 mCmdRef;
+	U64 mBytes;
+	// CS active time in samples, count of this is number of transactions
+	Histogram mDuration;
+	Histogram mClocks;
+	// From CS inactive to CS active of next transaction, in samples
+	Histogram mGapToNext;
+
+	void Merge(const CommandStatsEntry &other);
+};
+
+// Per command statistics collected while decoding
+class CommandStats
+{
+	typedef std::map<U32, CommandStatsEntry> Entries;
+	Entries mEntries;
+	// Previous transaction waits for gap to next one
+	U32 mPrevRef;
+	U64 mPrevEnd;
+	mutable std::mutex mLock;
+
+	CommandStatsEntry &GetEntry(U32 cmdRef);
+public:
+	CommandStats() : mPrevRef(0), mPrevEnd(0) {}
+
+	void Clear();
+	void Add(const SpiTransaction &transaction);
+	// Combine statistics of other capture or capture segment
+	void Merge(const CommandStats &other);
+	// Entries sorted by total CS active time, biggest first
+	void GetEntries(std::vector<CommandStatsEntry> &entries) const;
+};
+
+#endif //SPIFLASH_COMMAND_STATS_H
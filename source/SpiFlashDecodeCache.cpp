@@ -0,0 +1,393 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "SpiFlashDecodeCache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+static const char cacheMagic[8] = { 'S', 'F', 'D', 'C', 'A', 'C', 'H', '1' };
+
+#define FRAME_RECORD_SIZE 34
+#define STATE_SIZE 18
+#define HEADER_SIZE 58
+// Records after prefix start with tag
+#define TAG_TRANSACTION 'T'
+#define TAG_FRAME 'F'
+#define TRANSACTION_RECORD_SIZE (1 + 8 + STATE_SIZE)
+// Cache files kept in temporary directory
+#define MAX_CACHE_FILES 16
+#define MAX_CACHE_SIZE (U64(1) << 30)
+
+struct CacheFile
+{
+	U64 mTime;
+	U64 mSize;
+	std::string mName;
+};
+
+static bool NewerFile(const CacheFile &a, const CacheFile &b)
+{
+	return a.mTime > b.mTime;
+}
+
+static void Put(std::vector<U8> &buf, U64 v, int bytes)
+{
+	for (int i = 0; i < bytes; ++i, v >>= 8)
+		buf.push_back(U8(v));
+}
+
+static U64 Get(const U8 *p, int bytes)
+{
+	U64 v = 0;
+
+	for (int i = bytes - 1; i >= 0; --i)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static void PutState(std::vector<U8> &buf, const DecodeCacheState &state)
+{
+	Put(buf, state.mResumeSample, 8);
+	Put(buf, state.mLockedCmdRef, 4);
+	Put(buf, state.mDefaultBusMode, 1);
+	Put(buf, state.mClockIdleState, 1);
+	Put(buf, state.mAddressLength, 1);
+	Put(buf, state.mExtendedAddress, 1);
+	Put(buf, state.mCmdSetId, 1);
+	Put(buf, state.mCmdSetConfirmed, 1);
+}
+
+static void GetState(const U8 *p, DecodeCacheState &state)
+{
+	state.mResumeSample = Get(p, 8);
+	state.mLockedCmdRef = U32(Get(p + 8, 4));
+	state.mDefaultBusMode = p[12];
+	state.mClockIdleState = p[13];
+	state.mAddressLength = p[14];
+	state.mExtendedAddress = p[15];
+	state.mCmdSetId = p[16];
+	state.mCmdSetConfirmed = p[17];
+}
+
+DecodeCache::DecodeCache() : mState(DC_IDLE), mPrefixFrames(0), mPendingFrames(0), mPendingTransactions(0),
+	mTransactions(0), mFrames(0), mBodyTransactions(0), mBodyFrames(0)
+{
+}
+
+DecodeCache::~DecodeCache()
+{
+	Close();
+}
+
+std::string DecodeCache::GetCacheDir()
+{
+	const char *vars[] = { "TMPDIR", "TEMP", "TMP" };
+
+	for (size_t i = 0; i < sizeof(vars) / sizeof(vars[0]); ++i)
+	{
+		const char *dir = getenv(vars[i]);
+		if (dir && *dir)
+			return dir;
+	}
+#ifdef _WIN32
+	return ".";
+#else
+	return "/tmp";
+#endif
+}
+
+void DecodeCache::LimitCacheFiles()
+{
+	std::string dir = GetCacheDir();
+	std::vector<CacheFile> files;
+	CacheFile f;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((dir + "/spiflash-*.cache").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		f.mTime = (U64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+		f.mSize = (U64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		f.mName = dir + "/" + data.cFileName;
+		files.push_back(f);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR *d = opendir(dir.c_str());
+	if (d == nullptr)
+		return;
+	while (struct dirent *entry = readdir(d))
+	{
+		struct stat st;
+		size_t len = strlen(entry->d_name);
+
+		if (strncmp(entry->d_name, "spiflash-", 9) != 0 || len < 15 || strcmp(entry->d_name + len - 6, ".cache") != 0)
+			continue;
+		f.mName = dir + "/" + entry->d_name;
+		if (stat(f.mName.c_str(), &st) != 0)
+			continue;
+		f.mTime = U64(st.st_mtime);
+		f.mSize = U64(st.st_size);
+		files.push_back(f);
+	}
+	closedir(d);
+#endif
+
+	// Newest first, file just written is newest even when times are equal
+	for (size_t i = 0; i < files.size(); ++i)
+		if (files[i].mName == mFileName)
+			files[i].mTime = ~0ULL;
+	std::sort(files.begin(), files.end(), NewerFile);
+
+	U64 total = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		total += files[i].mSize;
+		if (i > 0 && (i >= MAX_CACHE_FILES || total > MAX_CACHE_SIZE))
+			remove(files[i].mName.c_str());
+	}
+}
+
+void DecodeCache::Begin(const std::string &key)
+{
+	Close();
+	mKey = key;
+	mState = DC_PROBE;
+}
+
+void DecodeCache::Close()
+{
+	if (mFile.is_open())
+		mFile.close();
+
+	// Unfinished cache file is useless
+	if (mState == DC_WRITE)
+		remove((mFileName + ".tmp").c_str());
+
+	mState = DC_IDLE;
+	mPrefix.clear();
+	mPending.clear();
+	mPrefixFrames = 0;
+	mPendingFrames = 0;
+	mPendingTransactions = 0;
+	mTransactions = 0;
+	mFrames = 0;
+	mBodyTransactions = 0;
+	mBodyFrames = 0;
+}
+
+void DecodeCache::StartTransaction(U64 edgeHash, const DecodeCacheState &state)
+{
+	if (mState != DC_WRITE)
+		return;
+
+	Put(mPending, TAG_TRANSACTION, 1);
+	Put(mPending, edgeHash, 8);
+	PutState(mPending, state);
+	mPendingTransactions++;
+}
+
+void DecodeCache::AddFrame(const Frame &frame)
+{
+	if (mState != DC_PROBE && mState != DC_WRITE)
+		return;
+
+	// Prefix is compared as it is, without tags
+	if (mState == DC_WRITE)
+		Put(mPending, TAG_FRAME, 1);
+	Put(mPending, U64(frame.mStartingSampleInclusive), 8);
+	Put(mPending, U64(frame.mEndingSampleInclusive), 8);
+	Put(mPending, frame.mData1, 8);
+	Put(mPending, frame.mData2, 8);
+	Put(mPending, frame.mType, 1);
+	Put(mPending, frame.mFlags, 1);
+	mPendingFrames++;
+}
+
+void DecodeCache::CommitTransaction()
+{
+	if (mState == DC_PROBE)
+	{
+		mPrefix.insert(mPrefix.end(), mPending.begin(), mPending.end());
+		mPrefixFrames += mPendingFrames;
+	}
+	else if (mState == DC_WRITE)
+	{
+		mFile.write(reinterpret_cast<const char *>(mPending.data()), mPending.size());
+		mBodyTransactions += mPendingTransactions;
+		mBodyFrames += mPendingFrames;
+	}
+	else
+	{
+		return;
+	}
+	mFrames += mPendingFrames;
+	mTransactions++;
+	mPending.clear();
+	mPendingFrames = 0;
+	mPendingTransactions = 0;
+}
+
+void DecodeCache::WriteHeader(bool complete, const DecodeCacheState &state)
+{
+	std::vector<U8> header(cacheMagic, cacheMagic + sizeof(cacheMagic));
+
+	Put(header, DECODE_CACHE_VERSION, 4);
+	Put(header, complete ? 1 : 0, 4);
+	Put(header, mPrefixFrames, 8);
+	Put(header, mBodyTransactions, 8);
+	Put(header, mBodyFrames, 8);
+	PutState(header, state);
+	mFile.seekp(0);
+	mFile.write(reinterpret_cast<const char *>(header.data()), header.size());
+}
+
+bool DecodeCache::Lookup(DecodeCacheState &state)
+{
+	char name[40];
+
+	if (mState != DC_PROBE)
+		return false;
+
+	U64 hash = Fnv1a(mKey.data(), mKey.size());
+	hash = Fnv1a(mPrefix.data(), mPrefix.size(), hash);
+	snprintf(name, sizeof(name), "/spiflash-%016llx.cache", (unsigned long long)hash);
+	mFileName = GetCacheDir() + name;
+
+	mFile.open(mFileName.c_str(), std::ios::in | std::ios::binary);
+	if (mFile.is_open())
+	{
+		U8 header[HEADER_SIZE];
+		std::vector<U8> prefix(mPrefix.size());
+
+		mFile.read(reinterpret_cast<char *>(header), HEADER_SIZE);
+		if (prefix.size())
+			mFile.read(reinterpret_cast<char *>(&prefix[0]), prefix.size());
+
+		// Same key and same decoded prefix, file is not cut
+		U64 size = HEADER_SIZE + mPrefix.size() + Get(header + 24, 8) * TRANSACTION_RECORD_SIZE +
+			Get(header + 32, 8) * (1 + FRAME_RECORD_SIZE);
+		mFile.seekg(0, std::ios::end);
+		if (mFile.good() && memcmp(header, cacheMagic, sizeof(cacheMagic)) == 0 &&
+			Get(header + 8, 4) == DECODE_CACHE_VERSION && Get(header + 12, 4) == 1 &&
+			Get(header + 16, 8) == mPrefixFrames && prefix == mPrefix && U64(mFile.tellg()) == size)
+		{
+			GetState(header + 40, state);
+			mFile.seekg(HEADER_SIZE + mPrefix.size());
+			mPrefix.clear();
+			mState = DC_READ;
+			return true;
+		}
+		mFile.close();
+	}
+
+	// Not in cache, start writing new file
+	mFile.clear();
+	mFile.open((mFileName + ".tmp").c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!mFile.is_open())
+	{
+		Close();
+		return false;
+	}
+	DecodeCacheState empty = DecodeCacheState();
+	WriteHeader(false, empty);
+	mFile.write(reinterpret_cast<const char *>(mPrefix.data()), mPrefix.size());
+	mPrefix.clear();
+	mBodyTransactions = 0;
+	mBodyFrames = 0;
+	mState = DC_WRITE;
+
+	return false;
+}
+
+bool DecodeCache::ReadTransaction(U64 &edgeHash, DecodeCacheState &state)
+{
+	U8 record[TRANSACTION_RECORD_SIZE];
+
+	if (mState != DC_READ || mFile.peek() != TAG_TRANSACTION)
+		return false;
+
+	mFile.read(reinterpret_cast<char *>(record), TRANSACTION_RECORD_SIZE);
+	if (!mFile.good())
+		return false;
+
+	edgeHash = Get(record + 1, 8);
+	GetState(record + 9, state);
+
+	return true;
+}
+
+bool DecodeCache::ReadFrame(Frame &frame)
+{
+	U8 record[FRAME_RECORD_SIZE];
+
+	// Next transaction or end of file ends frames of transaction
+	if (mState != DC_READ || mFile.peek() != TAG_FRAME)
+		return false;
+
+	mFile.get();
+	mFile.read(reinterpret_cast<char *>(record), FRAME_RECORD_SIZE);
+	if (!mFile.good())
+		return false;
+
+	frame.mStartingSampleInclusive = S64(Get(record, 8));
+	frame.mEndingSampleInclusive = S64(Get(record + 8, 8));
+	frame.mData1 = Get(record + 16, 8);
+	frame.mData2 = Get(record + 24, 8);
+	frame.mType = record[32];
+	frame.mFlags = record[33];
+
+	return true;
+}
+
+void DecodeCache::Finish(const DecodeCacheState &state)
+{
+	if (mState == DC_WRITE)
+	{
+		WriteHeader(true, state);
+		mFile.close();
+		remove(mFileName.c_str());
+		if (rename((mFileName + ".tmp").c_str(), mFileName.c_str()) != 0)
+			remove((mFileName + ".tmp").c_str());
+		LimitCacheFiles();
+	}
+	else if (mFile.is_open())
+	{
+		mFile.close();
+	}
+	mState = DC_IDLE;
+	mPending.clear();
+	mPrefix.clear();
+}
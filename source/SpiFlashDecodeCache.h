@@ -0,0 +1,123 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_DECODE_CACHE_H
+#define SPIFLASH_DECODE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <AnalyzerResults.h>
+
+// Increment when frame content or cache layout changes
+#define DECODE_CACHE_VERSION 6
+
+static inline U64 Fnv1a(const void *data, size_t len, U64 hash = 0xCBF29CE484222325ULL)
+{
+	const U8 *p = static_cast<const U8 *>(data);
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash ^= p[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+// Decoder state needed to continue decoding after cached frames
+struct DecodeCacheState
+{
+	U64 mResumeSample;
+	U32 mLockedCmdRef;
+	U8 mDefaultBusMode;
+	U8 mClockIdleState;
+	U8 mAddressLength;
+	U8 mExtendedAddress;
+	// Command set selected by Read JEDEC ID
+	U8 mCmdSetId;
+	U8 mCmdSetConfirmed;
+};
+
+// Frames of already decoded capture stored on disk.
+// Cache file name is derived from decoder settings and frames of first
+// PROBE_TRANSACTIONS transactions (that are always decoded), when file with
+// same prefix exists remaining frames are read from it instead of decoding.
+// Every following transaction starts with hash of edges of all channels in it,
+// its frames are read only when the same edges are found in capture.
+class DecodeCache
+{
+	enum State
+	{
+		DC_IDLE,
+		DC_PROBE,
+		DC_WRITE,
+		DC_READ,
+	};
+	State mState;
+	std::string mKey;
+	std::string mFileName;
+	// Serialized frames of first transactions
+	std::vector<U8> mPrefix;
+	U64 mPrefixFrames;
+	// Serialized frames of transaction being decoded
+	std::vector<U8> mPending;
+	U64 mPendingFrames;
+	U64 mPendingTransactions;
+	U64 mTransactions;
+	U64 mFrames;
+	std::fstream mFile;
+	// Transactions and frames after prefix, as stored in file
+	U64 mBodyTransactions;
+	U64 mBodyFrames;
+
+	void WriteHeader(bool complete, const DecodeCacheState &state);
+	// Removes oldest cache files over count or total size limit, file just written stays
+	void LimitCacheFiles();
+	static std::string GetCacheDir();
+public:
+	enum { PROBE_TRANSACTIONS = 256 };
+
+	DecodeCache();
+	~DecodeCache();
+
+	void Begin(const std::string &key);
+	void Close();
+	bool IsProbing() const { return mState == DC_PROBE; }
+	bool IsWriting() const { return mState == DC_WRITE; }
+	U64 GetTransactionCount() const { return mTransactions; }
+
+	// Transaction with given edge hash starts, state is decoder state before it
+	void StartTransaction(U64 edgeHash, const DecodeCacheState &state);
+	void AddFrame(const Frame &frame);
+	void CommitTransaction();
+	// Looks for cache file, if not found new one is being written, state is state after last transaction
+	bool Lookup(DecodeCacheState &state);
+	bool ReadTransaction(U64 &edgeHash, DecodeCacheState &state);
+	// Frames of transaction read last
+	bool ReadFrame(Frame &frame);
+	// Decoding stops, cache file is complete up to last transaction
+	void Finish(const DecodeCacheState &state);
+};
+
+#endif //SPIFLASH_DECODE_CACHE_H
@@ -0,0 +1,361 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstring>
+#include "SpiFlashDigest.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAVE_X86_DIGEST
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DIGEST_TARGET(x)
+#else
+#include <cpuid.h>
+#define DIGEST_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+static const U32 sha256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static U32 crc32cTable[256];
+
+static U32 Crc32cPortable(U32 crc, const U8 *data, size_t len)
+{
+	crc = ~crc;
+	while (len--)
+		crc = crc32cTable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static inline U32 Rotr(U32 x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static void Sha256BlocksPortable(U32 state[8], const U8 *data, size_t blocks)
+{
+	U32 w[64];
+
+	for (; blocks; --blocks, data += 64)
+	{
+		for (int i = 0; i < 16; ++i)
+			w[i] = U32(data[4 * i]) << 24 | U32(data[4 * i + 1]) << 16 | U32(data[4 * i + 2]) << 8 | data[4 * i + 3];
+		for (int i = 16; i < 64; ++i)
+		{
+			U32 s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			U32 s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		U32 a = state[0], b = state[1], c = state[2], d = state[3];
+		U32 e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 64; ++i)
+		{
+			U32 t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+			U32 t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#ifdef HAVE_X86_DIGEST
+static void Cpuid(U32 leaf, U32 regs[4])
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuidex(r, int(leaf), 0);
+	for (int i = 0; i < 4; ++i)
+		regs[i] = U32(r[i]);
+#else
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+	if (__get_cpuid_max(0, nullptr) >= leaf)
+		__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+DIGEST_TARGET("sse4.2")
+static U32 Crc32cSse42(U32 crc, const U8 *data, size_t len)
+{
+	crc = ~crc;
+#if defined(__x86_64__) || defined(_M_X64)
+	U64 crc64 = crc;
+	for (; len >= 8; len -= 8, data += 8)
+	{
+		U64 v;
+		memcpy(&v, data, 8);
+		crc64 = _mm_crc32_u64(crc64, v);
+	}
+	crc = U32(crc64);
+#endif
+	for (; len >= 4; len -= 4, data += 4)
+	{
+		U32 v;
+		memcpy(&v, data, 4);
+		crc = _mm_crc32_u32(crc, v);
+	}
+	while (len--)
+		crc = _mm_crc32_u8(crc, *data++);
+	return ~crc;
+}
+
+// Four rounds per step, message schedule of the following steps is prepared on the way
+DIGEST_TARGET("sha,sse4.1,ssse3")
+static void Sha256BlocksShaNi(U32 state[8], const U8 *data, size_t blocks)
+{
+	const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i msg[4];
+
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1B);
+	// ABEF and CDGH as instructions want them
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (; blocks; --blocks, data += 64)
+	{
+		__m128i abef = state0;
+		__m128i cdgh = state1;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			__m128i &m = msg[i & 3];
+			if (i < 4)
+				m = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i)), byteSwap);
+			__m128i k = _mm_add_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&sha256K[4 * i])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, k);
+			if (i >= 3 && i < 15)
+			{
+				__m128i &next = msg[(i + 1) & 3];
+				next = _mm_add_epi32(next, _mm_alignr_epi8(m, msg[(i - 1) & 3], 4));
+				next = _mm_sha256msg2_epu32(next, m);
+			}
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(k, 0x0E));
+			if (i >= 1 && i < 13)
+				msg[(i - 1) & 3] = _mm_sha256msg1_epu32(msg[(i - 1) & 3], m);
+		}
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), _mm_alignr_epi8(state1, tmp, 8));
+}
+#endif
+
+typedef U32 (*Crc32cFunction)(U32 crc, const U8 *data, size_t len);
+typedef void (*Sha256Function)(U32 state[8], const U8 *data, size_t blocks);
+
+static Crc32cFunction SelectCrc32c()
+{
+	for (U32 i = 0; i < 256; ++i)
+	{
+		U32 c = i;
+		for (int j = 0; j < 8; ++j)
+			c = (c >> 1) ^ ((c & 1) ? 0x82F63B78 : 0);
+		crc32cTable[i] = c;
+	}
+#ifdef HAVE_X86_DIGEST
+	U32 regs[4];
+	Cpuid(1, regs);
+	if (regs[2] & (1 << 20))
+		return Crc32cSse42;
+#endif
+	return Crc32cPortable;
+}
+
+static Sha256Function SelectSha256()
+{
+#ifdef HAVE_X86_DIGEST
+	U32 features[4];
+	U32 extended[4];
+	Cpuid(1, features);
+	Cpuid(7, extended);
+	// SSSE3, SSE4.1 and SHA
+	if ((features[2] & (1 << 9)) && (features[2] & (1 << 19)) && (extended[1] & (1 << 29)))
+		return Sha256BlocksShaNi;
+#endif
+	return Sha256BlocksPortable;
+}
+
+static const Crc32cFunction crc32cBlocks = SelectCrc32c();
+static const Sha256Function sha256Blocks = SelectSha256();
+
+U32 Crc32c(U32 crc, const U8 *data, size_t len)
+{
+	return crc32cBlocks(crc, data, len);
+}
+
+bool Crc32cAccelerated()
+{
+	return crc32cBlocks != Crc32cPortable;
+}
+
+bool Sha256Accelerated()
+{
+	return sha256Blocks != Sha256BlocksPortable;
+}
+
+void Sha256::Reset()
+{
+	static const U32 initial[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+	memcpy(mState, initial, sizeof(mState));
+	mLength = 0;
+}
+
+void Sha256::Update(const U8 *data, size_t len)
+{
+	size_t used = size_t(mLength % 64);
+
+	mLength += len;
+	if (used)
+	{
+		size_t n = len < 64 - used ? len : 64 - used;
+		memcpy(mBuffer + used, data, n);
+		data += n;
+		len -= n;
+		if (used + n < 64)
+			return;
+		sha256Blocks(mState, mBuffer, 1);
+	}
+	if (len >= 64)
+	{
+		sha256Blocks(mState, data, len / 64);
+		data += len & ~size_t(63);
+		len &= 63;
+	}
+	if (len)
+		memcpy(mBuffer, data, len);
+}
+
+void Sha256::Final(U8 digest[DIGEST_SIZE])
+{
+	U64 bits = mLength * 8;
+	U8 pad[72] = { 0x80 };
+	size_t padLen = (mLength % 64 < 56 ? 56 : 120) - size_t(mLength % 64);
+
+	for (int i = 0; i < 8; ++i)
+		pad[padLen + i] = U8(bits >> (56 - 8 * i));
+	Update(pad, padLen + 8);
+	for (int i = 0; i < 8; ++i)
+	{
+		digest[4 * i] = U8(mState[i] >> 24);
+		digest[4 * i + 1] = U8(mState[i] >> 16);
+		digest[4 * i + 2] = U8(mState[i] >> 8);
+		digest[4 * i + 3] = U8(mState[i]);
+	}
+}
+
+RangeDigests::RangeDigests() : mHaveOpen(false), mNext(0)
+{
+}
+
+void RangeDigests::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mRanges.clear();
+	mHaveOpen = false;
+}
+
+void RangeDigests::CloseRange()
+{
+	if (!mHaveOpen)
+		return;
+	mOpenSha.Final(mOpen.mSha256);
+	if (mRanges.size() < MAX_RANGES)
+		mRanges.push_back(mOpen);
+	mHaveOpen = false;
+}
+
+void RangeDigests::Add(const SpiTransaction &t)
+{
+	const SpiCmdData *cmd = t.mCmd;
+
+	if (cmd == nullptr || !cmd->IsArrayAccess() || !t.mHaveAddress || t.mData.empty() ||
+		(cmd->mCmdOp != OP_DATA_READ && cmd->mCmdOp != OP_DATA_WRITE))
+		return;
+
+	std::lock_guard<std::mutex> lock(mLock);
+	bool program = cmd->mCmdOp == OP_DATA_WRITE;
+
+	if (mHaveOpen && (program != mOpen.mProgram || t.mAddress != mNext))
+		CloseRange();
+	if (!mHaveOpen)
+	{
+		mOpen.mFirstTransaction = t.mId;
+		mOpen.mAddress = t.mAddress;
+		mOpen.mLength = 0;
+		mOpen.mProgram = program;
+		mOpen.mCrc = 0;
+		mOpenSha.Reset();
+		mHaveOpen = true;
+	}
+	mOpen.mLastTransaction = t.mId;
+	mOpen.mLength += U32(t.mData.size());
+	mOpen.mCrc = Crc32c(mOpen.mCrc, &t.mData[0], t.mData.size());
+	mOpenSha.Update(&t.mData[0], t.mData.size());
+	mNext = U64(t.mAddress) + t.mData.size();
+}
+
+void RangeDigests::GetRanges(std::vector<DigestRange> &ranges) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	ranges = mRanges;
+	if (mHaveOpen)
+	{
+		Sha256 sha = mOpenSha;
+		ranges.push_back(mOpen);
+		sha.Final(ranges.back().mSha256);
+	}
+}
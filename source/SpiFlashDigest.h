@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_DIGEST_H
+#define SPIFLASH_DIGEST_H
+
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+// CRC-32C (Castagnoli), crc is result of previous call for running digest, 0 to start
+U32 Crc32c(U32 crc, const U8 *data, size_t len);
+
+class Sha256
+{
+	U32 mState[8];
+	U8 mBuffer[64];
+	U64 mLength;
+public:
+	enum { DIGEST_SIZE = 32 };
+
+	Sha256() { Reset(); }
+
+	void Reset();
+	void Update(const U8 *data, size_t len);
+	void Final(U8 digest[DIGEST_SIZE]);
+};
+
+// True when CRC-32C and SHA-256 use SSE4.2 and SHA extensions
+bool Crc32cAccelerated();
+bool Sha256Accelerated();
+
+struct DigestRange
+{
+	U64 mFirstTransaction;
+	U64 mLastTransaction;
+	U32 mAddress;
+	U32 mLength;
+	bool mProgram;
+	U32 mCrc;
+	U8 mSha256[Sha256::DIGEST_SIZE];
+};
+
+// Digests of read and program data over contiguous address ranges, range ends
+// when next transaction does not continue at address where previous one ended
+class RangeDigests
+{
+	std::vector<DigestRange> mRanges;
+	// Range being extended
+	DigestRange mOpen;
+	Sha256 mOpenSha;
+	bool mHaveOpen;
+	U64 mNext;
+	mutable std::mutex mLock;
+
+	void CloseRange();
+public:
+	enum { MAX_RANGES = 100000 };
+
+	RangeDigests();
+
+	void Clear();
+	void Add(const SpiTransaction &transaction);
+	// Closed ranges followed by the one still open
+	void GetRanges(std::vector<DigestRange> &ranges) const;
+};
+
+#endif //SPIFLASH_DIGEST_H
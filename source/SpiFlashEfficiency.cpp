@@ -0,0 +1,228 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstring>
+#include "SpiFlashEfficiency.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlashDecodeCache.h"
+#include "SpiFlash.h"
+
+DriverEfficiency::DriverEfficiency() : mWel(false), mPrevCmdRef(CMD_REF_NONE), mPrevRead(false),
+	mPrevNext(0), mPrevBytes(0), mPrevEnd(0), mProgramNext(~0ULL), mProgramEnd(0), mMaxReadLength(0)
+{
+	memset(mTotals, 0, sizeof(mTotals));
+}
+
+const char *DriverEfficiency::GetFindingName(FindingType type)
+{
+	switch (type)
+	{
+	case FI_REDUNDANT_WREN:
+		return "Redundant WREN";
+	case FI_PARTIAL_PROGRAM:
+		return "Partial page program continued";
+	case FI_PAGE_CROSSING_PROGRAM:
+		return "Program crossing page boundary";
+	case FI_MERGEABLE_READ:
+		return "Adjacent reads could be merged";
+	case FI_REREAD:
+		return "Re-read of unchanged data";
+	case FI_SINGLE_LINE_READ:
+		return "1-1-1 read where 1-4-4 is available";
+	case FI_MISSED_CONTINUOUS_READ:
+		return "Command repeated instead of continuous read";
+	default:
+		return "";
+	}
+}
+
+void DriverEfficiency::AddFinding(FindingType type, const SpiTransaction &t, U64 wasted)
+{
+	mTotals[type].mCount++;
+	mTotals[type].mWasted += wasted;
+
+	// Totals are always complete, details are limited
+	if (mFindings.size() < MAX_FINDINGS)
+	{
+		Finding f = { t.mId, t.mStart, wasted, t.mAddress, U8(type) };
+		mFindings.push_back(f);
+	}
+}
+
+void DriverEfficiency::Invalidate(U32 first, U32 last)
+{
+	std::map<U32, ReadRecord>::iterator i = mReads.lower_bound(first > mMaxReadLength ? first - mMaxReadLength : 0);
+
+	while (i != mReads.end() && i->first <= last)
+	{
+		if (U64(i->first) + i->second.mLength > first)
+			i = mReads.erase(i);
+		else
+			++i;
+	}
+}
+
+// Samples 1-4-4 read of same length would save
+U64 DriverEfficiency::QuadReadSaving(const SpiTransaction &t) const
+{
+	const SpiCmdData *cmd = t.mCmd;
+	const CmdSet *cmdSet = spiFlash.GetCommandSet(t.mCmdSetId);
+
+	if (cmd->mModeArgs > 1 || cmd->mModeData > 1 || t.mBusMode > 1 || t.mClockCycles == 0 || cmdSet == nullptr)
+		return 0;
+
+	// Shortest 1-4-4 read of command set that decoded this transaction
+	U64 quadCycles = 0;
+	const SpiCmdData *quad;
+	for (size_t i = 0; (quad = cmdSet->GetCommandByIndex(i)) != nullptr; ++i)
+	{
+		if (quad->mCmdOp != OP_DATA_READ || !quad->IsSingle() || quad->mModeArgs != 4 || quad->mDtr ||
+			!quad->IsArrayAccess())
+			continue;
+		U32 addressBits = quad->mAddressBits != 0xFF ? quad->mAddressBits : t.mAddressBits;
+		U32 dummyCycles = quad->mDummyBytes ? quad->mDummyCount * 8 / 4 : quad->mDummyCount;
+		U64 cycles = 8 + addressBits / 4 + (quad->mContinuousRead ? 2 : 0) + dummyCycles + U64(t.mByteCount) * 2;
+		if (quadCycles == 0 || cycles < quadCycles)
+			quadCycles = cycles;
+	}
+	if (quadCycles == 0 || quadCycles >= t.mClockCycles)
+		return 0;
+
+	// Clock as measured on this transaction
+	return (t.mClockCycles - quadCycles) * (t.mLastClock - t.mFirstClock) / t.mClockCycles;
+}
+
+void DriverEfficiency::Add(const SpiTransaction &t)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	const SpiCmdData *cmd = t.mCmd;
+	bool read = false;
+
+	if (cmd == nullptr)
+	{
+		mPrevCmdRef = CMD_REF_NONE;
+		mPrevRead = false;
+		return;
+	}
+
+	U64 duration = t.mEnd - t.mStart;
+	U64 dataStart = t.mDataStart ? t.mDataStart : t.mEnd;
+
+	if (cmd->mRole == ROLE_WRITE_ENABLE)
+	{
+		if (mWel)
+			AddFinding(FI_REDUNDANT_WREN, t, duration);
+		mWel = true;
+	}
+	else if (cmd->mRole == ROLE_WRITE_DISABLE || cmd->StartsBusyOperation())
+	{
+		// Operation clears write enable latch
+		mWel = false;
+	}
+
+	if (cmd->mEraseSize == ERASE_CHIP)
+	{
+		mReads.clear();
+	}
+	else if (!cmd->IsArrayAccess() || !t.mHaveAddress)
+	{
+		// Security registers, SFDP, ... are not tracked
+	}
+	else if (cmd->mCmdOp == OP_DATA_WRITE && t.mByteCount)
+	{
+		U32 offset = t.mAddress % t.mPageSize;
+		U32 page = t.mAddress - offset;
+		if (offset + t.mByteCount > t.mPageSize)
+		{
+			// Wrapped data has to be programmed again
+			AddFinding(FI_PAGE_CROSSING_PROGRAM, t, duration);
+			Invalidate(page, page + t.mPageSize - 1);
+		}
+		else
+		{
+			// Everything from end of previous program to this data phase
+			if (t.mAddress == mProgramNext && offset != 0)
+				AddFinding(FI_PARTIAL_PROGRAM, t, dataStart - mProgramEnd);
+			Invalidate(t.mAddress, t.mAddress + t.mByteCount - 1);
+		}
+		mProgramNext = U64(t.mAddress) + t.mByteCount;
+		mProgramEnd = t.mEnd;
+	}
+	else if (cmd->mEraseSize)
+	{
+		U32 first = t.mAddress & ~(cmd->mEraseSize - 1);
+		Invalidate(first, first + (cmd->mEraseSize - 1));
+	}
+	else if (cmd->mCmdOp == OP_DATA_READ && t.mByteCount)
+	{
+		bool sameCommand = mPrevRead && mPrevCmdRef == t.mCmdRef;
+		read = true;
+
+		if (sameCommand && mPrevBytes < PAGE_SIZE && t.mAddress == mPrevNext)
+			AddFinding(FI_MERGEABLE_READ, t, dataStart - mPrevEnd);
+		else if (sameCommand && cmd->mContinuousRead && !t.mContinuous && t.mClockCycles)
+			AddFinding(FI_MISSED_CONTINUOUS_READ, t, 8 / (t.mBusMode ? t.mBusMode : 1) *
+				(t.mLastClock - t.mFirstClock) / t.mClockCycles);
+
+		U64 saving = QuadReadSaving(t);
+		if (saving)
+			AddFinding(FI_SINGLE_LINE_READ, t, saving);
+
+		U64 hash = Fnv1a(t.mData.data(), t.mData.size());
+		std::map<U32, ReadRecord>::iterator i = mReads.find(t.mAddress);
+		if (i != mReads.end() && i->second.mLength == t.mByteCount && i->second.mHash == hash)
+		{
+			AddFinding(FI_REREAD, t, duration);
+		}
+		else
+		{
+			// History is dropped rather than growing without limit
+			if (mReads.size() >= MAX_READS)
+				mReads.clear();
+			ReadRecord record = { t.mByteCount, hash };
+			mReads[t.mAddress] = record;
+			if (t.mByteCount > mMaxReadLength)
+				mMaxReadLength = t.mByteCount;
+		}
+	}
+
+	mPrevCmdRef = t.mCmdRef;
+	mPrevRead = read;
+	mPrevNext = U64(t.mAddress) + t.mByteCount;
+	mPrevBytes = t.mByteCount;
+	mPrevEnd = t.mEnd;
+}
+
+void DriverEfficiency::GetTotals(FindingTotal totals[FI_COUNT]) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	memcpy(totals, mTotals, sizeof(mTotals));
+}
+
+void DriverEfficiency::GetFindings(std::vector<Finding> &findings) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	findings = mFindings;
+}
@@ -0,0 +1,111 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_EFFICIENCY_H
+#define SPIFLASH_EFFICIENCY_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+enum FindingType
+{
+	// WREN while write enable latch is already set
+	FI_REDUNDANT_WREN,
+	// Program continuing previous partial program of the same page
+	FI_PARTIAL_PROGRAM,
+	// Program wrapping at page boundary, data lands at page start
+	FI_PAGE_CROSSING_PROGRAM,
+	// Short read starting where previous read of same command ended
+	FI_MERGEABLE_READ,
+	// Same data read again with no program or erase in between
+	FI_REREAD,
+	// 1-1-1 read while command set has 1-4-4 read
+	FI_SINGLE_LINE_READ,
+	// Command sent again where continuous read (M bits) could skip it
+	FI_MISSED_CONTINUOUS_READ,
+	FI_COUNT,
+};
+
+struct Finding
+{
+	U64 mTransaction;
+	U64 mSample;
+	// Bus time that could be avoided, in samples
+	U64 mWasted;
+	U32 mAddress;
+	U8 mType;
+};
+
+struct FindingTotal
+{
+	U64 mCount;
+	U64 mWasted;
+};
+
+// Looks for avoidable bus time in driver behaviour, fed in decode order
+class DriverEfficiency
+{
+	struct ReadRecord
+	{
+		U32 mLength;
+		U64 mHash;
+	};
+	// Write enable latch as host should see it
+	bool mWel;
+	// Previous transaction
+	U32 mPrevCmdRef;
+	bool mPrevRead;
+	U64 mPrevNext;
+	U32 mPrevBytes;
+	U64 mPrevEnd;
+	// Last program, for partial page programs
+	U64 mProgramNext;
+	U64 mProgramEnd;
+	// Reads since last program/erase of the same area, by address
+	std::map<U32, ReadRecord> mReads;
+	U32 mMaxReadLength;
+	std::vector<Finding> mFindings;
+	FindingTotal mTotals[FI_COUNT];
+	mutable std::mutex mLock;
+
+	void AddFinding(FindingType type, const SpiTransaction &transaction, U64 wasted);
+	void Invalidate(U32 first, U32 last);
+	U64 QuadReadSaving(const SpiTransaction &transaction) const;
+public:
+	enum { PAGE_SIZE = 256, MAX_FINDINGS = 100000, MAX_READS = 1 << 18 };
+
+	DriverEfficiency();
+
+	void Add(const SpiTransaction &transaction);
+
+	void GetTotals(FindingTotal totals[FI_COUNT]) const;
+	void GetFindings(std::vector<Finding> &findings) const;
+	static const char *GetFindingName(FindingType type);
+};
+
+#endif //SPIFLASH_EFFICIENCY_H
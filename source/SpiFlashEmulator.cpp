@@ -0,0 +1,366 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <cstring>
+#include "SpiFlashEmulator.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+#define LOCK_BLOCK_SIZE 0x10000
+
+FlashEmulator::FlashEmulator() : mCapacity(0), mErased(new EmulatorBlock)
+{
+	memset(mErased->mData, 0xFF, sizeof(mErased->mData));
+	memset(mErased->mKnown, 0xFF, sizeof(mErased->mKnown));
+	Configure(0x1000000);
+}
+
+void FlashEmulator::Configure(U32 capacity)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mCapacity = std::max<U32>(capacity, EmulatorBlock::SIZE);
+	mBlocks.clear();
+	mBlocks.resize(mCapacity / EmulatorBlock::SIZE);
+	mOtp.clear();
+	mLocks.assign(mCapacity / EmulatorBlock::SIZE, false);
+	mOtpLocked = false;
+	mInOtp = false;
+	mWel = -1;
+	mQuadWrapLength = 0;
+	memset(&mTotals, 0, sizeof(mTotals));
+	mFindings.clear();
+}
+
+const char *FlashEmulator::GetFindingName(EmulatorFindingType type)
+{
+	switch (type)
+	{
+	case EF_READ_MISMATCH:
+		return "Read differs from model";
+	case EF_ZERO_TO_ONE:
+		return "Program of 1 over 0 without erase";
+	case EF_NO_WRITE_ENABLE:
+		return "Program/erase without WREN";
+	case EF_LOCKED:
+		return "Program/erase of locked area";
+	default:
+		return "";
+	}
+}
+
+void FlashEmulator::AddFinding(EmulatorFindingType type, const SpiTransaction &t, U32 address, U32 count,
+	U8 expected, U8 actual, bool otp)
+{
+	mTotals.mFindings[type]++;
+
+	if (mFindings.size() < MAX_FINDINGS)
+	{
+		EmulatorFinding f = { t.mId, t.mStart, address, count, expected, actual, U8(type), otp };
+		mFindings.push_back(f);
+	}
+}
+
+// Writable block, never touched blocks start unknown, shared ones are copied
+FlashEmulator::BlockPtr &FlashEmulator::GetBlock(U32 address, bool otp)
+{
+	BlockPtr &block = otp ? mOtp[address / EmulatorBlock::SIZE] : mBlocks[address / EmulatorBlock::SIZE];
+
+	if (!block)
+	{
+		block.reset(new EmulatorBlock);
+		memset(block->mData, 0xFF, sizeof(block->mData));
+		memset(block->mKnown, 0, sizeof(block->mKnown));
+	}
+	else if (block == mErased)
+	{
+		block.reset(new EmulatorBlock(*mErased));
+	}
+	return block;
+}
+
+const EmulatorBlock *FlashEmulator::FindBlock(U32 address, bool otp) const
+{
+	if (!otp)
+		return mBlocks[address / EmulatorBlock::SIZE].get();
+
+	std::map<U32, BlockPtr>::const_iterator i = mOtp.find(address / EmulatorBlock::SIZE);
+	return i != mOtp.end() ? i->second.get() : nullptr;
+}
+
+U32 FlashEmulator::WrapLength(const SpiTransaction &t) const
+{
+	// Burst length from register shadow
+	if (t.mWrapLength)
+		return t.mWrapLength;
+	if (t.mCmd->mModeArgs == 4)
+		return mQuadWrapLength;
+	return 0;
+}
+
+bool FlashEmulator::IsLocked(U32 first, U32 last) const
+{
+	for (U32 i = first / EmulatorBlock::SIZE; i <= last / EmulatorBlock::SIZE && i < mLocks.size(); ++i)
+		if (mLocks[i])
+			return true;
+	return false;
+}
+
+// Locks are per 64 KiB block, except first and last block that lock 4 KiB sectors
+void FlashEmulator::SetLock(U32 address, bool lock)
+{
+	U32 first = address & ~(EmulatorBlock::SIZE - 1);
+	U32 size = EmulatorBlock::SIZE;
+
+	if (address >= LOCK_BLOCK_SIZE && address < mCapacity - LOCK_BLOCK_SIZE)
+	{
+		first = address & ~(LOCK_BLOCK_SIZE - 1);
+		size = LOCK_BLOCK_SIZE;
+	}
+	for (U32 i = 0; i < size; i += EmulatorBlock::SIZE)
+		mLocks[(first + i) / EmulatorBlock::SIZE] = lock;
+}
+
+void FlashEmulator::Read(const SpiTransaction &t, bool otp)
+{
+	U32 wrap = WrapLength(t);
+	U32 base = wrap ? t.mAddress & ~(wrap - 1) : t.mAddress;
+	U32 offset = t.mAddress - base;
+	U32 mask = otp ? ~0U : mCapacity - 1;
+	U32 mismatches = 0;
+	U32 firstMismatch = 0;
+	U8 expected = 0;
+	U8 firstActual = 0;
+
+	mTotals.mReads++;
+	for (size_t i = 0; i < t.mData.size(); ++i)
+	{
+		U32 address = (wrap ? base + (offset + U32(i)) % wrap : t.mAddress + U32(i)) & mask;
+		U32 o = address % EmulatorBlock::SIZE;
+		U8 actual = t.mData[i];
+		const EmulatorBlock *block = FindBlock(address, otp);
+		if (block && block->IsKnown(o))
+		{
+			mTotals.mCheckedBytes++;
+			if (block->mData[o] == actual)
+				continue;
+			if (mismatches++ == 0)
+			{
+				firstMismatch = address;
+				expected = block->mData[o];
+				firstActual = actual;
+			}
+		}
+		else
+		{
+			mTotals.mLearnedBytes++;
+		}
+		// Captured data is what the device has, keep it so one difference is reported once
+		EmulatorBlock *writable = GetBlock(address, otp).get();
+		writable->mData[o] = actual;
+		writable->SetKnown(o);
+	}
+	if (mismatches)
+		AddFinding(EF_READ_MISMATCH, t, firstMismatch, mismatches, expected, firstActual, otp);
+}
+
+void FlashEmulator::Program(const SpiTransaction &t, bool otp)
+{
+	U32 mask = otp ? ~0U : mCapacity - 1;
+	U32 pageSize = otp ? U32(PAGE_SIZE) : t.mPageSize;
+	U32 page = t.mAddress & ~(pageSize - 1) & mask;
+	U32 offset = t.mAddress % pageSize;
+	// Data wraps inside of page, only last page size bytes are latched
+	size_t start = t.mData.size() > pageSize ? t.mData.size() - pageSize : 0;
+	U32 setBits = 0;
+	U32 firstSet = 0;
+	U8 expected = 0;
+	U8 actual = 0;
+
+	mTotals.mPrograms++;
+	for (size_t i = start; i < t.mData.size(); ++i)
+	{
+		U32 address = page + (offset + U32(i)) % pageSize;
+		U32 o = address % EmulatorBlock::SIZE;
+		U8 d = t.mData[i];
+		EmulatorBlock *block = GetBlock(address, otp).get();
+		if (block->IsKnown(o))
+		{
+			// 0xFF is common padding that leaves byte as it is
+			if (d != 0xFF && (d & ~block->mData[o]))
+			{
+				if (setBits++ == 0)
+				{
+					firstSet = address;
+					expected = block->mData[o];
+					actual = d;
+				}
+			}
+			block->mData[o] &= d;
+		}
+		else if (d == 0)
+		{
+			// Nothing else can be there after programming all zeros
+			block->mData[o] = 0;
+			block->SetKnown(o);
+		}
+	}
+	if (setBits)
+		AddFinding(EF_ZERO_TO_ONE, t, firstSet, setBits, expected, actual, otp);
+}
+
+void FlashEmulator::Erase(U32 address, U32 size, bool otp)
+{
+	mTotals.mErases++;
+	if (size == ERASE_CHIP)
+	{
+		std::fill(mBlocks.begin(), mBlocks.end(), mErased);
+		return;
+	}
+
+	U32 first = address & ~(size - 1);
+	for (U32 i = 0; i < size; )
+	{
+		U32 a = first + i;
+		if (!otp && a % EmulatorBlock::SIZE == 0 && size - i >= EmulatorBlock::SIZE)
+		{
+			mBlocks[(a & (mCapacity - 1)) / EmulatorBlock::SIZE] = mErased;
+			i += EmulatorBlock::SIZE;
+			continue;
+		}
+		EmulatorBlock *block = GetBlock(a & (otp ? ~0U : mCapacity - 1), otp).get();
+		block->mData[a % EmulatorBlock::SIZE] = 0xFF;
+		block->SetKnown(a % EmulatorBlock::SIZE);
+		i++;
+	}
+}
+
+void FlashEmulator::Add(const SpiTransaction &t)
+{
+	const SpiCmdData *cmd = t.mCmd;
+
+	if (cmd == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(mLock);
+	U8 data = t.mData.size() ? t.mData[0] : 0;
+
+	switch (cmd->mRole)
+	{
+	case ROLE_WRITE_ENABLE:
+		mWel = 1;
+		return;
+	case ROLE_WRITE_DISABLE:
+		mWel = 0;
+		return;
+	case ROLE_ENTER_OTP:
+		mInOtp = true;
+		return;
+	case ROLE_EXIT_OTP:
+		mInOtp = false;
+		return;
+	case ROLE_LOCK_OTP:
+		mOtpLocked = true;
+		return;
+	case ROLE_SECTOR_LOCK:
+	case ROLE_SECTOR_UNLOCK:
+		if (t.mHaveAddress)
+			SetLock(t.mAddress & (mCapacity - 1), cmd->mRole == ROLE_SECTOR_LOCK);
+		return;
+	case ROLE_GLOBAL_LOCK:
+	case ROLE_GLOBAL_UNLOCK:
+		mLocks.assign(mLocks.size(), cmd->mRole == ROLE_GLOBAL_LOCK);
+		return;
+	case ROLE_SET_WRAP:
+		// W4 disables wrap, W6-W5 select 8, 16, 32 or 64 bytes
+		if (t.mData.size())
+			mQuadWrapLength = (data & 0x10) ? 0 : 8 << ((data >> 5) & 3);
+		return;
+	default:
+		break;
+	}
+
+	bool otp = cmd->mRole == ROLE_OTP || (mInOtp && cmd->IsArrayAccess());
+	bool array = otp || cmd->IsArrayAccess();
+	U32 size = 0;
+	U32 first = 0;
+	U32 last = 0;
+
+	if (cmd->mEraseSize && !mInOtp && (t.mHaveAddress || cmd->mEraseSize == ERASE_CHIP))
+	{
+		size = cmd->mEraseSize;
+		first = size == ERASE_CHIP ? 0 : t.mAddress & ~(size - 1) & (mCapacity - 1);
+		last = size == ERASE_CHIP ? mCapacity - 1 : first + size - 1;
+	}
+	else if (otp && cmd->mCmdOp == OP_NO_DATA && t.mHaveAddress)
+	{
+		size = OTP_ERASE_SIZE;
+		first = t.mAddress & ~(size - 1);
+		last = first + size - 1;
+	}
+	else if (array && cmd->mCmdOp == OP_DATA_WRITE && t.mHaveAddress)
+	{
+		U32 pageSize = otp ? U32(PAGE_SIZE) : t.mPageSize;
+		first = t.mAddress & ~(pageSize - 1) & (otp ? ~0U : mCapacity - 1);
+		last = first + pageSize - 1;
+	}
+	else
+	{
+		if (array && cmd->mCmdOp == OP_DATA_READ && t.mHaveAddress)
+			Read(t, otp);
+		else if (cmd->mCmdOp == OP_REG_WRITE)
+			mWel = 0;
+		return;
+	}
+
+	// Program or erase, device ignores it without write enable or when area is protected
+	bool wel = mWel != 0;
+	mWel = 0;
+	if (!wel)
+		AddFinding(EF_NO_WRITE_ENABLE, t, first, 0, 0, 0, otp);
+	else if (otp ? mOtpLocked : IsLocked(first, last))
+		AddFinding(EF_LOCKED, t, first, 0, 0, 0, otp);
+	else if (size)
+		Erase(first, size, otp);
+	else
+		Program(t, otp);
+}
+
+void FlashEmulator::GetTotals(EmulatorTotals &totals) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	totals = mTotals;
+	totals.mBlocks = mOtp.size();
+	for (size_t i = 0; i < mBlocks.size(); ++i)
+		if (mBlocks[i] && mBlocks[i] != mErased)
+			totals.mBlocks++;
+}
+
+void FlashEmulator::GetFindings(std::vector<EmulatorFinding> &findings) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	findings = mFindings;
+}
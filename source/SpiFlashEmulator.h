@@ -0,0 +1,135 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_EMULATOR_H
+#define SPIFLASH_EMULATOR_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+enum EmulatorFindingType
+{
+	// Read data differs from modelled contents
+	EF_READ_MISMATCH,
+	// Program tries to change 0 bit to 1 without erase
+	EF_ZERO_TO_ONE,
+	// Program or erase while write enable latch is not set, ignored by device
+	EF_NO_WRITE_ENABLE,
+	// Program or erase of locked sector or OTP area, ignored by device
+	EF_LOCKED,
+	EF_COUNT,
+};
+
+struct EmulatorFinding
+{
+	U64 mTransaction;
+	U64 mSample;
+	// First offending byte
+	U32 mAddress;
+	// Offending bytes in transaction
+	U32 mCount;
+	U8 mExpected;
+	U8 mActual;
+	U8 mType;
+	bool mOtp;
+};
+
+struct EmulatorTotals
+{
+	U64 mReads;
+	// Read bytes compared with known contents
+	U64 mCheckedBytes;
+	// Read bytes that were not known before, model learns them
+	U64 mLearnedBytes;
+	U64 mPrograms;
+	U64 mErases;
+	U64 mBlocks;
+	U64 mFindings[EF_COUNT];
+};
+
+// 4 KiB of modelled flash, every byte is known (erased, programmed or read) or not
+struct EmulatorBlock
+{
+	enum { SIZE = 0x1000 };
+	U8 mData[SIZE];
+	U8 mKnown[SIZE / 8];
+
+	bool IsKnown(U32 offset) const { return (mKnown[offset >> 3] >> (offset & 7)) & 1; }
+	void SetKnown(U32 offset) { mKnown[offset >> 3] |= U8(1 << (offset & 7)); }
+};
+
+// Behavioural model of flash array driven by decoded transactions.
+// Blocks that were never touched are not allocated, erased blocks share one
+// block and get own copy on first program.
+class FlashEmulator
+{
+	typedef std::shared_ptr<EmulatorBlock> BlockPtr;
+
+	U32 mCapacity;
+	std::vector<BlockPtr> mBlocks;
+	BlockPtr mErased;
+	// OTP area, small and sparse, by block number
+	std::map<U32, BlockPtr> mOtp;
+	// Individual locks per 4 KiB sector
+	std::vector<bool> mLocks;
+	bool mOtpLocked;
+	bool mInOtp;
+	// Write enable latch, -1 until first WREN/WRDI is seen
+	int mWel;
+	// Wrap for 1-4-4 reads set by 0x77, 0 when disabled
+	U32 mQuadWrapLength;
+	EmulatorTotals mTotals;
+	std::vector<EmulatorFinding> mFindings;
+	mutable std::mutex mLock;
+
+	BlockPtr &GetBlock(U32 address, bool otp);
+	const EmulatorBlock *FindBlock(U32 address, bool otp) const;
+	void AddFinding(EmulatorFindingType type, const SpiTransaction &transaction, U32 address, U32 count, U8 expected,
+		U8 actual, bool otp);
+	U32 WrapLength(const SpiTransaction &transaction) const;
+	bool IsLocked(U32 first, U32 last) const;
+	void SetLock(U32 address, bool lock);
+	void Read(const SpiTransaction &transaction, bool otp);
+	void Program(const SpiTransaction &transaction, bool otp);
+	void Erase(U32 address, U32 size, bool otp);
+public:
+	enum { PAGE_SIZE = 256, OTP_ERASE_SIZE = 256, MAX_FINDINGS = 100000 };
+
+	FlashEmulator();
+
+	// Capacity in bytes, power of 2, clears model
+	void Configure(U32 capacity);
+	void Add(const SpiTransaction &transaction);
+
+	void GetTotals(EmulatorTotals &totals) const;
+	void GetFindings(std::vector<EmulatorFinding> &findings) const;
+	static const char *GetFindingName(EmulatorFindingType type);
+};
+
+#endif //SPIFLASH_EMULATOR_H
@@ -0,0 +1,127 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstring>
+#include "SpiFlashHistogram.h"
+
+static int HighestBit(U64 value)
+{
+	int bit = 0;
+
+	while (value >>= 1)
+		bit++;
+	return bit;
+}
+
+void Histogram::Clear()
+{
+	memset(mBuckets, 0, sizeof(mBuckets));
+	mCount = 0;
+	mSum = 0;
+	mMin = ~U64(0);
+	mMax = 0;
+}
+
+U32 Histogram::BucketIndex(U64 value)
+{
+	if (value < SUB_COUNT)
+		return U32(value);
+
+	// Top SUB_BITS + 1 bits select bucket
+	int shift = HighestBit(value) - SUB_BITS;
+	return U32((shift + 1) * SUB_COUNT + ((value >> shift) & (SUB_COUNT - 1)));
+}
+
+U64 Histogram::BucketLow(U32 index)
+{
+	if (index < SUB_COUNT)
+		return index;
+
+	int shift = int(index / SUB_COUNT) - 1;
+	return (U64(SUB_COUNT) + (index & (SUB_COUNT - 1))) << shift;
+}
+
+U64 Histogram::BucketHigh(U32 index)
+{
+	if (index < SUB_COUNT)
+		return index;
+
+	int shift = int(index / SUB_COUNT) - 1;
+	return BucketLow(index) + ((U64(1) << shift) - 1);
+}
+
+void Histogram::Add(U64 value)
+{
+	U32 &bucket = mBuckets[BucketIndex(value)];
+
+	// Saturate instead of wrapping
+	if (bucket != 0xFFFFFFFF)
+		bucket++;
+	mCount++;
+	mSum += value;
+	if (value < mMin)
+		mMin = value;
+	if (value > mMax)
+		mMax = value;
+}
+
+void Histogram::Merge(const Histogram &other)
+{
+	for (U32 i = 0; i < BUCKET_COUNT; ++i)
+	{
+		U64 sum = U64(mBuckets[i]) + other.mBuckets[i];
+		mBuckets[i] = sum > 0xFFFFFFFF ? 0xFFFFFFFF : U32(sum);
+	}
+	mCount += other.mCount;
+	mSum += other.mSum;
+	if (other.mMin < mMin)
+		mMin = other.mMin;
+	if (other.mMax > mMax)
+		mMax = other.mMax;
+}
+
+U64 Histogram::GetPercentile(double percentile) const
+{
+	if (mCount == 0)
+		return 0;
+
+	U64 target = U64(percentile / 100.0 * mCount + 0.5);
+	if (target < 1)
+		target = 1;
+
+	U64 seen = 0;
+	for (U32 i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += mBuckets[i];
+		if (seen >= target)
+		{
+			U64 value = BucketLow(i) + (BucketHigh(i) - BucketLow(i)) / 2;
+			if (value < mMin)
+				value = mMin;
+			if (value > mMax)
+				value = mMax;
+			return value;
+		}
+	}
+	return mMax;
+}
@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_HISTOGRAM_H
+#define SPIFLASH_HISTOGRAM_H
+
+#include <LogicPublicTypes.h>
+
+// Fixed memory log-linear histogram.
+// Values below 2^SUB_BITS have their own bucket, above that every power of two
+// is split into 2^SUB_BITS linear buckets, so relative error is below 1/2^SUB_BITS.
+// Histograms with same layout can be merged by adding counts.
+class Histogram
+{
+public:
+	enum { SUB_BITS = 4, SUB_COUNT = 1 << SUB_BITS, BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT };
+
+	Histogram() { Clear(); }
+
+	void Clear();
+	void Add(U64 value);
+	void Merge(const Histogram &other);
+
+	U64 GetCount() const { return mCount; }
+	U64 GetSum() const { return mSum; }
+	U64 GetMin() const { return mCount ? mMin : 0; }
+	U64 GetMax() const { return mMax; }
+	double GetMean() const { return mCount ? double(mSum) / mCount : 0.0; }
+	// Value at percentile 0..100, middle of bucket clamped to min/max
+	U64 GetPercentile(double percentile) const;
+
+	static U32 BucketIndex(U64 value);
+	static U64 BucketLow(U32 index);
+	static U64 BucketHigh(U32 index);
+private:
+	U32 mBuckets[BUCKET_COUNT];
+	U64 mCount;
+	U64 mSum;
+	U64 mMin;
+	U64 mMax;
+};
+
+#endif //SPIFLASH_HISTOGRAM_H
@@ -0,0 +1,259 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <cstring>
+#include "SpiFlashLatency.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+// Datasheet style limits in microseconds (typical serial NOR maximums)
+#define PROGRAM_LIMIT_US 3000ULL
+#define REGISTER_WRITE_LIMIT_US 15000ULL
+#define ERASE_4K_LIMIT_US 400000ULL
+#define ERASE_32K_LIMIT_US 1600000ULL
+#define ERASE_64K_LIMIT_US 2000000ULL
+#define ERASE_CHIP_LIMIT_US 200000000ULL
+
+// Maximum for suspend latency, minimums for resume to suspend and power up
+static const U64 latencyLimitUs[LK_COUNT] = { 30, 20, 3 };
+static const bool latencyLimitIsMinimum[LK_COUNT] = { false, true, true };
+
+LatencyTracker::LatencyTracker() : mState(LS_IDLE), mSampleRate(1), mLastBusyRead(0), mSuspendStart(0),
+	mResumeEnd(0), mWrenEnd(0), mPowerUpEnd(0), mUnconfirmed(0)
+{
+	memset(&mOp, 0, sizeof(mOp));
+	memset(mLatencyOutliers, 0, sizeof(mLatencyOutliers));
+}
+
+void LatencyTracker::SetSampleRate(U32 sampleRate)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mSampleRate = sampleRate ? sampleRate : 1;
+}
+
+const char *LatencyTracker::GetLatencyName(LatencyKind kind)
+{
+	switch (kind)
+	{
+	case LK_SUSPEND:
+		return "Suspend latency (tSUS)";
+	case LK_RESUME_TO_SUSPEND:
+		return "Resume to suspend (tRS)";
+	case LK_POWER_UP:
+		return "Release from power down (tRES1)";
+	default:
+		return "";
+	}
+}
+
+U64 LatencyTracker::GetLimit(const SpiCmdData *cmd) const
+{
+	U64 us;
+
+	if (cmd->mEraseSize == ERASE_CHIP)
+		us = ERASE_CHIP_LIMIT_US;
+	else if (cmd->mEraseSize > 0x8000)
+		us = ERASE_64K_LIMIT_US;
+	else if (cmd->mEraseSize > 0x1000)
+		us = ERASE_32K_LIMIT_US;
+	else if (cmd->mEraseSize)
+		us = ERASE_4K_LIMIT_US;
+	else if (cmd->mCmdOp == OP_DATA_WRITE)
+		us = PROGRAM_LIMIT_US;
+	else
+		us = REGISTER_WRITE_LIMIT_US;
+
+	return us * mSampleRate / 1000000;
+}
+
+void LatencyTracker::AddLatency(LatencyKind kind, U64 samples)
+{
+	U64 limit = latencyLimitUs[kind] * mSampleRate / 1000000;
+
+	mLatency[kind].Add(samples);
+	if (latencyLimitIsMinimum[kind] ? samples < limit : samples > limit)
+		mLatencyOutliers[kind]++;
+}
+
+void LatencyTracker::StartOperation(const SpiTransaction &t)
+{
+	memset(&mOp, 0, sizeof(mOp));
+	mOp.mStart = t.mEnd;
+	mOp.mCmdRef = t.mCmdRef;
+	if (t.mHaveAddress)
+	{
+		mOp.mAddress = t.mAddress;
+		mOp.mFlags |= OF_ADDRESS;
+	}
+	if (mWrenEnd && t.mStart >= mWrenEnd)
+		mOp.mWrenGap = t.mStart - mWrenEnd;
+	else
+		mOp.mFlags |= OF_NO_WREN;
+	// Write enable latch is cleared by operation
+	mWrenEnd = 0;
+	mLastBusyRead = 0;
+	mResumeEnd = 0;
+	mState = LS_BUSY;
+}
+
+void LatencyTracker::CompleteOperation(U64 readySample, U8 flags)
+{
+	U64 elapsed = readySample > mOp.mStart ? readySample - mOp.mStart : 0;
+	const SpiCmdData *cmd = spiFlash.GetCommandByRef(mOp.mCmdRef);
+
+	mOp.mBusy = elapsed > mOp.mSuspended ? elapsed - mOp.mSuspended : 0;
+	mOp.mResolution = readySample - std::min(readySample, mLastBusyRead ? mLastBusyRead : mOp.mStart);
+	mOp.mFlags |= flags;
+
+	std::map<U32, LatencyEntry>::iterator i = mEntries.find(mOp.mCmdRef);
+	if (i == mEntries.end())
+	{
+		i = mEntries.insert(std::make_pair(mOp.mCmdRef, LatencyEntry())).first;
+		i->second.mCmdRef = mOp.mCmdRef;
+		i->second.mOutliers = 0;
+		i->second.mLimit = cmd ? GetLimit(cmd) : 0;
+	}
+	LatencyEntry &entry = i->second;
+	entry.mBusy.Add(mOp.mBusy);
+	if (entry.mLimit && mOp.mBusy > entry.mLimit)
+	{
+		mOp.mFlags |= OF_OUTLIER;
+		entry.mOutliers++;
+	}
+	mOperations.push_back(mOp);
+	mState = LS_IDLE;
+}
+
+void LatencyTracker::Add(const SpiTransaction &t)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	const SpiCmdData *cmd = t.mCmd;
+
+	if (mPowerUpEnd)
+	{
+		AddLatency(LK_POWER_UP, t.mStart > mPowerUpEnd ? t.mStart - mPowerUpEnd : 0);
+		mPowerUpEnd = 0;
+	}
+
+	if (cmd == nullptr)
+		return;
+
+	// Status register polling
+	int busy = cmd->GetBusy(t.mData);
+	if (busy >= 0)
+	{
+		// Status bits are shifted out at start of data phase
+		U64 readSample = t.mDataStart ? t.mDataStart : t.mStart;
+		if (mState == LS_BUSY)
+		{
+			if (busy)
+				mLastBusyRead = readSample;
+			else
+				CompleteOperation(readSample, mLastBusyRead ? 0 : OF_NOT_SEEN_BUSY);
+		}
+		else if (mState == LS_SUSPENDING && !busy)
+		{
+			AddLatency(LK_SUSPEND, readSample > mSuspendStart ? readSample - mSuspendStart : 0);
+			mState = LS_SUSPENDED;
+		}
+		return;
+	}
+
+	if (cmd->mRole == ROLE_SUSPEND)
+	{
+		if (mState == LS_BUSY)
+		{
+			if (mResumeEnd)
+				AddLatency(LK_RESUME_TO_SUSPEND, t.mStart > mResumeEnd ? t.mStart - mResumeEnd : 0);
+			mSuspendStart = t.mEnd;
+			mOp.mSuspends++;
+			mState = LS_SUSPENDING;
+		}
+		return;
+	}
+
+	if (cmd->mRole == ROLE_RESUME)
+	{
+		if (mState == LS_SUSPENDING || mState == LS_SUSPENDED)
+		{
+			mOp.mSuspended += t.mEnd - mSuspendStart;
+			mResumeEnd = t.mEnd;
+			// Device is busy again from here
+			mLastBusyRead = t.mEnd;
+			mState = LS_BUSY;
+		}
+		return;
+	}
+
+	// Reads are allowed after suspend, latency is not known when status was not polled
+	if (mState == LS_SUSPENDING)
+		mState = LS_SUSPENDED;
+
+	// Device does not accept other commands while busy, operation had to finish already
+	if (mState == LS_BUSY)
+	{
+		mUnconfirmed++;
+		mState = LS_IDLE;
+	}
+
+	if (cmd->mRole == ROLE_WRITE_ENABLE)
+		mWrenEnd = t.mEnd;
+	else if (cmd->mRole == ROLE_RELEASE_POWER_DOWN)
+		mPowerUpEnd = t.mEnd;
+	else if (cmd->StartsBusyOperation() && mState == LS_IDLE)
+		StartOperation(t);
+}
+
+void LatencyTracker::GetOperations(std::vector<DeviceOperation> &operations) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	operations = mOperations;
+}
+
+void LatencyTracker::GetEntries(std::vector<LatencyEntry> &entries) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	entries.clear();
+	for (std::map<U32, LatencyEntry>::const_iterator i = mEntries.begin(); i != mEntries.end(); ++i)
+		entries.push_back(i->second);
+}
+
+void LatencyTracker::GetLatency(LatencyKind kind, Histogram &histogram, U64 &outliers, U64 &limit) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	histogram = mLatency[kind];
+	outliers = mLatencyOutliers[kind];
+	limit = latencyLimitUs[kind] * mSampleRate / 1000000;
+}
+
+U64 LatencyTracker::GetUnconfirmed() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	return mUnconfirmed;
+}
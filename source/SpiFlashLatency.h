@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_LATENCY_H
+#define SPIFLASH_LATENCY_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+
+#include "SpiFlashHistogram.h"
+
+struct SpiTransaction;
+class SpiCmdData;
+
+enum OperationFlags
+{
+	// Busy time above datasheet style limit
+	OF_OUTLIER = 1,
+	// Operation was not preceded by WREN
+	OF_NO_WREN = 2,
+	OF_ADDRESS = 4,
+	// Device was ready at first status read, busy time is upper bound
+	OF_NOT_SEEN_BUSY = 8,
+};
+
+// Erase/program/register write from command to status showing ready
+struct DeviceOperation
+{
+	// CS inactive after operation command, operation starts here
+	U64 mStart;
+	// Samples device was busy, suspended time excluded
+	U64 mBusy;
+	// Time between last status read showing busy and first showing ready
+	U64 mResolution;
+	// From end of WREN to start of operation command
+	U64 mWrenGap;
+	U64 mSuspended;
+	U32 mCmdRef;
+	U32 mAddress;
+	U16 mSuspends;
+	U8 mFlags;
+};
+
+enum LatencyKind
+{
+	// Suspend command to status showing ready (tSUS)
+	LK_SUSPEND,
+	// Resume to next suspend (tRS)
+	LK_RESUME_TO_SUSPEND,
+	// Release from power down to next command (tRES1)
+	LK_POWER_UP,
+	LK_COUNT,
+};
+
+struct LatencyEntry
+{
+	U32 mCmdRef;
+	Histogram mBusy;
+	U64 mOutliers;
+	// Limit used for outliers, in samples
+	U64 mLimit;
+};
+
+// Follows WREN -> erase/program -> status polling -> ready in decode order.
+// State of operation in flight has fixed size, completed operations are kept
+// as compact records for export.
+class LatencyTracker
+{
+	enum State
+	{
+		LS_IDLE,
+		LS_BUSY,
+		LS_SUSPENDING,
+		LS_SUSPENDED,
+	};
+	State mState;
+	U32 mSampleRate;
+	// Operation in flight
+	DeviceOperation mOp;
+	// Last status read that showed busy, 0 if none yet
+	U64 mLastBusyRead;
+	U64 mSuspendStart;
+	U64 mResumeEnd;
+	U64 mWrenEnd;
+	U64 mPowerUpEnd;
+	// Operations abandoned because other commands show they must have completed
+	U64 mUnconfirmed;
+	std::vector<DeviceOperation> mOperations;
+	std::map<U32, LatencyEntry> mEntries;
+	Histogram mLatency[LK_COUNT];
+	U64 mLatencyOutliers[LK_COUNT];
+	mutable std::mutex mLock;
+
+	void StartOperation(const SpiTransaction &transaction);
+	void CompleteOperation(U64 readySample, U8 flags);
+	void AddLatency(LatencyKind kind, U64 samples);
+	U64 GetLimit(const SpiCmdData *cmd) const;
+public:
+	LatencyTracker();
+
+	void SetSampleRate(U32 sampleRate);
+	void Add(const SpiTransaction &transaction);
+
+	void GetOperations(std::vector<DeviceOperation> &operations) const;
+	void GetEntries(std::vector<LatencyEntry> &entries) const;
+	void GetLatency(LatencyKind kind, Histogram &histogram, U64 &outliers, U64 &limit) const;
+	U64 GetUnconfirmed() const;
+	static const char *GetLatencyName(LatencyKind kind);
+};
+
+#endif //SPIFLASH_LATENCY_H
@@ -0,0 +1,113 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include "SpiFlashParallelExport.h"
+
+ParallelExport::ParallelExport()
+{
+	mThreads = std::thread::hardware_concurrency();
+	if (mThreads == 0)
+		mThreads = 1;
+	else if (mThreads > 16)
+		mThreads = 16;
+}
+
+bool ParallelExport::Run(U64 chunkCount, ChunkFunction fetch, ChunkFunction format, WriteFunction write)
+{
+	// Chunks are reused in circular fashion, index % window
+	const U64 window = U64(mThreads) * 2;
+	std::vector<ExportChunk> chunks(size_t(window < chunkCount ? window : chunkCount));
+	std::vector<bool> ready(chunks.size());
+	std::deque<ExportChunk *> queue;
+	std::mutex lock;
+	std::condition_variable workAvailable;
+	std::condition_variable chunkReady;
+	bool stop = false;
+	bool completed = true;
+	std::vector<std::thread> workers;
+
+	for (unsigned i = 0; i < mThreads && i < chunks.size(); ++i)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			for (;;)
+			{
+				workAvailable.wait(guard, [&]() { return stop || !queue.empty(); });
+				if (stop)
+					break;
+				ExportChunk *chunk = queue.front();
+				queue.pop_front();
+				guard.unlock();
+				format(*chunk);
+				guard.lock();
+				ready[size_t(chunk->mIndex % window)] = true;
+				chunkReady.notify_all();
+			}
+		}));
+	}
+
+	U64 nextFetch = 0;
+	for (U64 nextWrite = 0; nextWrite < chunkCount; ++nextWrite)
+	{
+		// Keep workers busy, never overwrite chunk that was not written yet
+		for (; nextFetch < chunkCount && nextFetch - nextWrite < chunks.size(); ++nextFetch)
+		{
+			ExportChunk &chunk = chunks[size_t(nextFetch % window)];
+			chunk.mIndex = nextFetch;
+			chunk.mFirstFrame = 0;
+			chunk.mFrames.clear();
+			chunk.mText.clear();
+			fetch(chunk);
+			std::lock_guard<std::mutex> guard(lock);
+			ready[size_t(nextFetch % window)] = false;
+			queue.push_back(&chunk);
+			workAvailable.notify_one();
+		}
+
+		ExportChunk &chunk = chunks[size_t(nextWrite % window)];
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			chunkReady.wait(guard, [&]() { return bool(ready[size_t(nextWrite % window)]); });
+		}
+		if (!write(chunk))
+		{
+			completed = false;
+			break;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+		workAvailable.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	return completed;
+}
@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_PARALLEL_EXPORT_H
+#define SPIFLASH_PARALLEL_EXPORT_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <AnalyzerResults.h>
+
+struct ExportChunk
+{
+	U64 mIndex;
+	// Index of first frame in mFrames
+	U64 mFirstFrame;
+	std::vector<Frame> mFrames;
+	// Formatted output
+	std::string mText;
+};
+
+// Export split into chunks:
+// - fetch is called on calling thread in chunk order (SDK calls like GetFrame stay there),
+// - format is called on worker threads and must only use chunk data,
+// - write is called on calling thread in chunk order, returning false stops export.
+// Number of chunks in flight is limited so memory does not grow with export size.
+class ParallelExport
+{
+public:
+	typedef std::function<void(ExportChunk &chunk)> ChunkFunction;
+	typedef std::function<bool(const ExportChunk &chunk)> WriteFunction;
+
+	ParallelExport();
+
+	// Returns false if export was stopped by write function
+	bool Run(U64 chunkCount, ChunkFunction fetch, ChunkFunction format, WriteFunction write);
+
+	static const U64 FRAMES_PER_CHUNK = 16384;
+private:
+	unsigned mThreads;
+};
+
+#endif //SPIFLASH_PARALLEL_EXPORT_H
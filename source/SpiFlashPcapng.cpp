@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SpiFlashPcapng.h"
+
+#define PCAPNG_SHB 0x0A0D0D0A
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_IF_NAME 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+
+static const char ifName[] = "spiflash";
+
+void PcapngWriter::Pad(size_t len)
+{
+	static const U8 zeros[4] = { 0 };
+
+	if (len & 3)
+		Put(zeros, 4 - (len & 3));
+}
+
+void PcapngWriter::WriteHeader()
+{
+	const U32 ifNameLen = U32(sizeof(ifName) - 1);
+	const U32 ifNameOptLen = 4 + ((ifNameLen + 3) & ~3);
+
+	// Section header block
+	Put32(PCAPNG_SHB);
+	Put32(28);
+	Put32(0x1A2B3C4D);
+	Put16(1);
+	Put16(0);
+	// Section length not specified
+	Put32(0xFFFFFFFF);
+	Put32(0xFFFFFFFF);
+	Put32(28);
+
+	// Interface description block with nanosecond time stamps
+	const U32 idbLen = 20 + ifNameOptLen + 8 + 4;
+	Put32(PCAPNG_IDB);
+	Put32(idbLen);
+	Put16(PCAPNG_LINKTYPE_SPIFLASH);
+	Put16(0);
+	Put32(PCAPNG_SPI_HEADER_SIZE + PCAPNG_SNAPLEN);
+	Put16(PCAPNG_OPT_IF_NAME);
+	Put16(U16(ifNameLen));
+	Put(ifName, ifNameLen);
+	Pad(ifNameLen);
+	Put16(PCAPNG_OPT_IF_TSRESOL);
+	Put16(1);
+	Put8(9);
+	Pad(1);
+	Put16(PCAPNG_OPT_END);
+	Put16(0);
+	Put32(idbLen);
+}
+
+void PcapngWriter::WritePacket(U64 timestampNs, const PcapngSpiHeader &header, const U8 *data, size_t len)
+{
+	size_t captured = len > PCAPNG_SNAPLEN ? PCAPNG_SNAPLEN : len;
+	U32 packetLen = U32(PCAPNG_SPI_HEADER_SIZE + captured);
+	// Original length tells readers that data was cut at snap length
+	U64 originalLen = U64(PCAPNG_SPI_HEADER_SIZE) + (header.mDataLength > len ? header.mDataLength : len);
+	U32 blockLen = 28 + ((packetLen + 3) & ~3) + 4;
+
+	// Enhanced packet block
+	Put32(PCAPNG_EPB);
+	Put32(blockLen);
+	Put32(0);
+	Put32(U32(timestampNs >> 32));
+	Put32(U32(timestampNs));
+	Put32(packetLen);
+	Put32(originalLen > 0xFFFFFFFF ? 0xFFFFFFFF : U32(originalLen));
+
+	Put8(header.mVersion);
+	Put8(header.mOpcode);
+	Put8(header.mFlags);
+	Put8(header.mDirection);
+	Put8(header.mCmdLines);
+	Put8(header.mAddressLines);
+	Put8(header.mDataLines);
+	Put8(header.mAddressBits);
+	Put32(header.mAddress);
+	Put32(header.mDataLength);
+	Put32(header.mDigest);
+
+	Put(data, captured);
+	Pad(packetLen);
+	Put32(blockLen);
+}
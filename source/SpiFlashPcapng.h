@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_PCAPNG_H
+#define SPIFLASH_PCAPNG_H
+
+#include <string>
+
+#include <LogicPublicTypes.h>
+
+// LINKTYPE_USER0, packets start with PcapngSpiHeader
+#define PCAPNG_LINKTYPE_SPIFLASH 147
+// Longest data phase stored in single packet, longer ones are truncated
+#define PCAPNG_SNAPLEN 65535
+
+enum PcapngSpiFlags
+{
+	PSF_KNOWN_CMD = 1,
+	PSF_CONTINUOUS_READ = 2,
+	PSF_INCOMPLETE = 4,
+	PSF_ADDRESS = 8,
+	// Run of status reads while busy, address field holds number of reads
+	PSF_POLL_SUMMARY = 16,
+	// Digest field holds CRC-32C of data phase (all bytes, also truncated ones)
+	PSF_DIGEST = 32,
+	// Address, M and data on both clock edges, command too when bit 7 is set
+	PSF_DTR = 64,
+	PSF_DTR_COMMAND = 128,
+};
+
+enum PcapngSpiDirection
+{
+	PSD_NONE = 0,
+	PSD_OUT = 1,
+	PSD_IN = 2,
+	PSD_IN_OUT = 3,
+};
+
+// Header that precedes data of every packet, all fields little endian
+struct PcapngSpiHeader
+{
+	U8 mVersion;
+	U8 mOpcode;
+	U8 mFlags;
+	U8 mDirection;
+	U8 mCmdLines;
+	U8 mAddressLines;
+	U8 mDataLines;
+	U8 mAddressBits;
+	U32 mAddress;
+	// Number of data phase bytes seen on the bus (before truncation)
+	U32 mDataLength;
+	U32 mDigest;
+};
+
+#define PCAPNG_SPI_HEADER_VERSION 2
+#define PCAPNG_SPI_HEADER_SIZE 20
+
+// Formats pcapng blocks into memory, so packets can be prepared on any thread
+class PcapngWriter
+{
+	std::string &mOut;
+
+	void Put(const void *data, size_t len) { mOut.append(static_cast<const char *>(data), len); }
+	void Put8(U8 v) { Put(&v, 1); }
+	void Put16(U16 v) { Put8(U8(v)); Put8(U8(v >> 8)); }
+	void Put32(U32 v) { Put16(U16(v)); Put16(U16(v >> 16)); }
+	void Pad(size_t len);
+public:
+	explicit PcapngWriter(std::string &out) : mOut(out) {}
+
+	void WriteHeader();
+	// Data longer than snap length is cut, header data length gives original packet length
+	void WritePacket(U64 timestampNs, const PcapngSpiHeader &header, const U8 *data, size_t len);
+};
+
+#endif //SPIFLASH_PCAPNG_H
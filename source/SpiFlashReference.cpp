@@ -0,0 +1,239 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstring>
+#include "SpiFlashReference.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+
+MappedFile::MappedFile() : mData(nullptr), mSize(0)
+#ifdef _WIN32
+	, mFile(INVALID_HANDLE_VALUE), mMapping(nullptr)
+#else
+	, mFd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char *path)
+{
+	Close();
+#ifdef _WIN32
+	mFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+	mData = static_cast<const U8 *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	mSize = U64(size.QuadPart);
+#else
+	struct stat st;
+	mFd = open(path, O_RDONLY);
+	if (mFd < 0)
+		return false;
+	if (fstat(mFd, &st) != 0 || st.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, mFd, 0);
+	if (data != MAP_FAILED)
+	{
+		mData = static_cast<const U8 *>(data);
+		// Reads go mostly forward
+		madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+	}
+	mSize = U64(st.st_size);
+#endif
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile = INVALID_HANDLE_VALUE;
+#else
+	if (mData)
+		munmap(const_cast<U8 *>(mData), size_t(mSize));
+	if (mFd >= 0)
+		close(mFd);
+	mFd = -1;
+#endif
+	mData = nullptr;
+	mSize = 0;
+}
+
+ReferenceImage::ReferenceImage()
+{
+	memset(&mTotals, 0, sizeof(mTotals));
+}
+
+bool ReferenceImage::Open(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	memset(&mTotals, 0, sizeof(mTotals));
+	mMismatches.clear();
+	if (path.empty())
+	{
+		mFile.Close();
+		return true;
+	}
+	return mFile.Open(path.c_str());
+}
+
+size_t ReferenceImage::FirstDifference(const U8 *a, const U8 *b, size_t count)
+{
+	size_t i = 0;
+
+#ifdef HAVE_SSE2
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		unsigned differ = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) & 0xFFFF;
+		if (differ)
+		{
+			while ((differ & 1) == 0)
+			{
+				differ >>= 1;
+				i++;
+			}
+			return i;
+		}
+	}
+#else
+	// Eight bytes at a time
+	for (; i + 8 <= count; i += 8)
+	{
+		U64 x;
+		U64 y;
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		if (x != y)
+			break;
+	}
+#endif
+	while (i < count && a[i] == b[i])
+		i++;
+
+	return i;
+}
+
+void ReferenceImage::Add(const SpiTransaction &t)
+{
+	if (t.mCmd == nullptr || t.mCmd->mCmdOp != OP_DATA_READ || !t.mCmd->IsArrayAccess() || !t.mHaveAddress ||
+		t.mData.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (mFile.GetData() == nullptr)
+		return;
+
+	size_t count = t.mData.size();
+	mTotals.mReads++;
+	mTotals.mBytes += count;
+	if (t.mAddress >= mFile.GetSize())
+	{
+		mTotals.mOutsideBytes += count;
+		return;
+	}
+	if (t.mAddress + count > mFile.GetSize())
+	{
+		mTotals.mOutsideBytes += t.mAddress + count - mFile.GetSize();
+		count = size_t(mFile.GetSize() - t.mAddress);
+	}
+
+	const U8 *expected = mFile.GetData() + t.mAddress;
+	const U8 *actual = &t.mData[0];
+	bool mismatch = false;
+	for (size_t i = FirstDifference(expected, actual, count); i < count;
+		i += 1 + FirstDifference(expected + i + 1, actual + i + 1, count - i - 1))
+	{
+		mismatch = true;
+		mTotals.mMismatchedBytes++;
+		if (mMismatches.size() < MAX_MISMATCHES)
+		{
+			ReferenceMismatch m = { t.mId, U32(t.mAddress + i), expected[i], actual[i] };
+			mMismatches.push_back(m);
+		}
+	}
+	if (mismatch)
+		mTotals.mMismatchedReads++;
+}
+
+void ReferenceImage::GetTotals(ReferenceTotals &totals) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	totals = mTotals;
+}
+
+void ReferenceImage::GetMismatches(std::vector<ReferenceMismatch> &mismatches) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mismatches = mMismatches;
+}
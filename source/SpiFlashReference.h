@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_REFERENCE_H
+#define SPIFLASH_REFERENCE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+// Read only memory mapped file
+class MappedFile
+{
+	const U8 *mData;
+	U64 mSize;
+#ifdef _WIN32
+	void *mFile;
+	void *mMapping;
+#else
+	int mFd;
+#endif
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char *path);
+	void Close();
+	const U8 *GetData() const { return mData; }
+	U64 GetSize() const { return mSize; }
+};
+
+struct ReferenceMismatch
+{
+	U64 mTransaction;
+	U32 mAddress;
+	U8 mExpected;
+	U8 mActual;
+};
+
+struct ReferenceTotals
+{
+	U64 mReads;
+	U64 mBytes;
+	U64 mMismatchedReads;
+	U64 mMismatchedBytes;
+	// Read bytes with address above image end
+	U64 mOutsideBytes;
+};
+
+// Compares data of every array read with reference image mapped at address 0
+class ReferenceImage
+{
+	MappedFile mFile;
+	ReferenceTotals mTotals;
+	std::vector<ReferenceMismatch> mMismatches;
+	mutable std::mutex mLock;
+public:
+	enum { MAX_MISMATCHES = 100000 };
+
+	ReferenceImage();
+
+	// Empty path disables comparison
+	bool Open(const std::string &path);
+	bool IsOpen() const { return mFile.GetData() != nullptr; }
+	void Add(const SpiTransaction &transaction);
+
+	void GetTotals(ReferenceTotals &totals) const;
+	void GetMismatches(std::vector<ReferenceMismatch> &mismatches) const;
+	// Index of first differing byte, count if buffers are equal
+	static size_t FirstDifference(const U8 *a, const U8 *b, size_t count);
+};
+
+#endif //SPIFLASH_REFERENCE_H
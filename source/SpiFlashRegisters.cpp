@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SpiFlashRegisters.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+bool RegisterFile::GetField(const char *regName, const char *fieldName, U32 &value) const
+{
+	std::map<std::string, ShadowRegister>::const_iterator i = mRegs.find(regName);
+
+	if (i == mRegs.end())
+		return false;
+
+	RegisterData *reg = i->second.mReg;
+	for (size_t j = 0; j < reg->GetBitfieldCount(); ++j)
+	{
+		if (reg->at(j).mFieldName == fieldName)
+		{
+			value = reg->at(j).GetValue(i->second.mValue);
+			return true;
+		}
+	}
+	return false;
+}
+
+void RegisterFile::Add(const SpiTransaction &t)
+{
+	const SpiCmdData *cmd = t.mCmd;
+
+	if (cmd == nullptr || cmd->mCmdOp != OP_REG_WRITE)
+		return;
+
+	for (size_t i = 0; i < t.mData.size(); ++i)
+	{
+		RegisterData *reg = cmd->GetRegister(i);
+		if (reg == nullptr)
+			break;
+		// Following bytes of longer register, least significant byte first
+		size_t byte = 0;
+		while (byte < i && cmd->GetRegister(i - byte - 1) == reg)
+			byte++;
+		ShadowRegister &shadow = mRegs[reg->GetName()];
+		if (byte == 0)
+			shadow.mValue = 0;
+		shadow.mReg = reg;
+		shadow.mValue |= U64(t.mData[i]) << (8 * byte);
+	}
+}
+
+int RegisterFile::WaitCycles(const SpiCmdData *cmd, U8 busMode) const
+{
+	U32 value;
+
+	if (cmd->mCmdOp != OP_DATA_READ || !cmd->IsArrayAccess() ||
+		(cmd->mDummyCount == 0 && !cmd->mContinuousRead))
+		return -1;
+
+	// Micron, dummy clock cycles of all fast reads, 0 and 15 select default
+	if (GetField("Volatile Configuration Register", "DCC", value) && value != 0 && value != 15)
+		return int(value);
+
+	// Winbond Set Read Parameters, QPI reads take 2, 4, 6 or 8 clocks
+	if (busMode == QUAD && GetField("Read Parameters", "DC", value))
+		return int(value + 1) * 2;
+
+	return -1;
+}
+
+U32 RegisterFile::WrapLength(const SpiCmdData *cmd) const
+{
+	U32 value;
+	U32 disabled;
+
+	if (cmd->mRole == ROLE_READ_WRAP)
+	{
+		if (GetField("Read Parameters", "WL", value) || GetField("Burst Length", "WL", value))
+			return 8 << value;
+		// Power up default
+		return 8;
+	}
+
+	// Macronix, burst length applies to all reads once enabled
+	if (cmd->mCmdOp == OP_DATA_READ && cmd->IsArrayAccess() && GetField("Burst Length", "WD", disabled) &&
+		!disabled && GetField("Burst Length", "WL", value))
+		return 8 << value;
+
+	return 0;
+}
+
+bool RegisterFile::QuadDisabled() const
+{
+	std::map<std::string, ShadowRegister>::const_iterator i;
+	U32 value;
+
+	for (i = mRegs.begin(); i != mRegs.end(); ++i)
+		if (GetField(i->first.c_str(), "QE", value) && value == 0)
+			return true;
+	return false;
+}
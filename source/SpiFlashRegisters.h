@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_REGISTERS_H
+#define SPIFLASH_REGISTERS_H
+
+#include <string>
+#include <map>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+class SpiCmdData;
+class RegisterData;
+
+// Values written to device registers during capture (volatile state as device sees it).
+// Decoder takes dummy clocks and wrap length from here, registers that were not
+// written keep values from command definitions.
+class RegisterFile
+{
+	struct ShadowRegister
+	{
+		RegisterData *mReg;
+		U64 mValue;
+	};
+	// By register name, same name in parent and child command set is one register
+	std::map<std::string, ShadowRegister> mRegs;
+
+	bool GetField(const char *regName, const char *fieldName, U32 &value) const;
+public:
+	void Clear() { mRegs.clear(); }
+	// Register bytes written by decoded transaction
+	void Add(const SpiTransaction &transaction);
+
+	// Clocks from end of address to data (M bits included), -1 when not set by registers
+	int WaitCycles(const SpiCmdData *cmd, U8 busMode) const;
+	// Wrap length in bytes for burst read, 0 for linear read
+	U32 WrapLength(const SpiCmdData *cmd) const;
+	// QE bit was written as 0, quad commands are not accepted by device
+	bool QuadDisabled() const;
+};
+
+#endif //SPIFLASH_REGISTERS_H
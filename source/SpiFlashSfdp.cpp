@@ -0,0 +1,213 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SpiFlashSfdp.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+// "SFDP" read as little endian DWORD
+#define SFDP_SIGNATURE 0x50444653
+// Parameter IDs (MSB << 8 | LSB)
+#define SFDP_BASIC_TABLE 0xFF00
+#define SFDP_4BYTE_ADDRESS_TABLE 0xFF84
+
+SfdpTable::SfdpTable()
+{
+	Clear();
+}
+
+void SfdpTable::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mData.assign(MAX_SIZE, 0);
+	mKnown.assign(MAX_SIZE, false);
+	mParams = SfdpParameters();
+	mParams.mValid = false;
+}
+
+bool SfdpTable::GetDword(U32 address, U32 &value) const
+{
+	value = 0;
+	if (address + 4 > MAX_SIZE)
+		return false;
+	for (U32 i = 0; i < 4; ++i)
+	{
+		if (!mKnown[address + i])
+			return false;
+		value |= U32(mData[address + i]) << (8 * i);
+	}
+	return true;
+}
+
+static void AddFastRead(SfdpParameters &p, U8 cmdLines, U8 addressLines, U8 dataLines, U32 field)
+{
+	// Dummy clocks 4:0, mode clocks 7:5, instruction 15:8
+	SfdpFastRead read = { cmdLines, addressLines, dataLines, U8(field >> 8), U8((field >> 5) & 7), U8(field & 0x1F) };
+
+	if (read.mOpcode != 0 && read.mOpcode != 0xFF)
+		p.mFastReads.push_back(read);
+}
+
+void SfdpTable::Parse()
+{
+	SfdpParameters p = SfdpParameters();
+	U32 signature;
+	U32 header;
+
+	if (!GetDword(0, signature) || signature != SFDP_SIGNATURE || !GetDword(4, header))
+		return;
+
+	U32 headers = ((header >> 16) & 0xFF) + 1;
+	for (U32 i = 0; i < headers; ++i)
+	{
+		U32 h0;
+		U32 h1;
+		if (!GetDword(8 + 8 * i, h0) || !GetDword(12 + 8 * i, h1))
+			continue;
+		U32 id = ((h1 >> 24) << 8) | (h0 & 0xFF);
+		U32 length = h0 >> 24;
+		U32 pointer = h1 & 0xFFFFFF;
+		std::vector<U32> dw;
+		U32 value;
+		// DWORDs are numbered from 1 in JESD216, dw[0] is DWORD 1
+		while (dw.size() < length && GetDword(pointer + 4 * U32(dw.size()), value))
+			dw.push_back(value);
+
+		// First basic table is the one for whole device
+		if (id == SFDP_BASIC_TABLE && !p.mValid && dw.size() >= 9)
+		{
+			p.mValid = true;
+			p.mMajor = U8(h0 >> 16);
+			p.mMinor = U8(h0 >> 8);
+			p.mDwords = U32(dw.size());
+			switch ((dw[0] >> 17) & 3)
+			{
+			case 0:
+				p.mAddressBytes = SFDP_ADDRESS_3;
+				break;
+			case 2:
+				p.mAddressBytes = SFDP_ADDRESS_4;
+				break;
+			default:
+				p.mAddressBytes = SFDP_ADDRESS_3_OR_4;
+				break;
+			}
+			if (dw[1] & 0x80000000)
+				p.mDensityBits = (dw[1] & 0x7FFFFFFF) < 64 ? U64(1) << (dw[1] & 0x7FFFFFFF) : 0;
+			else
+				p.mDensityBits = U64(dw[1]) + 1;
+			if (dw[0] & (1 << 16))
+				AddFastRead(p, 1, 1, 2, dw[3]);
+			if (dw[0] & (1 << 20))
+				AddFastRead(p, 1, 2, 2, dw[3] >> 16);
+			if (dw[0] & (1 << 22))
+				AddFastRead(p, 1, 1, 4, dw[2] >> 16);
+			if (dw[0] & (1 << 21))
+				AddFastRead(p, 1, 4, 4, dw[2]);
+			if (dw[4] & (1 << 0))
+				AddFastRead(p, 2, 2, 2, dw[5] >> 16);
+			if (dw[4] & (1 << 4))
+				AddFastRead(p, 4, 4, 4, dw[6] >> 16);
+			// JESD216A and later
+			if (dw.size() >= 11)
+				p.mPageSize = 1 << ((dw[10] >> 4) & 0xF);
+			if (dw.size() >= 16)
+			{
+				p.mEnter4Byte = (dw[15] >> 14) & 0x3FF;
+				p.mExit4Byte = (dw[15] >> 24) & 0xFF;
+			}
+		}
+		else if (id == SFDP_4BYTE_ADDRESS_TABLE && dw.size() >= 1)
+		{
+			p.mHave4ByteTable = true;
+			p.m4ByteInstructions = dw[0];
+		}
+	}
+	mParams = p;
+}
+
+void SfdpTable::Add(const SpiTransaction &t)
+{
+	if (t.mCmd == nullptr || t.mCmd->mRole != ROLE_READ_SFDP || !t.mHaveAddress || t.mData.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	for (size_t i = 0; i < t.mData.size() && t.mAddress + i < MAX_SIZE; ++i)
+	{
+		mData[t.mAddress + i] = t.mData[i];
+		mKnown[t.mAddress + i] = true;
+	}
+	Parse();
+}
+
+void SfdpTable::GetParameters(SfdpParameters &params) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	params = mParams;
+}
+
+int SfdpTable::WaitCycles(const SpiCmdData *cmd, U8 busMode) const
+{
+	if (cmd->mCmdOp != OP_DATA_READ || !cmd->IsArrayAccess() || cmd->mDtr)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (!mParams.mValid)
+		return -1;
+
+	U8 addressLines = cmd->mModeArgs ? cmd->mModeArgs : busMode;
+	U8 dataLines = cmd->mModeData ? cmd->mModeData : addressLines;
+	for (size_t i = 0; i < mParams.mFastReads.size(); ++i)
+	{
+		const SfdpFastRead &r = mParams.mFastReads[i];
+		if (r.mOpcode == cmd->GetCode() && r.mCmdLines == busMode && r.mAddressLines == addressLines &&
+			r.mDataLines == dataLines)
+			return r.mModeClocks + r.mDummyClocks;
+	}
+	return -1;
+}
+
+U32 SfdpTable::FixedAddressLength() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (!mParams.mValid)
+		return 0;
+	// Always operates in 4-byte address mode
+	if (mParams.mAddressBytes == SFDP_ADDRESS_4 || (mParams.mEnter4Byte & 0x40))
+		return 32;
+	if (mParams.mAddressBytes == SFDP_ADDRESS_3)
+		return 24;
+	return 0;
+}
+
+U32 SfdpTable::PageSize() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	return mParams.mValid && mParams.mPageSize ? mParams.mPageSize : 256;
+}
@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_SFDP_H
+#define SPIFLASH_SFDP_H
+
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+class SpiCmdData;
+
+// Fast read instruction listed in Basic Flash Parameter Table
+struct SfdpFastRead
+{
+	// Lines used for command, address and data (1-1-4, 4-4-4, ...)
+	U8 mCmdLines;
+	U8 mAddressLines;
+	U8 mDataLines;
+	U8 mOpcode;
+	U8 mModeClocks;
+	U8 mDummyClocks;
+};
+
+enum SfdpAddressBytes
+{
+	SFDP_ADDRESS_3,
+	SFDP_ADDRESS_3_OR_4,
+	SFDP_ADDRESS_4,
+};
+
+// Device parameters found in SFDP (JESD216)
+struct SfdpParameters
+{
+	// Basic Flash Parameter Table was read completely (at least 9 DWORDs)
+	bool mValid;
+	U8 mMajor;
+	U8 mMinor;
+	// DWORDs of table that were read
+	U32 mDwords;
+	SfdpAddressBytes mAddressBytes;
+	U64 mDensityBits;
+	std::vector<SfdpFastRead> mFastReads;
+	// 0 when table does not have 11th DWORD
+	U32 mPageSize;
+	// DWORD 16 enter and exit 4-byte addressing methods, 0 when not present
+	U32 mEnter4Byte;
+	U32 mExit4Byte;
+	// 4-byte Address Instruction Table DWORD 1, support bit for each instruction
+	bool mHave4ByteTable;
+	U32 m4ByteInstructions;
+};
+
+// SFDP space as seen in captured Read SFDP (0x5A) transactions. When Basic Flash
+// Parameter Table is complete its values are used for decoding following transactions.
+class SfdpTable
+{
+	// Bytes of SFDP space read so far
+	std::vector<U8> mData;
+	std::vector<bool> mKnown;
+	SfdpParameters mParams;
+	mutable std::mutex mLock;
+
+	bool GetDword(U32 address, U32 &value) const;
+	void Parse();
+public:
+	// SFDP space above this is not stored
+	enum { MAX_SIZE = 0x1000 };
+
+	SfdpTable();
+
+	void Clear();
+	// Data of Read SFDP transaction
+	void Add(const SpiTransaction &transaction);
+
+	void GetParameters(SfdpParameters &params) const;
+	// Clocks from end of address to data (mode clocks included) of fast read
+	// listed in SFDP, -1 when command is not listed
+	int WaitCycles(const SpiCmdData *cmd, U8 busMode) const;
+	// 24 or 32 when device uses only one address length, 0 otherwise
+	U32 FixedAddressLength() const;
+	// Program page size, 256 when not known
+	U32 PageSize() const;
+};
+
+#endif //SPIFLASH_SFDP_H
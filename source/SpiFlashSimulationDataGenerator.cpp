@@ -52,8 +52,14 @@ void SpiFlashSimulationDataGenerator::Initialize(U32 simulation_sample_rate, Spi
 	mClockGenerator.Init(target_frequency, simulation_sample_rate);
 	spiFlash.SetSpiMode(mSettings->mSpiMode == 3 ? SPI_MODE3 : SPI_MODE0);
 	spiFlash.SetCurrentCommand(nullptr);
-	spiFlash.SetCurrentBusMode(BusMode(mSettings->mBusMode));
-	spiFlash.SetDefaultBusMode(BusMode(mSettings->mBusMode));
+	BusMode busMode = BusMode(mSettings->mBusMode & ~BUS_MODE_DTR);
+	// Simulation has no D4-D7 lines, auto start is single
+	if (busMode == OCTAL || busMode == 0)
+		busMode = SINGLE;
+	spiFlash.SetCurrentBusMode(busMode);
+	spiFlash.SetDefaultBusMode(busMode);
+	spiFlash.SetDtrProtocol((mSettings->mBusMode & BUS_MODE_DTR) != 0);
+	spiFlash.SetAddressBits(mSettings->mAddressLength);
 
 	if (settings->mChipSelect.mChannelIndex < 1000)
 		mChipSelectSimulationData = mSimulationChannels.Add(settings->mChipSelect, mSimulationSampleRateHz, BIT_HIGH);
@@ -0,0 +1,161 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstring>
+#include "SpiFlashTimeline.h"
+#include "SpiFlashTransactionIndex.h"
+
+Timeline::Timeline() : mTotalBlocks(0), mMinLevel(0), mBaseShift(0), mLastSample(0)
+{
+	memset(mBlocks, 0, sizeof(mBlocks));
+}
+
+void Timeline::SetSampleRate(U32 sampleRate)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mBaseShift = 0;
+	while ((U64(1) << mBaseShift) * 100000 < sampleRate)
+		mBaseShift++;
+}
+
+void Timeline::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	for (int i = 0; i < MAX_LEVELS; ++i)
+		mLevels[i].clear();
+	memset(mBlocks, 0, sizeof(mBlocks));
+	mTotalBlocks = 0;
+	mMinLevel = 0;
+	mLastSample = 0;
+}
+
+TimelineBucket &Timeline::GetBucket(int level, U64 index)
+{
+	Level &blocks = mLevels[level];
+	size_t block = size_t(index >> BLOCK_SHIFT);
+
+	if (block >= blocks.size())
+		blocks.resize(block + 1);
+	if (!blocks[block])
+	{
+		blocks[block].reset(new TimelineBucket[BLOCK_SIZE]);
+		memset(blocks[block].get(), 0, sizeof(TimelineBucket) * BLOCK_SIZE);
+		mBlocks[level]++;
+		mTotalBlocks++;
+	}
+	return blocks[block][index & (BLOCK_SIZE - 1)];
+}
+
+const TimelineBucket *Timeline::FindBucket(int level, U64 index) const
+{
+	const Level &blocks = mLevels[level];
+	size_t block = size_t(index >> BLOCK_SHIFT);
+
+	if (block >= blocks.size() || !blocks[block])
+		return nullptr;
+	return &blocks[block][index & (BLOCK_SIZE - 1)];
+}
+
+void Timeline::Add(const SpiTransaction &t)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (t.mEnd > mLastSample)
+		mLastSample = t.mEnd;
+
+	for (int level = mMinLevel; level < MAX_LEVELS; ++level)
+	{
+		int shift = mBaseShift + level;
+		U64 first = t.mStart >> shift;
+		U64 last = t.mEnd >> shift;
+		TimelineBucket &b = GetBucket(level, first);
+
+		b.mTransactions++;
+		b.mBytes += t.mByteCount;
+		b.mPayloadBits += t.mPayloadBits;
+		b.mOverheadBits += t.mOverheadBits;
+		b.mClockCycles += t.mClockCycles;
+		b.mClockSamples += t.mLastClock - t.mFirstClock;
+		b.mGapSamples += t.mGapSum;
+		b.mGapCount += t.mGapCount;
+		if (t.mGapMax > b.mGapMax)
+			b.mGapMax = t.mGapMax;
+
+		// Split busy time between buckets
+		for (U64 i = first; i <= last; ++i)
+		{
+			U64 from = i == first ? t.mStart : i << shift;
+			U64 to = i == last ? t.mEnd : ((i + 1) << shift);
+			GetBucket(level, i).mBusySamples += to - from;
+		}
+	}
+
+	// Fine levels of long capture take most memory, next level has half of buckets
+	while (mTotalBlocks > MAX_BLOCKS && mMinLevel < MAX_LEVELS - 1)
+	{
+		mLevels[mMinLevel].clear();
+		mTotalBlocks -= mBlocks[mMinLevel];
+		mBlocks[mMinLevel] = 0;
+		mMinLevel++;
+	}
+}
+
+U64 Timeline::GetLastSample() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	return mLastSample;
+}
+
+int Timeline::GetLevel(U64 first, U64 last, U64 maxBuckets) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	int level;
+
+	if (maxBuckets == 0)
+		maxBuckets = 1;
+	for (level = mMinLevel; level < MAX_LEVELS - 1; ++level)
+	{
+		int shift = mBaseShift + level;
+		if ((last >> shift) - (first >> shift) + 1 <= maxBuckets)
+			break;
+	}
+	return level;
+}
+
+void Timeline::Get(int level, U64 first, U64 last, std::vector<TimelineBucket> &buckets) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	int shift = mBaseShift + level;
+	TimelineBucket empty;
+
+	memset(&empty, 0, sizeof(empty));
+	buckets.clear();
+	for (U64 i = first >> shift; i <= last >> shift; ++i)
+	{
+		const TimelineBucket *b = FindBucket(level, i);
+		buckets.push_back(b ? *b : empty);
+	}
+}
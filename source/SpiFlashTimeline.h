@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_TIMELINE_H
+#define SPIFLASH_TIMELINE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+struct TimelineBucket
+{
+	U64 mTransactions;
+	U64 mBytes;
+	U64 mPayloadBits;
+	U64 mOverheadBits;
+	// Samples with CS active
+	U64 mBusySamples;
+	U64 mClockCycles;
+	// Samples between first and last clock edge of transactions
+	U64 mClockSamples;
+	U64 mGapSamples;
+	U64 mGapCount;
+	U64 mGapMax;
+};
+
+// Bus utilisation over time.
+// Same data is kept at every power of two bucket size (level n bucket is
+// 2^n base buckets) so any time range can be returned with bounded number
+// of buckets without summing. Buckets are allocated in blocks only where
+// there was traffic.
+// Busy time is split between buckets that transaction overlaps, all other
+// counters go to bucket where transaction started.
+// When blocks of all levels take more than MAX_BLOCKS finest level is dropped,
+// so memory stays bounded on long captures and coarser levels still cover all.
+class Timeline
+{
+	enum { BLOCK_SHIFT = 12, BLOCK_SIZE = 1 << BLOCK_SHIFT, MAX_LEVELS = 32, MAX_BLOCKS = 64 };
+	typedef std::vector<std::unique_ptr<TimelineBucket[]>> Level;
+	Level mLevels[MAX_LEVELS];
+	size_t mBlocks[MAX_LEVELS];
+	size_t mTotalBlocks;
+	// Finest level still kept
+	int mMinLevel;
+	// Base bucket size is 2^mBaseShift samples
+	int mBaseShift;
+	U64 mLastSample;
+	mutable std::mutex mLock;
+
+	TimelineBucket &GetBucket(int level, U64 index);
+	const TimelineBucket *FindBucket(int level, U64 index) const;
+public:
+	Timeline();
+
+	// Base bucket about 10us, top level bucket covers hours
+	void SetSampleRate(U32 sampleRate);
+	void Clear();
+	void Add(const SpiTransaction &transaction);
+
+	U64 GetBucketSamples(int level) const { return U64(1) << (mBaseShift + level); }
+	U64 GetLastSample() const;
+	// Finest kept level that covers [first, last] with no more than maxBuckets
+	int GetLevel(U64 first, U64 last, U64 maxBuckets) const;
+	// Buckets of given level from one containing first to one containing last,
+	// empty ones included
+	void Get(int level, U64 first, U64 last, std::vector<TimelineBucket> &buckets) const;
+};
+
+#endif //SPIFLASH_TIMELINE_H
@@ -0,0 +1,165 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include "SpiFlashTiming.h"
+#include "SpiFlashTransactionIndex.h"
+
+void TimingMargins::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mPendingCount = 0;
+	for (int k = 0; k < MK_COUNT; ++k)
+	{
+		for (int i = 0; i < MODE_COUNT; ++i)
+			mByMode[k][i].Clear();
+		for (int i = 0; i < LINE_COUNT; ++i)
+			mByLine[k][i].Clear();
+		mCs[k].Clear();
+	}
+	mWorst.clear();
+	StartTransaction();
+}
+
+void TimingMargins::StartTransaction()
+{
+	for (int k = 0; k < MK_COUNT; ++k)
+	{
+		mCurrent.mMargin[k] = ~U64(0);
+		mCurrent.mMode[k] = 0;
+		mCurrent.mLine[k] = 0;
+		mCurrent.mCsMargin[k] = ~U64(0);
+	}
+}
+
+void TimingMargins::FoldPending()
+{
+	for (size_t i = 0; i < mPendingCount; ++i)
+	{
+		U64 p = mPending[i];
+		int kind = int(p >> 6) & 1;
+		mByMode[kind][(p >> 3) & 7].Add(p >> 7);
+		mByLine[kind][p & 7].Add(p >> 7);
+	}
+	mPendingCount = 0;
+}
+
+void TimingMargins::Add(const SpiTransaction &t, bool haveCs)
+{
+	TimingRecord r = mCurrent;
+
+	r.mTransaction = t.mId;
+	r.mSample = t.mStart;
+	// Transaction cut by end of capture has no CS end
+	if (haveCs && t.mFirstClock > t.mStart)
+		r.mCsMargin[MK_SETUP] = t.mFirstClock - t.mStart;
+	if (haveCs && t.mEnd > t.mLastClock)
+		r.mCsMargin[MK_HOLD] = t.mEnd - t.mLastClock;
+	StartTransaction();
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	FoldPending();
+	for (int k = 0; k < MK_COUNT; ++k)
+		if (r.mCsMargin[k] != ~U64(0))
+			mCs[k].Add(r.mCsMargin[k]);
+	if (r.mMargin[MK_SETUP] != ~U64(0) || r.mMargin[MK_HOLD] != ~U64(0))
+		AddWorst(r);
+}
+
+static U64 WorstMargin(const TimingRecord &r)
+{
+	return std::min(r.mMargin[MK_SETUP], r.mMargin[MK_HOLD]);
+}
+
+static bool SmallerMargin(const TimingRecord &a, const TimingRecord &b)
+{
+	return WorstMargin(a) < WorstMargin(b);
+}
+
+void TimingMargins::AddWorst(const TimingRecord &record)
+{
+	if (mWorst.size() < MAX_WORST)
+	{
+		mWorst.push_back(record);
+		return;
+	}
+	// Replace best of kept records, only worse transactions get in once list is full
+	size_t best = 0;
+	for (size_t i = 1; i < mWorst.size(); ++i)
+		if (WorstMargin(mWorst[i]) > WorstMargin(mWorst[best]))
+			best = i;
+	if (WorstMargin(record) < WorstMargin(mWorst[best]))
+		mWorst[best] = record;
+}
+
+void TimingMargins::GetByMode(MarginKind kind, U32 mode, Histogram &histogram) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	histogram = mByMode[kind][mode];
+}
+
+void TimingMargins::GetByLine(MarginKind kind, U32 line, Histogram &histogram) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	histogram = mByLine[kind][line];
+}
+
+void TimingMargins::GetCs(MarginKind kind, Histogram &histogram) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	histogram = mCs[kind];
+}
+
+void TimingMargins::GetWorst(std::vector<TimingRecord> &worst) const
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		worst = mWorst;
+	}
+	std::stable_sort(worst.begin(), worst.end(), SmallerMargin);
+}
+
+U32 TimingMargins::ModeIndex(U32 busMode, bool dtr)
+{
+	U32 index = busMode >= 8 ? 3 : busMode >= 4 ? 2 : busMode >= 2 ? 1 : 0;
+
+	return dtr ? index + 4 : index;
+}
+
+const char *TimingMargins::GetModeName(U32 mode)
+{
+	static const char *names[MODE_COUNT] = { "Single", "Dual", "Quad", "Octal",
+		"Single DTR", "Dual DTR", "Quad DTR", "Octal DTR" };
+
+	return mode < MODE_COUNT ? names[mode] : "";
+}
+
+const char *TimingMargins::GetKindName(MarginKind kind)
+{
+	return kind == MK_SETUP ? "Setup" : "Hold";
+}
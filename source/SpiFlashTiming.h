@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_TIMING_H
+#define SPIFLASH_TIMING_H
+
+#include <vector>
+#include <mutex>
+
+#include "SpiFlashHistogram.h"
+
+struct SpiTransaction;
+
+enum MarginKind
+{
+	// Last data transition to sampling edge
+	MK_SETUP,
+	// Sampling edge to first data transition after it
+	MK_HOLD,
+	MK_COUNT,
+};
+
+// Worst margins of one transaction in samples, ~0 when not measured
+struct TimingRecord
+{
+	U64 mTransaction;
+	U64 mSample;
+	U64 mMargin[MK_COUNT];
+	U8 mMode[MK_COUNT];
+	U8 mLine[MK_COUNT];
+	// CS active to first clock, last clock to CS inactive
+	U64 mCsMargin[MK_COUNT];
+};
+
+// Setup/hold margins of data lines around sampling edges, per bus mode and per line.
+// Decoder adds margins without locking into small fixed buffer that is folded into
+// histograms when full and when transaction ends, worst margins of transaction being
+// decoded are kept as running minimum.
+class TimingMargins
+{
+public:
+	enum { MODE_COUNT = 8, LINE_COUNT = 8, MAX_WORST = 100, MAX_PENDING = 256 };
+private:
+	// margin << 7 | kind << 6 | mode << 3 | line
+	U64 mPending[MAX_PENDING];
+	size_t mPendingCount;
+	// Transaction being decoded
+	TimingRecord mCurrent;
+	Histogram mByMode[MK_COUNT][MODE_COUNT];
+	Histogram mByLine[MK_COUNT][LINE_COUNT];
+	Histogram mCs[MK_COUNT];
+	std::vector<TimingRecord> mWorst;
+	mutable std::mutex mLock;
+
+	void FoldPending();
+	void AddWorst(const TimingRecord &record);
+public:
+	TimingMargins() : mPendingCount(0) { StartTransaction(); }
+
+	void Clear();
+	// Margin of data line sampled at clock edge, mode from ModeIndex()
+	void AddMargin(MarginKind kind, U32 mode, U32 line, U64 margin)
+	{
+		if (margin < mCurrent.mMargin[kind])
+		{
+			mCurrent.mMargin[kind] = margin;
+			mCurrent.mMode[kind] = U8(mode);
+			mCurrent.mLine[kind] = U8(line);
+		}
+		mPending[mPendingCount++] = margin << 7 | U64(kind) << 6 | mode << 3 | line;
+		if (mPendingCount == MAX_PENDING)
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			FoldPending();
+		}
+	}
+	// Worst margins so far do not belong to transaction that starts
+	void StartTransaction();
+	// Transaction is complete, CS margins come from its first and last clock
+	void Add(const SpiTransaction &transaction, bool haveCs);
+
+	void GetByMode(MarginKind kind, U32 mode, Histogram &histogram) const;
+	void GetByLine(MarginKind kind, U32 line, Histogram &histogram) const;
+	void GetCs(MarginKind kind, Histogram &histogram) const;
+	// Transactions with smallest data margin, smallest first
+	void GetWorst(std::vector<TimingRecord> &worst) const;
+
+	// Single, dual, quad, octal, then same with DTR
+	static U32 ModeIndex(U32 busMode, bool dtr);
+	static const char *GetModeName(U32 mode);
+	static const char *GetKindName(MarginKind kind);
+};
+
+#endif //SPIFLASH_TIMING_H
@@ -0,0 +1,74 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SpiFlashTransactionIndex.h"
+
+U64 TransactionIndex::Add(U64 firstFrame, U64 lastFrame, const SpiTransaction &transaction)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	U64 id = mCount;
+	size_t block = size_t(id >> BLOCK_SHIFT);
+	if (block >= mBlocks.size())
+		mBlocks.push_back(std::unique_ptr<TransactionEntry[]>(new TransactionEntry[BLOCK_SIZE]));
+
+	TransactionEntry &entry = mBlocks[block][id & (BLOCK_SIZE - 1)];
+	entry.mFirstFrame = firstFrame;
+	entry.mFrameCount = U32(lastFrame - firstFrame + 1);
+	entry.mOpcode = transaction.mOpcode;
+	entry.mBusMode = transaction.mBusMode;
+	entry.mReserved = 0;
+	entry.mClockCycles = transaction.mClockCycles;
+	U64 span = transaction.mLastClock - transaction.mFirstClock;
+	entry.mClockSpan = span > 0xFFFFFFFF ? 0xFFFFFFFF : U32(span);
+	mCount++;
+
+	return id;
+}
+
+bool TransactionIndex::Get(U64 id, TransactionEntry &entry) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (id >= mCount)
+		return false;
+
+	entry = mBlocks[size_t(id >> BLOCK_SHIFT)][id & (BLOCK_SIZE - 1)];
+
+	return true;
+}
+
+U64 TransactionIndex::GetCount() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	return mCount;
+}
+
+void TransactionIndex::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mBlocks.clear();
+	mCount = 0;
+}
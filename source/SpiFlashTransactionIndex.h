@@ -0,0 +1,131 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_TRANSACTION_INDEX_H
+#define SPIFLASH_TRANSACTION_INDEX_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+class SpiCmdData;
+
+// Everything known about one decoded transaction, built from its frames
+// and passed to analyses when transaction ends
+struct SpiTransaction
+{
+	U64 mId;
+	// CS active .. CS inactive
+	U64 mStart;
+	U64 mEnd;
+	// First and last clock edge of all phases
+	U64 mFirstClock;
+	U64 mLastClock;
+	// Start of data phase, 0 if there was no data
+	U64 mDataStart;
+	const SpiCmdData *mCmd;
+	U32 mCmdRef;
+	U8 mOpcode;
+	// Device (CS line) index, from command reference
+	U8 mDevice;
+	// Command set that decoded transaction, from command reference
+	U8 mCmdSetId;
+	// Lines used for command
+	U8 mBusMode;
+	// Command byte sampled on both clock edges (4D-4D-4D)
+	bool mCmdDtr;
+	// Command byte was not on the bus (continuous read)
+	bool mContinuous;
+	bool mHaveAddress;
+	// Address length of commands without fixed length (24 or 32)
+	U8 mAddressBits;
+	U32 mAddress;
+	// Bytes in data phase (both directions for unknown commands)
+	U32 mByteCount;
+	// Wrap length of burst read set by registers, 0 for linear read
+	U32 mWrapLength;
+	// Program page size (from SFDP)
+	U32 mPageSize;
+	U32 mPayloadBits;
+	// Command, address, M and dummy bits
+	U32 mOverheadBits;
+	U32 mClockCycles;
+	// Gaps between consecutive bytes/fields, in samples
+	U64 mGapSum;
+	U32 mGapCount;
+	U32 mGapMax;
+	// Data phase bytes, MOSI and MISO interleaved for unknown commands
+	std::vector<U8> mData;
+
+	void Clear()
+	{
+		mId = mStart = mEnd = mFirstClock = mLastClock = mDataStart = 0;
+		mCmd = nullptr;
+		mCmdRef = 0;
+		mOpcode = mDevice = mCmdSetId = mBusMode = 0;
+		mAddressBits = 24;
+		mPageSize = 256;
+		mCmdDtr = mContinuous = mHaveAddress = false;
+		mAddress = mByteCount = mWrapLength = mPayloadBits = mOverheadBits = mClockCycles = 0;
+		mGapSum = 0;
+		mGapCount = mGapMax = 0;
+		mData.clear();
+	}
+};
+
+struct TransactionEntry
+{
+	// Index of first frame that belongs to transaction
+	U64 mFirstFrame;
+	// Number of frames, last one is always FT_CMD or FT_POLL frame
+	U32 mFrameCount;
+	U8 mOpcode;
+	U8 mBusMode;
+	U16 mReserved;
+	U32 mClockCycles;
+	// Samples from first to last clock edge
+	U32 mClockSpan;
+
+	U64 GetLastFrame() const { return mFirstFrame + mFrameCount - 1; }
+};
+
+// Transaction ID -> frame range, filled by worker thread and read by UI
+class TransactionIndex
+{
+	// Entries live in fixed size blocks so adding never moves existing ones
+	enum { BLOCK_SHIFT = 16, BLOCK_SIZE = 1 << BLOCK_SHIFT };
+	std::vector<std::unique_ptr<TransactionEntry[]>> mBlocks;
+	U64 mCount;
+	mutable std::mutex mLock;
+public:
+	TransactionIndex() : mCount(0) {}
+
+	U64 Add(U64 firstFrame, U64 lastFrame, const SpiTransaction &transaction);
+	bool Get(U64 id, TransactionEntry &entry) const;
+	U64 GetCount() const;
+	void Clear();
+};
+
+#endif //SPIFLASH_TRANSACTION_INDEX_H
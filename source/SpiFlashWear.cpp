@@ -0,0 +1,265 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "SpiFlashWear.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+#define HEAT_MAP_COLUMNS 128
+#define HEAT_MAP_SCALE 4
+
+template<typename T> static void SaturatingAdd(T &counter, U32 value)
+{
+	U64 sum = U64(counter) + value;
+	counter = sum > T(~T(0)) ? T(~T(0)) : T(sum);
+}
+
+WearMap::WearMap() : mCapacity(0)
+{
+	Configure(0x1000000);
+}
+
+void WearMap::Configure(U32 capacity)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mCapacity = std::max<U32>(capacity, BLOCK_SIZE);
+	mSectorErases.assign(mCapacity / SECTOR_SIZE, 0);
+	mBlockErases.assign(mCapacity / BLOCK_SIZE, 0);
+	mProgrammed.assign(mCapacity / SECTOR_SIZE, 0);
+	memset(&mTotals, 0, sizeof(mTotals));
+}
+
+void WearMap::Add(const SpiTransaction &t)
+{
+	const SpiCmdData *cmd = t.mCmd;
+
+	if (cmd == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (cmd->mEraseSize == ERASE_CHIP)
+	{
+		// Applied to all sectors when counters are read
+		mTotals.mChipErases++;
+	}
+	else if (cmd->mEraseSize && t.mHaveAddress && cmd->IsArrayAccess())
+	{
+		U32 size = std::max<U32>(cmd->mEraseSize, SECTOR_SIZE);
+		U32 first = t.mAddress & ~(size - 1) & (mCapacity - 1);
+		for (U32 i = 0; i < size; i += SECTOR_SIZE)
+			SaturatingAdd(mSectorErases[(first + i) / SECTOR_SIZE], 1);
+		for (U32 i = first / BLOCK_SIZE; i <= (first + size - 1) / BLOCK_SIZE; ++i)
+			SaturatingAdd(mBlockErases[i], 1);
+		if (size > SECTOR_SIZE)
+			mTotals.mBlockErases++;
+		else
+			mTotals.mSectorErases++;
+	}
+	else if (cmd->mCmdOp == OP_DATA_WRITE && t.mHaveAddress && cmd->IsArrayAccess())
+	{
+		// Page program wraps inside of page, never more than page is programmed
+		U32 bytes = std::min<U32>(U32(t.mData.size()), t.mPageSize);
+		SaturatingAdd(mProgrammed[(t.mAddress & (mCapacity - 1)) / SECTOR_SIZE], bytes);
+		mTotals.mPrograms++;
+		mTotals.mProgrammedBytes += bytes;
+	}
+}
+
+U32 WearMap::SectorErases(size_t sector) const
+{
+	U16 erases = mSectorErases[sector];
+	SaturatingAdd(erases, U32(std::min<U64>(mTotals.mChipErases, 0xFFFF)));
+	return erases;
+}
+
+void WearMap::GetTotals(WearTotals &totals) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	totals = mTotals;
+}
+
+static bool MoreWorn(const WearEntry &a, const WearEntry &b)
+{
+	if (a.mErases != b.mErases)
+		return a.mErases > b.mErases;
+	if (a.mProgrammedBytes != b.mProgrammedBytes)
+		return a.mProgrammedBytes > b.mProgrammedBytes;
+	return a.mAddress < b.mAddress;
+}
+
+static void KeepTop(std::vector<WearEntry> &entries)
+{
+	size_t count = std::min<size_t>(entries.size(), WearMap::TOP_COUNT);
+	std::partial_sort(entries.begin(), entries.begin() + count, entries.end(), MoreWorn);
+	entries.resize(count);
+}
+
+void WearMap::GetTopSectors(std::vector<WearEntry> &entries) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	entries.clear();
+	for (size_t i = 0; i < mSectorErases.size(); ++i)
+	{
+		WearEntry e = { U32(i * SECTOR_SIZE), SectorErases(i), mProgrammed[i] };
+		if (e.mErases || e.mProgrammedBytes)
+			entries.push_back(e);
+	}
+	KeepTop(entries);
+}
+
+void WearMap::GetTopBlocks(std::vector<WearEntry> &entries) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	const size_t sectorsPerBlock = BLOCK_SIZE / SECTOR_SIZE;
+
+	entries.clear();
+	for (size_t i = 0; i < mBlockErases.size(); ++i)
+	{
+		U16 erases = mBlockErases[i];
+		SaturatingAdd(erases, U32(std::min<U64>(mTotals.mChipErases, 0xFFFF)));
+		WearEntry e = { U32(i * BLOCK_SIZE), erases, 0 };
+		for (size_t j = 0; j < sectorsPerBlock; ++j)
+			SaturatingAdd(e.mProgrammedBytes, mProgrammed[i * sectorsPerBlock + j]);
+		if (e.mErases || e.mProgrammedBytes)
+			entries.push_back(e);
+	}
+	KeepTop(entries);
+}
+
+// Dark for never erased, then blue, green, yellow and red on log scale
+static void HeatColor(U32 value, U32 max, U8 bgr[3])
+{
+	if (value == 0)
+	{
+		bgr[0] = bgr[1] = bgr[2] = 0x20;
+		return;
+	}
+	double t = max > 1 ? log(1.0 + value) / log(1.0 + max) : 1.0;
+	double r = 0, g = 0, b = 0;
+	if (t < 1.0 / 3)
+	{
+		b = 1 - 3 * t;
+		g = 3 * t;
+	}
+	else if (t < 2.0 / 3)
+	{
+		g = 1;
+		r = 3 * t - 1;
+	}
+	else
+	{
+		r = 1;
+		g = 3 - 3 * t;
+	}
+	bgr[0] = U8(b * 255);
+	bgr[1] = U8(g * 255);
+	bgr[2] = U8(r * 255);
+}
+
+static void Put16(std::string &out, U16 v)
+{
+	out += char(v);
+	out += char(v >> 8);
+}
+
+static void Put32(std::string &out, U32 v)
+{
+	Put16(out, U16(v));
+	Put16(out, U16(v >> 16));
+}
+
+void WearMap::GetHeatMap(WearHeatMap &map) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	size_t sectors = mSectorErases.size();
+
+	map.mErases.resize(sectors);
+	map.mMax = 0;
+	for (size_t i = 0; i < sectors; ++i)
+	{
+		map.mErases[i] = SectorErases(i);
+		map.mMax = std::max(map.mMax, map.mErases[i]);
+	}
+	map.mColumns = U32(std::min<size_t>(sectors, HEAT_MAP_COLUMNS));
+	map.mRows = U32((sectors + map.mColumns - 1) / map.mColumns);
+}
+
+static U32 HeatMapStride(const WearHeatMap &map)
+{
+	return (map.mColumns * HEAT_MAP_SCALE * 3 + 3) & ~3U;
+}
+
+void WearMap::WriteHeatMapHeader(const WearHeatMap &map, std::string &out)
+{
+	U32 width = map.mColumns * HEAT_MAP_SCALE;
+	U32 height = map.mRows * HEAT_MAP_SCALE;
+	U32 stride = HeatMapStride(map);
+
+	// BITMAPFILEHEADER + BITMAPINFOHEADER
+	out.clear();
+	out += "BM";
+	Put32(out, 54 + stride * height);
+	Put32(out, 0);
+	Put32(out, 54);
+	Put32(out, 40);
+	Put32(out, width);
+	// Negative height, first row is at the top (address 0)
+	Put32(out, U32(-S32(height)));
+	Put16(out, 1);
+	Put16(out, 24);
+	Put32(out, 0);
+	Put32(out, stride * height);
+	Put32(out, 2835);
+	Put32(out, 2835);
+	Put32(out, 0);
+	Put32(out, 0);
+}
+
+void WearMap::WriteHeatMapRows(const WearHeatMap &map, U32 first, U32 count, std::string &out)
+{
+	size_t sectors = map.mErases.size();
+	U32 end = std::min(first + count, map.mRows);
+	std::string line(HeatMapStride(map), '\0');
+
+	for (U32 row = first; row < end; ++row)
+	{
+		for (U32 column = 0; column < map.mColumns; ++column)
+		{
+			size_t sector = size_t(row) * map.mColumns + column;
+			U8 bgr[3] = { 0, 0, 0 };
+			if (sector < sectors)
+				HeatColor(map.mErases[sector], map.mMax, bgr);
+			for (U32 x = 0; x < HEAT_MAP_SCALE; ++x)
+				memcpy(&line[(column * HEAT_MAP_SCALE + x) * 3], bgr, 3);
+		}
+		for (U32 y = 0; y < HEAT_MAP_SCALE; ++y)
+			out += line;
+	}
+}
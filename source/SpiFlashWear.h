@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_WEAR_H
+#define SPIFLASH_WEAR_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+struct WearTotals
+{
+	// Erase commands by size
+	U64 mSectorErases;
+	U64 mBlockErases;
+	U64 mChipErases;
+	U64 mPrograms;
+	U64 mProgrammedBytes;
+};
+
+struct WearEntry
+{
+	U32 mAddress;
+	U32 mErases;
+	U32 mProgrammedBytes;
+};
+
+// Sector erase counts copied for heat map, rows are rendered without lock
+struct WearHeatMap
+{
+	std::vector<U32> mErases;
+	U32 mMax;
+	U32 mColumns;
+	U32 mRows;
+};
+
+// Erase and program counts per 4 KiB sector and 64 KiB block, counters saturate
+class WearMap
+{
+	U32 mCapacity;
+	// Erases of every size that covered sector, chip erases are kept apart
+	std::vector<U16> mSectorErases;
+	// Erase commands that touched block
+	std::vector<U16> mBlockErases;
+	std::vector<U32> mProgrammed;
+	WearTotals mTotals;
+	mutable std::mutex mLock;
+
+	U32 SectorErases(size_t sector) const;
+public:
+	enum { SECTOR_SIZE = 0x1000, BLOCK_SIZE = 0x10000, TOP_COUNT = 64 };
+
+	WearMap();
+
+	// Capacity in bytes, power of 2, clears counters
+	void Configure(U32 capacity);
+	void Add(const SpiTransaction &transaction);
+
+	void GetTotals(WearTotals &totals) const;
+	// Most erased sectors and blocks, most erased first
+	void GetTopSectors(std::vector<WearEntry> &entries) const;
+	void GetTopBlocks(std::vector<WearEntry> &entries) const;
+	// 24 bit BMP, one 4x4 square per sector, 128 sectors per row
+	void GetHeatMap(WearHeatMap &map) const;
+	static void WriteHeatMapHeader(const WearHeatMap &map, std::string &out);
+	// Appends count sector rows starting at first, safe to call from several threads
+	static void WriteHeatMapRows(const WearHeatMap &map, U32 first, U32 count, std::string &out);
+};
+
+#endif //SPIFLASH_WEAR_H
@@ -0,0 +1,182 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstdlib>
+#include <algorithm>
+#include "SpiFlashXip.h"
+#include "SpiFlashTransactionIndex.h"
+#include "SpiFlash.h"
+
+static bool IsPowerOfTwo(unsigned long long v)
+{
+	return v && (v & (v - 1)) == 0;
+}
+
+bool XipCacheConfig::Parse(const char *text, XipCacheConfig &config)
+{
+	unsigned long long v[4];
+	char *end;
+
+	if (text == nullptr)
+		return false;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		v[i] = strtoull(text, &end, 0);
+		if (end == text || *end != (i < 3 ? '/' : '\0'))
+			return false;
+		text = end + 1;
+	}
+	if (!IsPowerOfTwo(v[0]) || v[0] < 4 || v[0] > 4096 || v[1] == 0 || v[1] > 64 ||
+		!IsPowerOfTwo(v[2]) || v[1] * v[2] > XipModel::MAX_LINES || v[3] > 16)
+		return false;
+
+	config.mLineSize = U32(v[0]);
+	config.mWays = U32(v[1]);
+	config.mSets = U32(v[2]);
+	config.mPrefetch = U32(v[3]);
+
+	return true;
+}
+
+XipModel::XipModel()
+{
+	XipCacheConfig config = { 32, 4, 64, 0 };
+	Configure(config);
+}
+
+void XipModel::Configure(const XipCacheConfig &config)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mConfig = config;
+	for (mLineShift = 0; (1U << mLineShift) < config.mLineSize; ++mLineShift)
+		;
+	mLines.assign(size_t(config.mWays) * config.mSets, Line());
+	for (size_t i = 0; i < mLines.size(); ++i)
+		mLines[i].mStamp = 0;
+	mStamp = 0;
+	mNextAddress = ~0ULL;
+	mReport.mSequentialFetches = mReport.mSequentialBytes = mReport.mRandomFetches = mReport.mRandomBytes = 0;
+	mReport.mHits = mReport.mMisses = mReport.mPrefetched = mReport.mPrefetchUsed = 0;
+	mReport.mBusBytes = mReport.mModelBytes = 0;
+	mReport.mConfig = config;
+	mRegionMisses.clear();
+}
+
+bool XipModel::Access(U32 line, bool prefetch)
+{
+	Line *set = &mLines[size_t(line & (mConfig.mSets - 1)) * mConfig.mWays];
+	Line *victim = set;
+
+	for (U32 i = 0; i < mConfig.mWays; ++i)
+	{
+		Line &l = set[i];
+		if (l.mStamp && l.mTag == line)
+		{
+			if (!prefetch)
+			{
+				if (l.mPrefetched)
+					mReport.mPrefetchUsed++;
+				l.mPrefetched = false;
+				l.mStamp = ++mStamp;
+			}
+			return true;
+		}
+		// Empty line or least recently used one
+		if (l.mStamp < victim->mStamp)
+			victim = &l;
+	}
+
+	victim->mTag = line;
+	victim->mStamp = ++mStamp;
+	victim->mPrefetched = prefetch;
+	if (prefetch)
+		mReport.mPrefetched++;
+	mReport.mModelBytes += mConfig.mLineSize;
+
+	return false;
+}
+
+void XipModel::Add(const SpiTransaction &t)
+{
+	if (t.mCmd == nullptr || t.mCmd->mCmdOp != OP_DATA_READ || !t.mCmd->IsArrayAccess() || !t.mHaveAddress ||
+		t.mByteCount == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	// Fetch continuing where previous one ended
+	if (t.mAddress == mNextAddress)
+	{
+		mReport.mSequentialFetches++;
+		mReport.mSequentialBytes += t.mByteCount;
+	}
+	else
+	{
+		mReport.mRandomFetches++;
+		mReport.mRandomBytes += t.mByteCount;
+	}
+	mReport.mBusBytes += t.mByteCount;
+	mNextAddress = U64(t.mAddress) + t.mByteCount;
+
+	U32 first = t.mAddress >> mLineShift;
+	U32 last = U32((mNextAddress - 1) >> mLineShift);
+	for (U32 line = first; ; ++line)
+	{
+		if (Access(line, false))
+		{
+			mReport.mHits++;
+		}
+		else
+		{
+			mReport.mMisses++;
+			mRegionMisses[U32((U64(line) << mLineShift) >> REGION_SHIFT)]++;
+			for (U32 p = 1; p <= mConfig.mPrefetch; ++p)
+				Access(line + p, true);
+		}
+		if (line == last)
+			break;
+	}
+}
+
+static bool MoreMisses(const XipRegion &a, const XipRegion &b)
+{
+	return a.mMisses > b.mMisses || (a.mMisses == b.mMisses && a.mAddress < b.mAddress);
+}
+
+void XipModel::GetReport(XipReport &report) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	report = mReport;
+	report.mHotMisses.clear();
+	for (std::unordered_map<U32, U64>::const_iterator i = mRegionMisses.begin(); i != mRegionMisses.end(); ++i)
+	{
+		XipRegion region = { i->first << REGION_SHIFT, i->second };
+		report.mHotMisses.push_back(region);
+	}
+	size_t count = std::min(size_t(HOT_REGIONS), report.mHotMisses.size());
+	std::partial_sort(report.mHotMisses.begin(), report.mHotMisses.begin() + count, report.mHotMisses.end(), MoreMisses);
+	report.mHotMisses.resize(count);
+}
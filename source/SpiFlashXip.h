@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright(c) 2017 Jerzy Kasenberg
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef SPIFLASH_XIP_H
+#define SPIFLASH_XIP_H
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include <LogicPublicTypes.h>
+
+struct SpiTransaction;
+
+// Geometry of modelled MCU cache
+struct XipCacheConfig
+{
+	U32 mLineSize;
+	U32 mWays;
+	U32 mSets;
+	// Lines fetched after missed line
+	U32 mPrefetch;
+
+	// "line/ways/sets/prefetch", e.g. 32/4/64/1; line size and sets are powers of two
+	static bool Parse(const char *text, XipCacheConfig &config);
+};
+
+struct XipRegion
+{
+	U32 mAddress;
+	U64 mMisses;
+};
+
+struct XipReport
+{
+	XipCacheConfig mConfig;
+	U64 mSequentialFetches;
+	U64 mSequentialBytes;
+	U64 mRandomFetches;
+	U64 mRandomBytes;
+	// Line lookups
+	U64 mHits;
+	U64 mMisses;
+	// Lines brought in by prefetch and how many were used before eviction
+	U64 mPrefetched;
+	U64 mPrefetchUsed;
+	// Bytes read on captured bus and bytes cache would read (whole lines)
+	U64 mBusBytes;
+	U64 mModelBytes;
+	// Regions with most misses, most missed first
+	std::vector<XipRegion> mHotMisses;
+};
+
+// Classifies read fetches and runs them through set associative LRU cache model
+class XipModel
+{
+	struct Line
+	{
+		U32 mTag;
+		// 0 - empty
+		U64 mStamp;
+		bool mPrefetched;
+	};
+	XipCacheConfig mConfig;
+	U32 mLineShift;
+	std::vector<Line> mLines;
+	U64 mStamp;
+	U64 mNextAddress;
+	XipReport mReport;
+	// Misses per REGION_SHIFT sized region
+	std::unordered_map<U32, U64> mRegionMisses;
+	mutable std::mutex mLock;
+
+	// Returns true on hit, missed line is filled
+	bool Access(U32 line, bool prefetch);
+public:
+	enum { REGION_SHIFT = 12, MAX_LINES = 1 << 20, HOT_REGIONS = 32 };
+
+	XipModel();
+
+	void Configure(const XipCacheConfig &config);
+	void Add(const SpiTransaction &transaction);
+	void GetReport(XipReport &report) const;
+};
+
+#endif //SPIFLASH_XIP_H